@@ -0,0 +1,135 @@
+#!/bin/bash
+
+# Stand-in for "adb -d shell": builds a fake cpufreq/devfreq/hotplug/thermal sysfs tree and a stub graph
+# that prints ARMCL-Pipe-All style output, then serves shell commands from stdin.
+#
+# ./governor <graph> 8 10 300 --device-cmd=<path>/fake_device.sh \
+#     --device-dir=/tmp/governor_fake_device/Working_dir --sysfs-root=/tmp/governor_fake_device
+#
+# "./fake_device.sh setup" only builds the tree, e.g. for the --native backend.
+# The stub graph reports every 10 frames, re-reading the frequencies each time,
+# so it also stands in for a live graph (--daemon --live-graph). It also heats thermal_zone0
+# with a first-order model driven by its frequencies and the fan level, and
+# runs both clusters at 1.2 GHz at most from 85C on. The power of that model
+# goes into an INA2xx-like hwmon energy counter and, one "<unix time> <watts>"
+# line per block, into power.log (--power-sensor=hwmon:... or log:...).
+# Its Amdahl parallel fraction (FAKE_PARALLEL) and the share of GPU stage time
+# that does not scale with the OPP (FAKE_GPU_FIXED) differ from the ones the
+# models assume, so that sweep_threads_gpu.sh has something to fit.
+# FAKE_STARTUP_S delays the first block like ARMCL graph setup does, and
+# FAKE_REALTIME=1 takes as long per block as its frames would, so wall-clock
+# comparisons of measurement strategies mean something.
+
+FakeRoot=${FAKE_ROOT:-/tmp/governor_fake_device}
+Graph=${FAKE_GRAPH:-graph_alexnet_all_pipe_sync}
+Startup=${FAKE_STARTUP_S:-0}
+Realtime=${FAKE_REALTIME:-0}
+Parallel=${FAKE_PARALLEL:-0.75}
+GpuFixed=${FAKE_GPU_FIXED:-0.45}
+
+mkdir -p ${FakeRoot}/sys/class/fan
+for Node in enable mode level; do
+    [ -f ${FakeRoot}/sys/class/fan/${Node} ] || echo 0 > ${FakeRoot}/sys/class/fan/${Node}
+done
+for Policy in policy0 policy2; do
+    mkdir -p ${FakeRoot}/sys/devices/system/cpu/cpufreq/${Policy}
+    [ -f ${FakeRoot}/sys/devices/system/cpu/cpufreq/${Policy}/scaling_max_freq ] || \
+        echo 1800000 > ${FakeRoot}/sys/devices/system/cpu/cpufreq/${Policy}/scaling_max_freq
+    echo performance > ${FakeRoot}/sys/devices/system/cpu/cpufreq/${Policy}/scaling_governor
+done
+for Cpu in 1 3 4 5; do
+    mkdir -p ${FakeRoot}/sys/devices/system/cpu/cpu${Cpu}
+    [ -f ${FakeRoot}/sys/devices/system/cpu/cpu${Cpu}/online ] || echo 1 > ${FakeRoot}/sys/devices/system/cpu/cpu${Cpu}/online
+done
+ThermalZone=${FakeRoot}/sys/class/thermal/thermal_zone0
+mkdir -p ${ThermalZone}
+[ -f ${ThermalZone}/temp ] || echo 40000 > ${ThermalZone}/temp
+Hwmon=${FakeRoot}/sys/class/hwmon/hwmon0
+mkdir -p ${Hwmon}
+[ -f ${Hwmon}/energy1_input ] || echo 0 > ${Hwmon}/energy1_input
+touch ${FakeRoot}/power.log
+GpuDevfreq=${FakeRoot}/sys/class/devfreq/ffe40000.gpu
+mkdir -p ${GpuDevfreq}
+[ -f ${GpuDevfreq}/max_freq ] || echo 799999987 > ${GpuDevfreq}/max_freq
+[ -f ${GpuDevfreq}/governor ] || echo simple_ondemand > ${GpuDevfreq}/governor
+
+mkdir -p ${FakeRoot}/Working_dir
+cat > ${FakeRoot}/Working_dir/${Graph} <<STUB
+#!/bin/bash
+for Arg in "\$@"; do
+    case \$Arg in
+        --partition_point=*) PP1=\${Arg#*=} ;;
+        --partition_point2=*) PP2=\${Arg#*=} ;;
+        --order=*) Order=\${Arg#*=} ;;
+        --n=*) Frames=\${Arg#*=} ;;
+        --threads=*) BigThreads=\${Arg#*=} ;;
+        --threads2=*) LittleThreads=\${Arg#*=} ;;
+    esac
+done
+echo
+sleep ${Startup}
+echo "Running Inference ... "
+Done=0
+Last=\$(date +%s.%N)
+while [ \$Done -lt \${Frames:-10} ]; do
+Little=\$(cat ${FakeRoot}/sys/devices/system/cpu/cpufreq/policy0/scaling_max_freq)
+Big=\$(cat ${FakeRoot}/sys/devices/system/cpu/cpufreq/policy2/scaling_max_freq)
+Gpu=\$(cat ${GpuDevfreq}/max_freq)
+# Threads beyond the online cores of a cluster share them
+BigOnline=1
+for Cpu in 3 4 5; do BigOnline=\$((BigOnline + \$(cat ${FakeRoot}/sys/devices/system/cpu/cpu\$Cpu/online))); done
+LittleOnline=\$((1 + \$(cat ${FakeRoot}/sys/devices/system/cpu/cpu1/online)))
+Bt=\$(( \${BigThreads:-4} < BigOnline ? \${BigThreads:-4} : BigOnline ))
+Lt=\$(( \${LittleThreads:-2} < LittleOnline ? \${LittleThreads:-2} : LittleOnline ))
+Temp=\$(cat ${ThermalZone}/temp)
+Fan=\$(( \$(cat ${FakeRoot}/sys/class/fan/enable) ? \$(cat ${FakeRoot}/sys/class/fan/level) : 0 ))
+Energy=\$(cat ${Hwmon}/energy1_input)
+Now=\$(date +%s.%N)
+awk -v pp1=\$PP1 -v pp2=\$PP2 -v order=\$Order -v big=\$Big -v little=\$Little -v gpu=\$Gpu -v bt=\$Bt -v lt=\$Lt \\
+    -v temp=\$Temp -v fan=\$Fan -v now=\$Now -v last=\$Last -v zone=${ThermalZone}/temp \\
+    -v energy=\$Energy -v counter=${Hwmon}/energy1_input -v powerlog=${FakeRoot}/power.log -v realtime=${Realtime} \\
+    -v par=${Parallel} -v gfix=${GpuFixed} 'BEGIN {
+    # Throttling caps both clusters at 1.2 GHz from 85C on
+    if (temp >= 85000) { if (big > 1200000) big = 1200000; if (little > 1200000) little = 1200000; }
+    split("0.20 0.25 0.15 0.15 0.10 0.08 0.05 0.02", w, " ");
+    cost["G"] = 120.0 * (gfix + (1 - gfix) * 8e8 / gpu); cost["B"] = 198.6 / (big / 1e6); cost["L"] = 390.2 / (little / 1e6);
+    cost["B"] *= (1 - par + par / bt) / (1 - par + par / 4); cost["L"] *= (1 - par + par / lt) / (1 - par + par / 2);
+    split(order, p, "-");
+    bounds[0] = 0; bounds[1] = pp1; bounds[2] = pp2; bounds[3] = 8;
+    max = 0; sum = 0; slow = 0;
+    for (s = 1; s <= 3; s++) {
+        t = 0;
+        for (l = bounds[s-1] + 1; l <= bounds[s]; l++) t += w[l] * cost[p[s]];
+        printf("\nstage%d_input_time: %g ms\nstage%d_inference_time: %g ms\nstage%d_total_time: %g ms\n\n", s, 0.5, s, t, s, t + 0.5);
+        if (t > max) max = t;
+        if (p[s] == "L") slow += t;
+        sum += t + 0.5;
+    }
+    # Per-frame latencies around the mean with an exponential tail, longer the more of the frame is on the little cores
+    srand(int(now * 1000) % 2147483647);
+    spread = 0.03 + 0.25 * slow / sum;
+    for (f = 0; f < 10; f++) printf("frame_latency: %g ms\n", sum * (1 - spread - spread * log(1 - rand())));
+    printf("Frame rate is: %g FPS\nFrame latency is: %g ms\n", 1000.0 / max, sum);
+
+    # First-order SoC temperature over the wall time since the last block; the fan sets the resistance
+    split("16 10 7.5 6.5", r, " ");
+    watts = 0.5 + 2.4 * (big / 2208000) ^ 2 * (0.55 + 0.45 * bt / 4) + 0.8 * (little / 1800000) ^ 2 * (0.55 + 0.45 * lt / 2) + 1.2 * gpu / 8e8;
+    steady = 35.0 + r[fan + 1] * watts;
+    celsius = steady + (temp / 1000.0 - steady) * exp(-(now - last) / 60.0);
+    printf("%d\n", celsius * 1000) > zone;
+    printf("%.0f\n", energy + watts * (now - last) * 1e6) > counter;
+    printf("%.3f %.3f\n", now, watts) >> powerlog;
+    if (realtime) system(sprintf("sleep %.3f", 10 * max / 1000.0));
+}'
+Last=\$Now
+Done=\$((Done + 10))
+sleep 0.01
+done
+STUB
+chmod +x ${FakeRoot}/Working_dir/${Graph}
+
+if [ "$1" == "setup" ]; then
+    exit 0
+fi
+
+exec sh
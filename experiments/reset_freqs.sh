@@ -14,3 +14,14 @@ adb -d shell "echo interactive > /sys/devices/system/cpu/cpufreq/policy2/scaling
 
 adb -d shell "echo 1800000 > /sys/devices/system/cpu/cpufreq/policy0/scaling_max_freq"
 adb -d shell "echo 2208000 > /sys/devices/system/cpu/cpufreq/policy2/scaling_max_freq"
+
+# GPU back to its default devfreq governor and top OPP
+
+adb -d shell "echo simple_ondemand > /sys/class/devfreq/ffe40000.gpu/governor"
+adb -d shell "echo 800000000 > /sys/class/devfreq/ffe40000.gpu/max_freq"
+
+# Bring back any cores parked by --park-cores
+
+for Cpu in 1 3 4 5; do
+    adb -d shell "echo 1 > /sys/devices/system/cpu/cpu${Cpu}/online"
+done
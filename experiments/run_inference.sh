@@ -5,7 +5,17 @@ N_Frames=$2
 PartitionPoint1=$3
 PartitionPoint2=$4
 Order=$5
+BigThreads=${6:-4}      # --threads, pinned to the first big cores (2-5)
+LittleThreads=${7:-2}   # --threads2, pinned to the first little cores (0-1)
+GpuFreq=$8              # optional, kHz from the set_freq.sh gpu table
+
+# Affinity mask: little cores from bit 0, big cores from bit 2
+Mask=$(printf "%x" $(( ((1 << LittleThreads) - 1) | (((1 << BigThreads) - 1) << 2) )))
+
+if [ -n "${GpuFreq}" ]; then
+    ./set_freq.sh gpu ${GpuFreq} || exit 1
+fi
 
 adb -d root
-adb -d shell "export LD_LIBRARY_PATH=/data/local/Working_dir && cd /data/local/Working_dir && ./${Graph} --threads=4  --threads2=2 --target=CL --n=${N_Frames} --partition_point=${PartitionPoint1} --partition_point2=${PartitionPoint2} --order=${Order} > last_run_output.txt"
+adb -d shell "export LD_LIBRARY_PATH=/data/local/Working_dir && cd /data/local/Working_dir && taskset ${Mask} ./${Graph} --threads=${BigThreads} --threads2=${LittleThreads} --target=CL --n=${N_Frames} --partition_point=${PartitionPoint1} --partition_point2=${PartitionPoint2} --order=${Order} > last_run_output.txt"
 adb -d pull /data/local/Working_dir/last_run_output.txt last_run_output.txt
\ No newline at end of file
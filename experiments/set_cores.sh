@@ -0,0 +1,18 @@
+#!/bin/bash
+
+# Hotplugs cores 1 and 3-5 to match a hex affinity mask, e.g. "./set_cores.sh 1d"
+# keeps cores 0, 2, 3 and 4. Cores 0 and 2 hold the cpufreq policies and stay online.
+
+Mask=$((16#$1))
+
+adb -d root
+
+for Cpu in 1 3 4 5; do
+    Online=$(( (Mask >> Cpu) & 1 ))
+    adb -d shell "echo ${Online} > /sys/devices/system/cpu/cpu${Cpu}/online"
+
+    if [ "$(adb -d shell "cat /sys/devices/system/cpu/cpu${Cpu}/online" | tr -d '\r')" != "${Online}" ]; then
+        echo "Error: cpu${Cpu} was not hotplugged"
+        exit 1
+    fi
+done
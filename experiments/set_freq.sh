@@ -5,6 +5,9 @@ Freq=$2
 
 LittleFrequencyTable=(500000 667000 1000000 1200000 1398000 1512000 1608000 1704000 1800000)
 BigFrequencyTable=(500000 667000 1000000 1200000 1398000 1512000 1608000 1704000 1800000 1908000 2016000 2100000 2208000)
+# Mali OPPs in kHz, rounded; devfreq wants Hz and floors them to an OPP (124999998, 285714281, ...)
+GpuFrequencyTable=(125000 250000 285714 400000 500000 666667 800000)
+GpuDevfreq=/sys/class/devfreq/ffe40000.gpu
 
 if [ "$CpuType" == "little" ]; then
     if ! [[ " ${LittleFrequencyTable[@]} " =~ " ${Freq} " ]]; then
@@ -16,8 +19,13 @@ elif [ "$CpuType" == "big" ]; then
         echo "Error: Freq must be a valid frequency for the big CPU"
         exit 1
     fi
+elif [ "$CpuType" == "gpu" ]; then
+    if ! [[ " ${GpuFrequencyTable[@]} " =~ " ${Freq} " ]]; then
+        echo "Error: Freq must be a valid frequency for the GPU"
+        exit 1
+    fi
 else
-    echo "Error: CpuType must be either 'little' or 'big'"
+    echo "Error: CpuType must be either 'little', 'big' or 'gpu'"
     exit 1
 fi
 
@@ -31,6 +39,17 @@ if [ "$CpuType" == "little" ]; then
         echo "Error: Frequency was not set correctly"
         exit 1
     fi
+elif [ "$CpuType" == "gpu" ]; then
+    Hz=$((Freq * 1000 + 999))
+    adb -d shell "echo performance > ${GpuDevfreq}/governor"
+    adb -d shell "echo ${Hz} > ${GpuDevfreq}/max_freq"
+
+    # Reads back the OPP it clamped to; compare whole MHz
+    ReadHz=$(adb -d shell "cat ${GpuDevfreq}/max_freq" | tr -d '\r')
+    if [ $(( (ReadHz + 500000) / 1000000 )) != $(( (Hz + 500000) / 1000000 )) ]; then
+        echo "Error: Frequency was not set correctly"
+        exit 1
+    fi
 else
     adb -d shell "echo performance > /sys/devices/system/cpu/cpufreq/policy2/scaling_governor"
     adb -d shell "echo ${Freq} > /sys/devices/system/cpu/cpufreq/policy2/scaling_max_freq"
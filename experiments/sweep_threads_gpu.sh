@@ -0,0 +1,96 @@
+#!/bin/bash
+
+# Sweeps the thread count of each CPU cluster and the GPU OPPs with all layers
+# on one processor, then fits the constants the governor's models assume
+# (ApproximationModels.h): CPU_PARALLEL_FRACTION, the Amdahl fraction of a CPU
+# stage that scales with the threads, and GPU_FIXED_LATENCY_FRACTION, the share
+# of GPU stage time that does not scale with the OPP.
+#
+# ./sweep_threads_gpu.sh <graph> <n_frames> [output.csv]
+#
+# The device is reached the way the governor reaches it; against the fake device:
+# DEVICE_CMD=./fake_device.sh DEVICE_DIR=/tmp/governor_fake_device/Working_dir \
+#     SYSFS_ROOT=/tmp/governor_fake_device ./sweep_threads_gpu.sh graph_alexnet_all_pipe_sync 20
+
+Graph=$1
+N_Frames=$2
+Output=${3:-data/sweep_threads_gpu_$(date +%Y%m%d_%H%M%S).csv}
+DeviceCmd=${DEVICE_CMD:-adb -d shell}
+DeviceDir=${DEVICE_DIR:-/data/local/Working_dir}
+SysfsRoot=${SYSFS_ROOT:-}
+
+BigMaxFreq=2208000
+LittleMaxFreq=1800000
+# Mali OPPs in kHz, as in set_freq.sh
+GpuFrequencyTable=(125000 250000 285714 400000 500000 666667 800000)
+GpuDevfreq=${SysfsRoot}/sys/class/devfreq/ffe40000.gpu
+
+if [ -z "${Graph}" ] || [ -z "${N_Frames}" ]; then
+    echo "Usage: $0 <graph> <n_frames> [output.csv]"
+    exit 1
+fi
+
+if [ "${DeviceCmd}" == "adb -d shell" ]; then
+    adb -d root
+fi
+
+Shell() {
+    echo "$1" | ${DeviceCmd} | tr -d '\r'
+}
+
+SetFrequencies() {
+    Shell "echo performance > ${SysfsRoot}/sys/devices/system/cpu/cpufreq/policy0/scaling_governor
+echo ${LittleMaxFreq} > ${SysfsRoot}/sys/devices/system/cpu/cpufreq/policy0/scaling_max_freq
+echo performance > ${SysfsRoot}/sys/devices/system/cpu/cpufreq/policy2/scaling_governor
+echo ${BigMaxFreq} > ${SysfsRoot}/sys/devices/system/cpu/cpufreq/policy2/scaling_max_freq
+echo performance > ${GpuDevfreq}/governor
+echo $(( $1 * 1000 + 999 )) > ${GpuDevfreq}/max_freq"
+}
+
+# Mean stage 1 inference time in ms over the statistics blocks of one run,
+# with every layer in stage 1
+StageTime() {
+    local Order=$1 BigThreads=$2 LittleThreads=$3
+    local Mask=$(printf "%x" $(( ((1 << LittleThreads) - 1) | (((1 << BigThreads) - 1) << 2) )))
+    Shell "cd ${DeviceDir} && LD_LIBRARY_PATH=${DeviceDir} taskset ${Mask} ./${Graph} --threads=${BigThreads} --threads2=${LittleThreads} --target=CL --n=${N_Frames} --partition_point=8 --partition_point2=8 --order=${Order}" |
+        awk '/stage1_inference_time:/ { sum += $2; n++ } END { if (n) printf "%.4f\n", sum / n }'
+}
+
+mkdir -p "$(dirname "${Output}")"
+echo "processor,threads,gpu_freq,stage_time_ms" > "${Output}"
+
+SetFrequencies ${GpuFrequencyTable[-1]}
+for Threads in 1 2 3 4; do
+    echo "big,${Threads},${GpuFrequencyTable[-1]},$(StageTime B-G-L ${Threads} 2)" | tee -a "${Output}"
+done
+for Threads in 1 2; do
+    echo "little,${Threads},${GpuFrequencyTable[-1]},$(StageTime L-G-B 4 ${Threads})" | tee -a "${Output}"
+done
+for GpuFreq in ${GpuFrequencyTable[@]}; do
+    SetFrequencies ${GpuFreq}
+    echo "gpu,0,${GpuFreq},$(StageTime G-B-L 4 2)" | tee -a "${Output}"
+done
+SetFrequencies ${GpuFrequencyTable[-1]}
+
+# Least squares through the origin on the times relative to one thread and to
+# the top OPP: t(n)/t(1) = 1 - p + p/n and t(f)/t(fmax) = a + (1 - a) fmax/f
+awk -F, 'NR > 1 && $4 != "" {
+    if ($1 == "gpu") { gpu[$3] = $4; if ($3 > fmax) fmax = $3 }
+    else { cpu[$1, $2] = $4; threads[$1] = $2 > threads[$1] ? $2 : threads[$1] }
+} END {
+    for (c in threads) {
+        if (!((c, 1) in cpu)) continue;
+        for (n = 2; n <= threads[c]; n++) {
+            if (!((c, n) in cpu)) continue;
+            x = 1 - 1 / n; y = 1 - cpu[c, n] / cpu[c, 1];
+            sxy[c] += x * y; sxx[c] += x * x; pxy += x * y; pxx += x * x;
+        }
+        if (sxx[c] > 0) printf "%s: parallel fraction %.3f\n", c, sxy[c] / sxx[c];
+    }
+    if (pxx > 0) printf "CPU_PARALLEL_FRACTION %.3f\n", pxy / pxx;
+    for (f in gpu) {
+        x = 1 - fmax / f; y = gpu[f] / gpu[fmax] - fmax / f;
+        gxy += x * y; gxx += x * x;
+    }
+    if (gxx > 0) printf "GPU_FIXED_LATENCY_FRACTION %.3f\n", gxy / gxx;
+}' "${Output}"
@@ -1,25 +1,77 @@
 
 #include "ApproximationModels.h"
 #include "PipelineConfig.h"
+#include "ModelEstimator.h"
+#include "LayerModel.h"
+#include "ThermalModel.h"
 #include <stdio.h>
 #include <math.h>
+#include <string.h>
 
 
 
-void get_workload_fractions(int pp1, int pp2,
+void get_workload_fractions(const PipelineConfig *config,
                             double *gpu_frac,
                             double *big_frac,
-                            double *little_frac) {    
-    int gpu_layers = pp1;
-    int big_layers = pp2 - pp1;
-    int little_layers = TOTAL_LAYERS - pp2;
-    
+                            double *little_frac) {
+    PipelineConfig mapped = *config;
+    int gpu_layers = 0, big_layers = 0, little_layers = 0;
+
+    calc_partition_sizes(&mapped, TOTAL_LAYERS, &gpu_layers, &big_layers, &little_layers);
+
     *gpu_frac = (double)gpu_layers / TOTAL_LAYERS;
     *big_frac = (double)big_layers / TOTAL_LAYERS;
     *little_frac = (double)little_layers / TOTAL_LAYERS;
 }
 
 
+// exp5 order sweep (big 1.8 GHz, little 1.2 GHz, pp 3/6 twice and 2/5):
+// geometric mean of the measured over the fitted frame period and latency, and
+// the mean power residual of estimate_power, each relative to G-B-L. The
+// timing factors were fitted on the slowest and summed stage times, so they
+// only apply inside estimate_pipeline_timing; the optimizer calibrates
+// pipeline_sim per order itself (Optimizer.c).
+static const OrderOverhead ORDER_OVERHEADS[] = {
+    {"G-B-L", 1.00, 1.00,  0.00},
+    {"G-L-B", 0.55, 0.91, -0.14},
+    {"B-G-L", 0.81, 0.90,  0.87},
+    {"B-L-G", 0.44, 0.77,  0.51},
+    {"L-G-B", 0.62, 1.60, -0.98},
+    {"L-B-G", 0.72, 1.84, -1.16},
+};
+
+// With an empty middle stage the pipeline is the two-stage one of the order
+// that leaves its last stage empty, e.g. G-L-B 3/3 runs like G-B-L 3/8; a single
+// stage has no pipeline overhead at all.
+const OrderOverhead *get_order_overhead(const PipelineConfig *config) {
+    char order[6];
+
+    if (config->partition_point1 >= TOTAL_LAYERS) return &ORDER_OVERHEADS[0];
+    snprintf(order, sizeof(order), "%s", config->order);
+    if (config->partition_point2 <= config->partition_point1) {
+        order[2] = config->order[4];
+        order[4] = config->order[2];
+    }
+
+    for (size_t i = 0; i < sizeof(ORDER_OVERHEADS) / sizeof(ORDER_OVERHEADS[0]); i++) {
+        if (strcmp(ORDER_OVERHEADS[i].order, order) == 0) return &ORDER_OVERHEADS[i];
+    }
+    return &ORDER_OVERHEADS[0];
+}
+
+void estimate_pipeline_timing(const PipelineConfig *config, const double stage_ms[3],
+                              double *period_ms, double *latency_ms) {
+    const OrderOverhead *overhead = get_order_overhead(config);
+    double slowest = 0.0, sum = 0.0;
+
+    for (int s = 0; s < 3; s++) {
+        if (stage_ms[s] > slowest) slowest = stage_ms[s];
+        sum += stage_ms[s];
+    }
+    *period_ms = slowest * overhead->period_scale;
+    *latency_ms = sum * overhead->latency_scale;
+}
+
 
 //From literature:
 // Colburn, Shane & Chu, Yi & Shlizerman, Eli & Majumdar, Arka. (2018). An Optical Frontend for a Convolutional Neural Network. 10.48550/arXiv.1901.03661. 
@@ -28,7 +80,7 @@ static const double LAYER_WEIGHTS[TOTAL_LAYERS] = {
     0.20, 0.25, 0.15, 0.15, 0.10, 0.08, 0.05, 0.02
 };
 
-static double compute_weighted_fraction(int start_layer, int end_layer) {
+double compute_weighted_fraction(int start_layer, int end_layer) {
     
     double sum = 0.0;
     for (int i = start_layer; i < end_layer; i++) {
@@ -37,23 +89,128 @@ static double compute_weighted_fraction(int start_layer, int end_layer) {
     return sum;
 }
 
-double estimate_power(PipelineConfig *config) {
+static double processor_latency(char processor_code, const PipelineConfig *config, bool fitted) {
+    if (fitted) {
+        if (processor_code == 'B') return fx_latency_bcpu((double)config->big_frequency);
+        if (processor_code == 'L') return fx_latency_lcpu((double)config->little_frequency);
+        return fx_latency_gpu((double)config->gpu_frequency);
+    }
+    return model_estimator_latency(processor_code, (double)get_processor_frequency(config, processor_code));
+}
+
+static void stage_times(const PipelineConfig *config, double stage_ms[3], bool fitted) {
+    const int bounds[4] = {0, config->partition_point1, config->partition_point2, TOTAL_LAYERS};
+
+    for (int s = 0; s < 3; s++) {
+        int start = bounds[s] < 0 ? 0 : bounds[s];
+        int end = bounds[s + 1] > TOTAL_LAYERS ? TOTAL_LAYERS : bounds[s + 1];
+        char code = config->order[2 * s];
+        double khz = get_processor_frequency(config, code);
+
+        if (end <= start) {
+            stage_ms[s] = 0.0;
+        } else if (fitted || layer_model_range_time(code, khz, start, end, &stage_ms[s]) != 0) {
+            stage_ms[s] = compute_weighted_fraction(start, end) * processor_latency(code, config, fitted);
+        }
+        if (code != 'G') stage_ms[s] *= estimate_stage_scale(config, code);
+    }
+}
+
+double estimate_stage_scale(const PipelineConfig *config, char processor_code) {
+    if (processor_code == 'B') return thread_latency_scale(config->big_threads, MAX_BIG_THREADS);
+    if (processor_code == 'L') return thread_latency_scale(config->little_threads, MAX_LITTLE_THREADS);
+    return gpu_latency_scale((double)config->gpu_frequency);
+}
+
+// Latency of the whole network on one processor ('G', 'B' or 'L' as in the order string).
+// Starts from fx_latency_bcpu/fx_latency_lcpu/fx_latency_gpu and follows the online estimates.
+double estimate_processor_latency(char processor_code, const PipelineConfig *config) {
+    return processor_latency(processor_code, config, false);
+}
+
+// Modelled inference time of each pipeline stage, mapped to processors through the order.
+void estimate_stage_times(const PipelineConfig *config, double stage_ms[3]) {
+    stage_times(config, stage_ms, false);
+}
+
+void estimate_fitted_stage_times(const PipelineConfig *config, double stage_ms[3]) {
+    stage_times(config, stage_ms, true);
+}
+
+static bool core_parking = false;
+
+void set_core_parking(bool enabled) {
+    core_parking = enabled;
+}
+
+bool get_core_parking(void) {
+    return core_parking;
+}
+
+static Objective objective = OBJECTIVE_WATTS;
+static bool frame_pacing = false;
+
+void set_objective(Objective value) {
+    objective = value;
+}
+
+Objective get_objective(void) {
+    return objective;
+}
+
+const char *objective_name(Objective value) {
+    return value == OBJECTIVE_ENERGY ? "energy" : "watts";
+}
+
+void set_frame_pacing(bool enabled) {
+    frame_pacing = enabled;
+}
+
+bool get_frame_pacing(void) {
+    return frame_pacing;
+}
+
+double estimate_paced_power(double power, double fps, double target_fps) {
+    if (fps <= target_fps || target_fps <= 0.0) return power;
+
+    const double busy = target_fps / fps;
+    const double active = fmax(power - IDLE_POWER, 0.0);
+    const double kept = frame_pacing ? 0.0 : CPU_IDLE_CORE_FRACTION;
+    return IDLE_POWER + active * (busy + kept * (1.0 - busy));
+}
+
+double objective_cost(double power, double fps, double target_fps) {
+    if (objective == OBJECTIVE_WATTS) return power;
+    return estimate_paced_power(power, fps, target_fps);
+}
+
+double estimate_pipeline_power(PipelineConfig *config) {
     
-    double w_gpu = compute_weighted_fraction(0, config->partition_point1);
-    double w_big = compute_weighted_fraction(config->partition_point1, config->partition_point2);
-    double w_little = compute_weighted_fraction(config->partition_point2, TOTAL_LAYERS);
+    const int bounds[4] = {0, config->partition_point1, config->partition_point2, TOTAL_LAYERS};
+    double w_gpu = 0.0, w_big = 0.0, w_little = 0.0;
+
+    // Stage s runs on order[2*s]; the weights follow the processor, not the position.
+    for (int s = 0; s < 3; s++) {
+        double w = (bounds[s + 1] > bounds[s]) ? compute_weighted_fraction(bounds[s], bounds[s + 1]) : 0.0;
+        if (config->order[2 * s] == 'G') w_gpu += w;
+        else if (config->order[2 * s] == 'B') w_big += w;
+        else w_little += w;
+    }
     
-    double p_big_total = fx_power_bcpu((double)config->big_frequency);
-    double p_little_total = fx_power_lcpu((double)config->little_frequency);
+    double p_big_total = fx_power_bcpu((double)config->big_frequency) *
+                         thread_power_scale(config->big_threads, MAX_BIG_THREADS, core_parking);
+    double p_little_total = fx_power_lcpu((double)config->little_frequency) *
+                            thread_power_scale(config->little_threads, MAX_LITTLE_THREADS, core_parking);
+    double p_gpu_total = fx_power_gpu((double)config->gpu_frequency);
     
     double power = 0.0;
     
     if (w_gpu > 0) {
-        power += GPU_POWER * w_gpu; //GPU power is constant
+        power += p_gpu_total * w_gpu; //GPU power is frequency dependent (fixed share at the single GPU voltage)
     }
     
     if (w_big > 0) {
-        power += p_big_total * w_big; //Big CPU power is frequency dependent (using best fit above)
+        power += p_big_total * w_big; //Big CPU power is frequency and core count dependent (using best fit above)
     }
     
     if (w_little > 0) {
@@ -78,10 +235,29 @@ double estimate_power(PipelineConfig *config) {
         double stage_factor = (double)(active_stages - 1) / 2.0;
         power += (base_overhead + scaled_overhead) * stage_factor;
     }
+
+    power += get_order_overhead(config)->watts;
     
     return power;
 }
 
+// Hotter silicon leaks more, and keeping it below the throttle point costs fan
+// power; both only once a backend reports temperatures.
+double estimate_power(PipelineConfig *config) {
+    return model_estimator_power(estimate_fitted_power(config));
+}
+
+double estimate_fitted_power(PipelineConfig *config) {
+    double power = estimate_pipeline_power(config);
+    if (!thermal_model_active()) return power;
+
+    int fan_level = thermal_model_fan_level(power);
+    if (fan_level < 0) fan_level = FAN_LEVELS - 1;
+    const double celsius = thermal_model_steady(power, fan_level);
+    return power * (1.0 + THERMAL_LEAKAGE_PER_DEGREE * (celsius - THERMAL_FIT_TEMPERATURE)) +
+           thermal_fan_power(fan_level);
+}
+
 
 void get_frequency_neighbors(double frequency, processor cpu, int *left, int *right) {
     
@@ -204,6 +380,16 @@ int load_measurement_grid(const char *filepath) {
     return 0;
 }
 
+int get_measurement_grid_point(int big_idx, int little_idx, double *fps, double *latency) {
+    if (!grid_loaded || big_idx < 0 || big_idx >= NUM_BIG_FREQUENCIES ||
+        little_idx < 0 || little_idx >= NUM_LITTLE_FREQUENCIES) {
+        return -1;
+    }
+    *fps = measurement_grid[big_idx][little_idx].fps;
+    *latency = measurement_grid[big_idx][little_idx].latency;
+    return 0;
+}
+
 void approximate_target_space(double target_fps, double target_latency, PipelineConfig *config) {
     if (!grid_loaded) {
         fprintf(stderr, "approximate_target_space: grid not loaded, call load_measurement_grid first\n");
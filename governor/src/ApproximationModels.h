@@ -6,7 +6,21 @@
 
 #include "PipelineConfig.h"
 
-#define GPU_POWER 3.0
+#define GPU_POWER 3.0             // at GPU_MAX_FREQUENCY, the OPP every experiment so far ran at
+#define GPU_NETWORK_LATENCY 106.5 // whole network on the GPU, mean of exp3
+
+// Whole-network latency on a CPU cluster, a / ghz + b ms, fitted on exp3.
+// ModelEstimator starts its online estimates from the same constants.
+#define BCPU_LATENCY_PER_GHZ 1.986e+02
+#define BCPU_LATENCY_OFFSET 12.009
+#define LCPU_LATENCY_PER_GHZ 3.902e+02
+#define LCPU_LATENCY_OFFSET 153.954
+
+// No GPU frequency sweep yet: these split the exp3 constants into a part that
+// follows the Mali clock and a part that does not (memory, kernel launches,
+// leakage at the single 0.8 V rail of the G12B GPU OPPs).
+#define GPU_FIXED_LATENCY_FRACTION 0.30
+#define GPU_STATIC_POWER_FRACTION 0.35
 
 typedef struct {
 	double (*fx_freq_power_lcpu)(double);
@@ -17,9 +31,90 @@ typedef struct {
 	double (*fx_fps_freq_bcpu)(double);
 } ApproximationModel; // Currently not used but might be used another time when the code is cleaned up.
 
+// Pipeline cost of a processor order on top of its stage times, relative to
+// G-B-L, the order the fitted constants were measured in. period_scale and
+// latency_scale are for estimate_pipeline_timing only, not for other timing
+// models such as pipeline_sim.
+typedef struct {
+    const char *order;
+    double period_scale;  // on the slowest stage
+    double latency_scale; // on the sum of the stages
+    double watts;         // added to estimate_power
+} OrderOverhead;
+
+// Pipeline power plus, once temperatures are known (ThermalModel.h), the
+// leakage at the steady-state temperature and the fan level that keeps the
+// SoC below the throttle point, recalibrated against the power sensor once
+// that beats the fitted estimate (model_estimator_power).
 double estimate_power(PipelineConfig *config);
 
-void get_workload_fractions(int pp1, int pp2, double *gpu_frac, double *big_frac, double *little_frac);
+// Same without the recalibration against the power sensor.
+double estimate_fitted_power(PipelineConfig *config);
+
+// Power drawn by the SoC for the pipeline alone, what heats the thermal zone.
+double estimate_pipeline_power(PipelineConfig *config);
+
+// Whether the cores outside the affinity mask are taken offline (--park-cores);
+// estimate_power then credits them in full.
+void set_core_parking(bool enabled);
+
+bool get_core_parking(void);
+
+// Board power while the pipeline waits for its next frame with every cluster
+// in WFI at its lowest OPP and the GPU idle. Not measured yet: the meter
+// readings of the experiments all ran the graph flat out.
+#define IDLE_POWER 1.5
+
+typedef enum {
+    OBJECTIVE_WATTS,              // power of the pipeline running flat out
+    OBJECTIVE_ENERGY              // energy per frame with frames arriving at the target rate
+} Objective;
+
+// What the search minimises (--objective).
+void set_objective(Objective objective);
+
+Objective get_objective(void);
+
+const char *objective_name(Objective objective);
+
+// Whether the idle part of every frame period is spent at the lowest OPPs
+// (--pace) rather than at the configuration's own.
+void set_frame_pacing(bool enabled);
+
+bool get_frame_pacing(void);
+
+// Mean power over frame periods at target_fps of a pipeline that draws power
+// while busy and runs at fps: busy for target_fps / fps of every period and
+// idle for the rest (race to idle). Idling at its own OPPs, the pipeline keeps
+// CPU_IDLE_CORE_FRACTION of its power above IDLE_POWER; paced, it keeps none.
+double estimate_paced_power(double power, double fps, double target_fps);
+
+// What the objective ranks, in W either way so the same tolerances apply:
+// power itself, or estimate_paced_power, which is the energy per frame times
+// target_fps.
+double objective_cost(double power, double fps, double target_fps);
+
+// Share of the layers on each processor, mapped through the order.
+void get_workload_fractions(const PipelineConfig *config, double *gpu_frac, double *big_frac, double *little_frac);
+
+const OrderOverhead *get_order_overhead(const PipelineConfig *config);
+
+// Frame period and latency of a configuration from its stage times plus its order's overhead.
+void estimate_pipeline_timing(const PipelineConfig *config, const double stage_ms[3],
+                              double *period_ms, double *latency_ms);
+
+double compute_weighted_fraction(int start_layer, int end_layer);
+
+double estimate_processor_latency(char processor_code, const PipelineConfig *config);
+
+void estimate_stage_times(const PipelineConfig *config, double stage_ms[3]);
+
+// Stage time on a processor over what the latency models describe: the GPU at
+// its top OPP and the CPU clusters with all their cores.
+double estimate_stage_scale(const PipelineConfig *config, char processor_code);
+
+// Same from the fitted constants only, ignoring what has been learned online.
+void estimate_fitted_stage_times(const PipelineConfig *config, double stage_ms[3]);
 
 static inline double khz_to_mhz(int freq_khz) {
     return (double)freq_khz / 1000.0;
@@ -35,14 +130,52 @@ static inline double fx_power_bcpu(double khz) {
 }
 
 
+// Latency at khz over the latency at GPU_MAX_FREQUENCY; 0 kHz means untouched, i.e. max.
+static inline double gpu_latency_scale(double khz) {
+    if (khz <= 0.0) return 1.0;
+    return GPU_FIXED_LATENCY_FRACTION + (1.0 - GPU_FIXED_LATENCY_FRACTION) * GPU_MAX_FREQUENCY / khz;
+}
+
+static inline double fx_power_gpu(double khz) {
+    if (khz <= 0.0) return GPU_POWER;
+    return GPU_POWER * (GPU_STATIC_POWER_FRACTION + (1.0 - GPU_STATIC_POWER_FRACTION) * khz / GPU_MAX_FREQUENCY);
+}
+
+// Every CPU fit ran with the graph default of all cores (--threads=4
+// --threads2=2). Fewer threads follow Amdahl's law with this parallel share
+// of ARM Compute Library's convolution and GEMM kernels, and the cluster
+// power loses this share of its fit per unused core. An unused core that stays
+// online idles in WFI at the shared cluster voltage and keeps the leakage
+// share of it; a parked (offline) core is power gated and keeps nothing.
+#define CPU_PARALLEL_FRACTION 0.85
+#define CPU_CORE_POWER_FRACTION 0.45
+#define CPU_IDLE_CORE_FRACTION 0.30
+
+// Stage time with threads over the stage time with all max_threads cores.
+static inline double thread_latency_scale(int threads, int max_threads) {
+    if (threads <= 0 || threads >= max_threads) return 1.0;
+    return ((1.0 - CPU_PARALLEL_FRACTION) + CPU_PARALLEL_FRACTION / threads) /
+           ((1.0 - CPU_PARALLEL_FRACTION) + CPU_PARALLEL_FRACTION / max_threads);
+}
+
+static inline double thread_power_scale(int threads, int max_threads, bool parked) {
+    if (threads <= 0 || threads >= max_threads) return 1.0;
+    const double saved = parked ? 1.0 : 1.0 - CPU_IDLE_CORE_FRACTION;
+    return 1.0 - CPU_CORE_POWER_FRACTION * saved * (double)(max_threads - threads) / max_threads;
+}
+
+static inline double fx_latency_gpu(double khz) {
+    return GPU_NETWORK_LATENCY * gpu_latency_scale(khz);
+}
+
 static inline double fx_latency_lcpu(double khz){
     double ghz = khz / 1e6;
-	return 3.902e+02 / ghz + 153.954;
+	return LCPU_LATENCY_PER_GHZ / ghz + LCPU_LATENCY_OFFSET;
 }
 
 static inline double fx_latency_bcpu(double khz){
 	double ghz = khz / 1e6;
-	return 1.986e+02 / ghz + 12.009;
+	return BCPU_LATENCY_PER_GHZ / ghz + BCPU_LATENCY_OFFSET;
 }
 
 static inline double fx_fps_lcpu(double khz){
@@ -64,13 +197,13 @@ static inline double fx_power_freq_bcpu(double watts){
 }
 
 static inline double fx_latency_freq_lcpu(double latency){
-	if (latency <= 153.954) return LITTLE_FREQUENCY_TABLE[NUM_LITTLE_FREQUENCIES-1]; // infeasible, return max freq
-	return (3.902e+02 / (latency - 153.954))*1e6;
+	if (latency <= LCPU_LATENCY_OFFSET) return LITTLE_FREQUENCY_TABLE[NUM_LITTLE_FREQUENCIES-1]; // infeasible, return max freq
+	return (LCPU_LATENCY_PER_GHZ / (latency - LCPU_LATENCY_OFFSET))*1e6;
 }
 
 static inline double fx_latency_freq_bcpu(double latency){
-	if (latency <= 12.009) return BIG_FREQUENCY_TABLE[NUM_BIG_FREQUENCIES-1]; // infeasible, return max freq
-	return (1.986e+02 / (latency - 12.009))*1e6;
+	if (latency <= BCPU_LATENCY_OFFSET) return BIG_FREQUENCY_TABLE[NUM_BIG_FREQUENCIES-1]; // infeasible, return max freq
+	return (BCPU_LATENCY_PER_GHZ / (latency - BCPU_LATENCY_OFFSET))*1e6;
 }
 
 static inline double fx_fps_freq_lcpu(double fps){
@@ -88,4 +221,7 @@ static inline double fx_fps_freq_bcpu(double fps){
 int load_measurement_grid(const char *filepath);
 void approximate_target_space(double target_fps, double target_latency, PipelineConfig *config);
 
+// Measured fps/latency of the fixed G-B-L 4/6 sweep at table indices (big, little).
+int get_measurement_grid_point(int big_idx, int little_idx, double *fps, double *latency);
+
 #endif
\ No newline at end of file
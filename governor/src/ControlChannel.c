@@ -0,0 +1,88 @@
+#include "ControlChannel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+
+int control_channel_open(ControlChannel *channel, const char *path) {
+    memset(channel, 0, sizeof(*channel));
+    channel->fd = -1;
+    channel->keepalive_fd = -1;
+    snprintf(channel->path, sizeof(channel->path), "%s", path);
+
+    if (mkfifo(path, 0600) != 0 && errno != EEXIST) {
+        fprintf(stderr, "control_channel_open: cannot create %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISFIFO(st.st_mode)) {
+        fprintf(stderr, "control_channel_open: %s exists and is not a FIFO\n", path);
+        return -1;
+    }
+
+    channel->fd = open(path, O_RDONLY | O_NONBLOCK);
+    if (channel->fd < 0) {
+        fprintf(stderr, "control_channel_open: cannot open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    channel->keepalive_fd = open(path, O_WRONLY | O_NONBLOCK);
+    channel->open = true;
+
+    printf("[control] listening on %s\n", path);
+    return 0;
+}
+
+
+static int control_channel_apply(const char *line, double *target_fps, double *target_latency) {
+    double a, b;
+
+    if (sscanf(line, "targets %lf %lf", &a, &b) == 2 && a > 0.0 && b > 0.0) {
+        *target_fps = a;
+        *target_latency = b;
+    } else if (sscanf(line, "fps %lf", &a) == 1 && a > 0.0) {
+        *target_fps = a;
+    } else if (sscanf(line, "latency %lf", &a) == 1 && a > 0.0) {
+        *target_latency = a;
+    } else {
+        printf("[control] ignoring \"%s\"\n", line);
+        return 0;
+    }
+    printf("[control] \"%s\": target_fps=%.2f, target_latency=%.2f\n", line, *target_fps, *target_latency);
+    return 1;
+}
+
+int control_channel_poll(ControlChannel *channel, double *target_fps, double *target_latency) {
+    if (!channel->open) return 0;
+
+    const double old_fps = *target_fps;
+    const double old_latency = *target_latency;
+    char buf[CONTROL_LINE_MAX];
+    ssize_t n;
+
+    while ((n = read(channel->fd, buf, sizeof(buf))) > 0) {
+        for (ssize_t i = 0; i < n; i++) {
+            if (buf[i] == '\n' || channel->pending_len == sizeof(channel->pending) - 1) {
+                channel->pending[channel->pending_len] = '\0';
+                if (channel->pending_len > 0) control_channel_apply(channel->pending, target_fps, target_latency);
+                channel->pending_len = 0;
+                if (buf[i] == '\n') continue;
+            }
+            channel->pending[channel->pending_len++] = buf[i];
+        }
+    }
+
+    return (*target_fps != old_fps || *target_latency != old_latency) ? 1 : 0;
+}
+
+void control_channel_close(ControlChannel *channel) {
+    if (!channel->open) return;
+
+    close(channel->fd);
+    if (channel->keepalive_fd >= 0) close(channel->keepalive_fd);
+    channel->open = false;
+}
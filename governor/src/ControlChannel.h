@@ -0,0 +1,32 @@
+#ifndef CONTROLCHANNEL_H
+#define CONTROLCHANNEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define CONTROL_LINE_MAX 256
+
+// Named pipe for changing the targets of a running governor, one command per line:
+//   fps <value>
+//   latency <value>
+//   targets <fps> <latency>
+// e.g. echo "targets 12 250" > governor.ctl
+typedef struct {
+    char path[256];
+    int fd;
+    int keepalive_fd;             // our own writer, so a closed writer is not a permanent EOF
+    char pending[CONTROL_LINE_MAX];
+    size_t pending_len;
+    bool open;
+} ControlChannel;
+
+// Creates the FIFO if it does not exist yet.
+int control_channel_open(ControlChannel *channel, const char *path);
+
+// Applies every complete command waiting in the pipe, without blocking.
+// Returns 1 if a target changed, 0 if not.
+int control_channel_poll(ControlChannel *channel, double *target_fps, double *target_latency);
+
+void control_channel_close(ControlChannel *channel);
+
+#endif
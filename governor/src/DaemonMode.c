@@ -0,0 +1,215 @@
+#include "DaemonMode.h"
+#include "ApproximationModels.h"
+#include "SequentialTest.h"
+#include "DriftDetector.h"
+#include "MeasurementCache.h"
+#include "ThermalModel.h"
+#include <stdio.h>
+#include <string.h>
+
+
+// Thread counts are flags of the graph, so like the partition they take a relaunch.
+static bool daemon_same_layout(const PipelineConfig *a, const PipelineConfig *b) {
+    return a->partition_point1 == b->partition_point1 &&
+           a->partition_point2 == b->partition_point2 &&
+           get_processor_threads(a, 'B') == get_processor_threads(b, 'B') &&
+           get_processor_threads(a, 'L') == get_processor_threads(b, 'L') &&
+           strcmp(a->order, b->order) == 0;
+}
+
+static bool daemon_restart_pays(const PIDGovernor *gov, const ExecutionBackend *backend,
+                                PipelineConfig *current, PipelineConfig *next,
+                                const PipelineConfig *retuned, stats_t *stats) {
+    // A capped step trades power for fps; its layout moves were picked for the fps.
+    if (gov->power_cap > 0.0) return true;
+
+    // Missing the targets: relaunch once the frequencies have nowhere left to go.
+    if (!conditions_met(stats, gov->target_fps, gov->target_latency)) {
+        return memcmp(retuned, current, sizeof(*current)) == 0;
+    }
+
+    // The relaunch costs launch_ms at roughly the current power.
+    const double power = estimate_power(current);
+    const double saving = power - estimate_power(next);
+    return saving * DAEMON_PAYBACK_S > power * backend->launch_ms / 1e3;
+}
+
+
+// Moves the live graph to next: frequencies in place, anything else by relaunching.
+static int daemon_switch(ExecutionBackend *backend, const char *graph, PipelineConfig *config,
+                         const PipelineConfig *next, DaemonReport *report, int *settle) {
+    if (memcmp(next, config, sizeof(*next)) == 0) return 0;
+
+    if (!daemon_same_layout(next, config)) {
+        printf("[daemon] relaunching for pp1=%d pp2=%d order=%s threads=%d/%d (big_freq=%d little_freq=%d gpu_freq=%d)\n",
+               next->partition_point1, next->partition_point2, next->order, next->big_threads, next->little_threads,
+               next->big_frequency, next->little_frequency, next->gpu_frequency);
+        execution_backend_stop(backend);
+        *config = *next;
+        report->restarts++;
+        *settle = 0;
+        return execution_backend_start(backend, config, graph);
+    }
+
+    if (execution_backend_retune(backend, next) != 0) return -1;
+    printf("[daemon] retuned in place: big_freq %d -> %d, little_freq %d -> %d, gpu_freq %d -> %d\n",
+           config->big_frequency, next->big_frequency, config->little_frequency, next->little_frequency,
+           config->gpu_frequency, next->gpu_frequency);
+    *config = *next;
+    report->retunes++;
+    // The window under way mixes both settings; a graph relaunched per window has none.
+    *settle = backend->streaming ? 1 : 0;
+    return 0;
+}
+
+
+int daemon_mode_run(PIDGovernor *gov, ExecutionBackend *backend, const char *graph,
+                    PipelineConfig *config, ControlChannel *control,
+                    volatile sig_atomic_t *stop, DaemonReport *report) {
+    memset(report, 0, sizeof(*report));
+
+    if (!execution_backend_can_stream(backend)) {
+        fprintf(stderr, "daemon_mode_run: backend '%s' cannot keep a graph running\n", backend->name);
+        return -1;
+    }
+    if (!backend->live_graph) {
+        printf("[daemon] the graph only reports at exit, every window is a run of its own (--live-graph if it streams)\n");
+    }
+    if (execution_backend_start(backend, config, graph) != 0) {
+        return -1;
+    }
+
+    SequentialTest test;
+    sequential_test_init(&test, gov->target_fps, gov->target_latency);
+    DriftDetector drift;
+    drift_detector_reset(&drift);
+    const int full_budget = gov->max_iterations;
+    bool holding = false;
+    bool hot = false;
+    int settle = 0;
+    int ret = 0;
+
+    while (!*stop) {
+        stats_t window;
+        if (execution_backend_window(backend, config, graph, &window) != 0) {
+            ret = *stop ? 0 : -1;
+            break;
+        }
+        const bool was_hot = hot;
+        hot = execution_backend_thermal(backend, config);
+
+        double target_fps = gov->target_fps;
+        double target_latency = gov->target_latency;
+        if (control && control_channel_poll(control, &target_fps, &target_latency)) {
+            PipelineConfig next = *config;
+            pid_governor_retarget(gov, target_fps, target_latency, &next);
+            gov->max_iterations = full_budget;
+            sequential_test_init(&test, gov->target_fps, gov->target_latency);
+            holding = false;
+            report->retargets++;
+            if (daemon_switch(backend, graph, config, &next, report, &settle) != 0) {
+                ret = -1;
+                break;
+            }
+            continue;
+        }
+
+        if (settle > 0) {
+            settle--;
+            // A settling window is not counted, and neither are its frames in the tail.
+            latency_sketch_reset();
+            continue;
+        }
+
+        // A held configuration is only watched; a shift in any stream, or the
+        // zone reaching the throttle margin with the fan at its top level,
+        // starts a short local search from it, and the detector starts over.
+        if (holding) {
+            const bool shifted = drift_detector_add(&drift, &window);
+            if (!shifted && !(hot && !was_hot)) {
+                // Race to idle: the window that takes the idle period is not watched.
+                if (backend->pace) {
+                    const int paced = execution_backend_pace(backend, config, &window, gov->target_fps);
+                    if (paced > 0) {
+                        settle = 1;
+                    } else if (paced < 0 && !*stop) {
+                        printf("[daemon] backend '%s' cannot pause its graph, frame pacing off\n", backend->name);
+                        backend->pace = false;
+                    }
+                }
+                continue;
+            }
+
+            char shift[32];
+            if (shifted) {
+                drift_detector_describe(&drift, shift, sizeof(shift));
+            } else {
+                snprintf(shift, sizeof(shift), "thermal, %.1fC", thermal_model_temperature());
+            }
+            printf("[daemon] drift (%s) after %d windows at big_freq=%d little_freq=%d pp1=%d pp2=%d order=%s: "
+                   "fps=%.2f latency=%.2fms, searching again for up to %d iterations\n",
+                   shift, drift.windows, config->big_frequency, config->little_frequency,
+                   config->partition_point1, config->partition_point2, config->order,
+                   window.fps, window.latency, DAEMON_RESEARCH_ITERATIONS);
+            pid_governor_rearm(gov);
+            gov->max_iterations = DAEMON_RESEARCH_ITERATIONS;
+            report->rearms++;
+            holding = false;
+            sequential_test_init(&test, gov->target_fps, gov->target_latency);
+            continue;
+        }
+
+        // Windows are weighted equally; the graph decides how many frames each covers.
+        SeqDecision decision = sequential_test_add(&test, &window, 1);
+        if (decision == SEQ_EXTEND && test.windows < DAEMON_MAX_WINDOWS) continue;
+
+        stats_t stats;
+        const int windows = test.windows;
+        sequential_test_result(&test, &stats);
+        sequential_test_init(&test, gov->target_fps, gov->target_latency);
+
+        printf("[daemon] %s after %d windows: fps=%.2f latency=%.2fms (big_freq=%d little_freq=%d pp1=%d pp2=%d order=%s)\n",
+               sequential_test_decision_name(decision), windows, stats.fps, stats.latency,
+               config->big_frequency, config->little_frequency,
+               config->partition_point1, config->partition_point2, config->order);
+
+        measurement_cache_add(graph, config, &stats);
+
+        PipelineConfig next = *config;
+        double estimated_power;
+        gov->cached_stats = false;
+        PIDResult result = pid_governor_step(gov, &next, &stats, &estimated_power);
+        report->decisions++;
+        if (result == PID_CONVERGED || result == PID_MAX_ITERATIONS) {
+            holding = true;
+            drift_detector_reset(&drift);
+        }
+        if (memcmp(&next, config, sizeof(next)) == 0) continue;
+
+        PipelineConfig retuned = *config;
+        retuned.big_frequency = next.big_frequency;
+        retuned.little_frequency = next.little_frequency;
+        retuned.gpu_frequency = next.gpu_frequency;
+
+        if (!daemon_same_layout(&next, config) &&
+            !daemon_restart_pays(gov, backend, config, &next, &retuned, &stats)) {
+            printf("[daemon] pp1=%d pp2=%d order=%s does not pay for a %.0f ms relaunch, keeping pp1=%d pp2=%d order=%s\n",
+                   next.partition_point1, next.partition_point2, next.order, backend->launch_ms,
+                   config->partition_point1, config->partition_point2, config->order);
+            report->deferred++;
+            next = retuned;
+        }
+        if (daemon_switch(backend, graph, config, &next, report, &settle) != 0) {
+            ret = -1;
+            break;
+        }
+    }
+
+    execution_backend_stop(backend);
+    return ret;
+}
+
+void daemon_mode_report(const DaemonReport *report) {
+    printf("[daemon] %d decisions, %d in-place retunes, %d relaunches, %d deferred layout changes, %d re-searches, %d retargets\n",
+           report->decisions, report->retunes, report->restarts, report->deferred, report->rearms, report->retargets);
+}
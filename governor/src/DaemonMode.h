@@ -0,0 +1,42 @@
+#ifndef DAEMONMODE_H
+#define DAEMONMODE_H
+
+#include <signal.h>
+
+#include "PipelineConfig.h"
+#include "PIDController.h"
+#include "ExecutionBackend.h"
+#include "ControlChannel.h"
+
+#define DAEMON_MAX_WINDOWS 10       // windows per decision while the sequential test stays undecided
+#define DAEMON_PAYBACK_S 60.0       // a restart for a cheaper layout has to pay for itself within this
+#define DAEMON_RESEARCH_ITERATIONS 8 // PID budget of a search started by drift
+
+typedef struct {
+    int decisions;
+    int retunes;
+    int restarts;
+    int deferred;
+    int rearms;
+    int retargets;
+} DaemonReport;
+
+// Continuous mode: one live graph runs until *stop is set. Its statistics
+// blocks feed a sequential test; every decided test is one PID step.
+// Frequency changes are written under the running graph. A partition or
+// order change relaunches it only while the frequencies alone cannot meet the
+// targets, or when the predicted power saving over DAEMON_PAYBACK_S outweighs
+// the energy of a relaunch, or always under a power cap. A converged configuration is held and watched by
+// a drift detector (DriftDetector.h); a shift in fps, latency or a stage time
+// starts a search from it, bounded to DAEMON_RESEARCH_ITERATIONS steps. With
+// backend->pace, a held configuration that runs ahead of the target fps is
+// paced (execution_backend_pace) after every window the detector sees. New
+// targets from control (may be NULL) restart the search from the best
+// configuration measured so far under the new targets.
+int daemon_mode_run(PIDGovernor *gov, ExecutionBackend *backend, const char *graph,
+                    PipelineConfig *config, ControlChannel *control,
+                    volatile sig_atomic_t *stop, DaemonReport *report);
+
+void daemon_mode_report(const DaemonReport *report);
+
+#endif
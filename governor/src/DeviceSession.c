@@ -0,0 +1,385 @@
+#include "DeviceSession.h"
+#include "ThermalModel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define CPUFREQ_LITTLE_POLICY "/sys/devices/system/cpu/cpufreq/policy0"
+#define CPUFREQ_BIG_POLICY "/sys/devices/system/cpu/cpufreq/policy2"
+#define DEVFREQ_GPU "/sys/class/devfreq/ffe40000.gpu"
+#define CPU_DEVICES "/sys/devices/system/cpu"
+
+
+int device_session_open(DeviceSession *session, const char *shell_cmd,
+                        const char *working_dir, const char *sysfs_root) {
+    int to_child[2];
+    int from_child[2];
+
+    session->open = false;
+    session->has_temperature = false;
+
+    if (pipe(to_child) != 0) {
+        perror("device_session_open: pipe");
+        return -1;
+    }
+    if (pipe(from_child) != 0) {
+        perror("device_session_open: pipe");
+        close(to_child[0]);
+        close(to_child[1]);
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("device_session_open: fork");
+        close(to_child[0]);
+        close(to_child[1]);
+        close(from_child[0]);
+        close(from_child[1]);
+        return -1;
+    }
+
+    if (pid == 0) {
+        dup2(to_child[0], STDIN_FILENO);
+        dup2(from_child[1], STDOUT_FILENO);
+        dup2(from_child[1], STDERR_FILENO);
+        close(to_child[0]);
+        close(to_child[1]);
+        close(from_child[0]);
+        close(from_child[1]);
+        execl("/bin/sh", "sh", "-c", shell_cmd, (char *)NULL);
+        _exit(127);
+    }
+
+    close(to_child[0]);
+    close(from_child[1]);
+
+    // A dead device shell must show up as a failed run, not kill the governor.
+    signal(SIGPIPE, SIG_IGN);
+
+    session->pid = pid;
+    session->to_device = fdopen(to_child[1], "w");
+    session->from_device = fdopen(from_child[0], "r");
+    snprintf(session->working_dir, sizeof(session->working_dir), "%s", working_dir);
+    snprintf(session->sysfs_root, sizeof(session->sysfs_root), "%s", sysfs_root ? sysfs_root : "");
+    session->open = true;
+
+    printf("[device-session] opened \"%s\" (pid=%d, dir=%s, sysfs_root=\"%s\")\n",
+           shell_cmd, (int)pid, session->working_dir, session->sysfs_root);
+    return 0;
+}
+
+
+static void device_session_write_frequency(DeviceSession *session, const char *policy,
+                                           const char *name, int freq) {
+    FILE *out = session->to_device;
+
+    fprintf(out, "echo performance > %s%s/scaling_governor\n", session->sysfs_root, policy);
+    fprintf(out, "echo %d > %s%s/scaling_max_freq\n", freq, session->sysfs_root, policy);
+    fprintf(out, "[ \"$(cat %s%s/scaling_max_freq)\" = \"%d\" ] || echo %s %s\n",
+            session->sysfs_root, policy, freq, DEVICE_FREQ_ERROR_MARKER, name);
+}
+
+// The performance governor runs the GPU at max_freq; the check compares whole MHz.
+static void device_session_write_gpu_frequency(DeviceSession *session, int freq) {
+    FILE *out = session->to_device;
+    const int hz = gpu_devfreq_hz(freq);
+
+    fprintf(out, "echo performance > %s%s/governor\n", session->sysfs_root, DEVFREQ_GPU);
+    fprintf(out, "echo %d > %s%s/max_freq\n", hz, session->sysfs_root, DEVFREQ_GPU);
+    fprintf(out, "[ $(( ($(cat %s%s/max_freq) + 500000) / 1000000 )) = %d ] || echo %s gpu\n",
+            session->sysfs_root, DEVFREQ_GPU, gpu_devfreq_mhz(hz), DEVICE_FREQ_ERROR_MARKER);
+}
+
+
+int device_session_apply_frequencies(DeviceSession *session, const PipelineConfig *config) {
+    if (!session->open) {
+        fprintf(stderr, "device_session_apply_frequencies: session is not open\n");
+        return -1;
+    }
+
+    device_session_write_frequency(session, CPUFREQ_LITTLE_POLICY, "little", config->little_frequency);
+    device_session_write_frequency(session, CPUFREQ_BIG_POLICY, "big", config->big_frequency);
+    device_session_write_gpu_frequency(session, config->gpu_frequency);
+
+    if (session->streaming && fflush(session->to_device) != 0) {
+        fprintf(stderr, "device_session_apply_frequencies: device shell is gone\n");
+        device_session_close(session);
+        return -1;
+    }
+    return 0;
+}
+
+
+int device_session_launch(DeviceSession *session, const PipelineConfig *config,
+                          const char *graph, int n_frames) {
+    if (!session->open) {
+        fprintf(stderr, "device_session_launch: session is not open\n");
+        return -1;
+    }
+
+    fprintf(session->to_device,
+            "(cd %s && LD_LIBRARY_PATH=%s taskset %x ./%s --threads=%d --threads2=%d --target=CL --n=%d "
+            "--partition_point=%d --partition_point2=%d --order=%s < /dev/null 2>&1)\n",
+            session->working_dir, session->working_dir, get_affinity_mask(config), graph,
+            get_processor_threads(config, 'B'), get_processor_threads(config, 'L'), n_frames,
+            config->partition_point1, config->partition_point2, config->order);
+    fprintf(session->to_device, "echo %s $?\n", DEVICE_DONE_MARKER);
+
+    if (fflush(session->to_device) != 0) {
+        fprintf(stderr, "device_session_launch: device shell is gone\n");
+        device_session_close(session);
+        return -1;
+    }
+    return 0;
+}
+
+
+int device_session_collect(DeviceSession *session, stats_t *stats) {
+    if (!session->open) {
+        fprintf(stderr, "device_session_collect: session is not open\n");
+        return -1;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+
+    char *line = NULL;
+    size_t len = 0;
+    int status = -1;
+    bool done = false;
+
+    errno = 0;
+    while (getline(&line, &len, session->from_device) != -1) {
+        char *marker = strstr(line, DEVICE_DONE_MARKER);
+        if (marker) {
+            sscanf(marker + strlen(DEVICE_DONE_MARKER), "%d", &status);
+            done = true;
+            break;
+        }
+        if (strstr(line, DEVICE_FREQ_ERROR_MARKER)) {
+            fprintf(stderr, "Error: Frequency was not set correctly (%s)", line + strlen(DEVICE_FREQ_ERROR_MARKER) + 1);
+            continue;
+        }
+        if (strstr(line, DEVICE_CORE_ERROR_MARKER)) {
+            fprintf(stderr, "Error: Core was not hotplugged (%s)", line + strlen(DEVICE_CORE_ERROR_MARKER) + 1);
+            continue;
+        }
+        parse_result_line(line, stats);
+    }
+    free(line);
+
+    if (!done) {
+        if (errno == EINTR) {
+            printf("[device-session] interrupted while waiting for the graph\n");
+        } else {
+            fprintf(stderr, "device_session_collect: device shell closed the session\n");
+        }
+        device_session_close(session);
+        return -1;
+    }
+
+    if (status != 0) {
+        fprintf(stderr, "device_session_collect: graph exited with status %d\n", status);
+    }
+    return 0;
+}
+
+
+int device_session_start(DeviceSession *session, const PipelineConfig *config,
+                         const char *graph, int n_frames) {
+    if (!session->open) {
+        fprintf(stderr, "device_session_start: session is not open\n");
+        return -1;
+    }
+
+    // The subshell reports the graph's pid so it can be killed, and the done
+    // marker once it exits; the device shell itself returns immediately.
+    fprintf(session->to_device,
+            "(cd %s || exit; LD_LIBRARY_PATH=%s taskset %x ./%s --threads=%d --threads2=%d --target=CL --n=%d "
+            "--partition_point=%d --partition_point2=%d --order=%s < /dev/null 2>&1 & "
+            "echo %s $!; wait $!; echo %s $?) &\n",
+            session->working_dir, session->working_dir, get_affinity_mask(config), graph,
+            get_processor_threads(config, 'B'), get_processor_threads(config, 'L'), n_frames,
+            config->partition_point1, config->partition_point2, config->order,
+            DEVICE_PID_MARKER, DEVICE_DONE_MARKER);
+
+    if (fflush(session->to_device) != 0) {
+        fprintf(stderr, "device_session_start: device shell is gone\n");
+        device_session_close(session);
+        return -1;
+    }
+    session->streaming = true;
+    session->graph_pid = -1;
+    return 0;
+}
+
+
+// True for a temperature marker line, which then holds the reading (empty
+// if the zone could not be read).
+static bool device_session_parse_temperature(DeviceSession *session, const char *line) {
+    const char *marker = strstr(line, DEVICE_TEMP_MARKER);
+    if (!marker) return false;
+
+    int millidegrees;
+    if (sscanf(marker + strlen(DEVICE_TEMP_MARKER), "%d", &millidegrees) == 1) {
+        session->temperature = millidegrees / 1000.0;
+        session->has_temperature = true;
+    }
+    return true;
+}
+
+int device_session_read_window(DeviceSession *session, stats_t *stats) {
+    if (!session->open || !session->streaming) {
+        fprintf(stderr, "device_session_read_window: no graph streaming\n");
+        return -1;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+
+    char *line = NULL;
+    size_t len = 0;
+    int ret = -1;
+
+    errno = 0;
+    while (getline(&line, &len, session->from_device) != -1) {
+        char *marker = strstr(line, DEVICE_PID_MARKER);
+        if (marker) {
+            sscanf(marker + strlen(DEVICE_PID_MARKER), "%ld", &session->graph_pid);
+            continue;
+        }
+        marker = strstr(line, DEVICE_DONE_MARKER);
+        if (marker) {
+            int status = -1;
+            sscanf(marker + strlen(DEVICE_DONE_MARKER), "%d", &status);
+            printf("[device-session] graph exited with status %d\n", status);
+            session->streaming = false;
+            ret = 1;
+            break;
+        }
+        if (strstr(line, DEVICE_FREQ_ERROR_MARKER)) {
+            fprintf(stderr, "Error: Frequency was not set correctly (%s)", line + strlen(DEVICE_FREQ_ERROR_MARKER) + 1);
+            continue;
+        }
+        if (strstr(line, DEVICE_CORE_ERROR_MARKER)) {
+            fprintf(stderr, "Error: Core was not hotplugged (%s)", line + strlen(DEVICE_CORE_ERROR_MARKER) + 1);
+            continue;
+        }
+        if (device_session_parse_temperature(session, line)) continue;
+        // parse_result_line tokenizes the line, so look for the end of the block first.
+        bool last = strstr(line, "Frame latency is:") != NULL;
+        parse_result_line(line, stats);
+        if (last) {
+            ret = 0;
+            break;
+        }
+    }
+    free(line);
+
+    if (ret < 0) {
+        if (errno == EINTR) {
+            printf("[device-session] interrupted while waiting for the graph\n");
+        } else {
+            fprintf(stderr, "device_session_read_window: device shell closed the session\n");
+            device_session_close(session);
+        }
+    }
+    return ret;
+}
+
+
+void device_session_stop(DeviceSession *session) {
+    if (!session->open || !session->streaming) return;
+
+    stats_t discard;
+    int rc = 0;
+
+    // The pid comes before the first block, so at most one block is lost waiting for it.
+    while (session->graph_pid <= 0 && rc == 0) {
+        rc = device_session_read_window(session, &discard);
+    }
+    if (rc != 0) return;
+
+    fprintf(session->to_device, "kill %ld 2>/dev/null\n", session->graph_pid);
+    if (fflush(session->to_device) != 0) {
+        device_session_close(session);
+        return;
+    }
+
+    // Drain whatever the graph still printed, up to the done marker.
+    do {
+        rc = device_session_read_window(session, &discard);
+    } while (rc == 0);
+    session->streaming = false;
+}
+
+
+int device_session_pause(DeviceSession *session, bool paused) {
+    if (!session->open || !session->streaming || session->graph_pid <= 0) return -1;
+
+    fprintf(session->to_device, "kill -%s %ld 2>/dev/null\n", paused ? "STOP" : "CONT", session->graph_pid);
+    return fflush(session->to_device) == 0 ? 0 : -1;
+}
+
+
+int device_session_set_fan(DeviceSession *session, int enable, int mode, int level) {
+    if (!session->open) return -1;
+
+    fprintf(session->to_device, "echo %d > %s/sys/class/fan/enable\n", enable, session->sysfs_root);
+    fprintf(session->to_device, "echo %d > %s/sys/class/fan/mode\n", mode, session->sysfs_root);
+    fprintf(session->to_device, "echo %d > %s/sys/class/fan/level\n", level, session->sysfs_root);
+    return fflush(session->to_device) == 0 ? 0 : -1;
+}
+
+
+int device_session_read_temperature(DeviceSession *session, double *celsius) {
+    if (!session->open) return -1;
+
+    fprintf(session->to_device, "echo %s $(cat %s%s/temp 2>/dev/null)\n",
+            DEVICE_TEMP_MARKER, session->sysfs_root, THERMAL_ZONE);
+    if (fflush(session->to_device) != 0) return -1;
+
+    // Between runs nothing else is on the pipe, so the next marker is the answer.
+    if (!session->streaming) {
+        char *line = NULL;
+        size_t len = 0;
+        while (getline(&line, &len, session->from_device) != -1) {
+            if (device_session_parse_temperature(session, line)) break;
+        }
+        free(line);
+    }
+
+    if (!session->has_temperature) return -1;
+    *celsius = session->temperature;
+    return 0;
+}
+
+
+int device_session_set_online_cores(DeviceSession *session, unsigned int mask) {
+    if (!session->open) return -1;
+
+    for (int cpu = 0; cpu < NUM_CORES; cpu++) {
+        if (!is_parkable_core(cpu)) continue;
+        const int online = (mask >> cpu) & 1;
+        fprintf(session->to_device, "echo %d > %s%s/cpu%d/online\n", online, session->sysfs_root, CPU_DEVICES, cpu);
+        fprintf(session->to_device, "[ \"$(cat %s%s/cpu%d/online)\" = \"%d\" ] || echo %s cpu%d\n",
+                session->sysfs_root, CPU_DEVICES, cpu, online, DEVICE_CORE_ERROR_MARKER, cpu);
+    }
+    return fflush(session->to_device) == 0 ? 0 : -1;
+}
+
+
+void device_session_close(DeviceSession *session) {
+    if (!session->open) return;
+
+    fclose(session->to_device);
+    fclose(session->from_device);
+    kill(session->pid, SIGTERM);
+    waitpid(session->pid, NULL, 0);
+    session->open = false;
+    session->has_temperature = false;
+    session->streaming = false;
+}
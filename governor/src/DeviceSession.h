@@ -0,0 +1,73 @@
+#ifndef DEVICESESSION_H
+#define DEVICESESSION_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "PipelineConfig.h"
+#include "Governor.h"
+
+#define DEVICE_SHELL_CMD "adb -d shell"
+#define DEVICE_WORKING_DIR "/data/local/Working_dir"
+#define DEVICE_DONE_MARKER "__GOVERNOR_DONE__"
+#define DEVICE_FREQ_ERROR_MARKER "__GOVERNOR_FREQ_ERROR__"
+#define DEVICE_PID_MARKER "__GOVERNOR_PID__"
+#define DEVICE_CORE_ERROR_MARKER "__GOVERNOR_CORE_ERROR__"
+#define DEVICE_TEMP_MARKER "__GOVERNOR_TEMP__"
+
+// One long-lived shell on the board. Every iteration is sent as a single batch
+// (frequency writes + graph launch) and the graph output is streamed back over
+// the same pipe, so there is no adb round trip per command and no file to pull.
+typedef struct {
+    pid_t pid;
+    FILE *to_device;
+    FILE *from_device;
+    char working_dir[256];
+    char sysfs_root[256];
+    bool open;
+    bool streaming;               // a graph started with device_session_start is running
+    long graph_pid;               // its pid on the device, once reported
+    double temperature;           // last thermal zone reading, degC
+    bool has_temperature;
+} DeviceSession;
+
+// shell_cmd is any command that reads shell commands from stdin, e.g. "adb -d shell"
+// for the real board or "sh" / experiments/fake_device.sh as a stand-in.
+int device_session_open(DeviceSession *session, const char *shell_cmd,
+                        const char *working_dir, const char *sysfs_root);
+
+// Queues the writes; they go out together with the next launch, or at once
+// while a graph is streaming.
+int device_session_apply_frequencies(DeviceSession *session, const PipelineConfig *config);
+
+int device_session_launch(DeviceSession *session, const PipelineConfig *config,
+                          const char *graph, int n_frames);
+
+int device_session_collect(DeviceSession *session, stats_t *stats);
+
+// Live mode: the graph runs in the background of the device shell, so the
+// shell stays free for frequency writes while it streams statistics blocks.
+int device_session_start(DeviceSession *session, const PipelineConfig *config,
+                         const char *graph, int n_frames);
+
+// Reads up to the next "Frame latency is:" line. Returns 1 once the graph has exited.
+int device_session_read_window(DeviceSession *session, stats_t *stats);
+
+void device_session_stop(DeviceSession *session);
+
+// Stops (SIGSTOP) or resumes the streaming graph; -1 until its pid is known.
+int device_session_pause(DeviceSession *session, bool paused);
+
+int device_session_set_fan(DeviceSession *session, int enable, int mode, int level);
+
+// Between runs the reading is immediate; while a graph streams, the answer
+// comes back with a later window and the previous reading is returned.
+int device_session_read_temperature(DeviceSession *session, double *celsius);
+
+// Hotplugs the parkable cores (is_parkable_core) to match mask.
+int device_session_set_online_cores(DeviceSession *session, unsigned int mask);
+
+void device_session_close(DeviceSession *session);
+
+#endif
@@ -0,0 +1,74 @@
+#include "DriftDetector.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+static const char *DRIFT_STREAM_NAMES[DRIFT_STREAMS] = {"fps", "latency", "stage1", "stage2", "stage3"};
+
+
+void page_hinkley_reset(PageHinkley *ph) {
+    memset(ph, 0, sizeof(*ph));
+}
+
+int page_hinkley_add(PageHinkley *ph, double x) {
+    ph->n++;
+    double delta = x - ph->mean;
+    ph->mean += delta / ph->n;
+    ph->m2 += delta * (x - ph->mean);
+
+    if (ph->n <= DRIFT_WARMUP_WINDOWS) {
+        ph->baseline = ph->mean;
+        return 0;
+    }
+    if (ph->baseline <= 0.0) return 0;
+
+    double sd = sqrt(ph->m2 / (ph->n - 1));
+    if (sd < DRIFT_MIN_CV * ph->baseline) sd = DRIFT_MIN_CV * ph->baseline;
+
+    const double z = (x - ph->baseline) / sd;
+    const int k = ph->n - DRIFT_WARMUP_WINDOWS;
+    ph->drift_mean += (z - ph->drift_mean) / k;
+
+    ph->up += z - ph->drift_mean - DRIFT_DELTA;
+    if (ph->up < ph->up_min) ph->up_min = ph->up;
+    ph->down += z - ph->drift_mean + DRIFT_DELTA;
+    if (ph->down > ph->down_max) ph->down_max = ph->down;
+
+    if (ph->up - ph->up_min > DRIFT_LAMBDA) return 1;
+    if (ph->down_max - ph->down > DRIFT_LAMBDA) return -1;
+    return 0;
+}
+
+
+void drift_detector_reset(DriftDetector *detector) {
+    memset(detector, 0, sizeof(*detector));
+    detector->shifted_stream = -1;
+}
+
+bool drift_detector_add(DriftDetector *detector, const stats_t *window) {
+    const double values[DRIFT_STREAMS] = {
+        window->fps, window->latency,
+        window->stage1_inference_time, window->stage2_inference_time, window->stage3_inference_time
+    };
+
+    detector->windows++;
+    for (int i = 0; i < DRIFT_STREAMS; i++) {
+        // Empty stages report nothing; a stream that never had a baseline stays quiet.
+        if (values[i] <= 0.0) continue;
+
+        int direction = page_hinkley_add(&detector->streams[i], values[i]);
+        if (direction != 0 && detector->shifted_stream < 0) {
+            detector->shifted_stream = i;
+            detector->direction = direction;
+        }
+    }
+    return detector->shifted_stream >= 0;
+}
+
+void drift_detector_describe(const DriftDetector *detector, char *buf, int len) {
+    if (detector->shifted_stream < 0) {
+        snprintf(buf, len, "none");
+        return;
+    }
+    snprintf(buf, len, "%s%c", DRIFT_STREAM_NAMES[detector->shifted_stream], detector->direction > 0 ? '+' : '-');
+}
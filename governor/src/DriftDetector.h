@@ -0,0 +1,49 @@
+#ifndef DRIFTDETECTOR_H
+#define DRIFTDETECTOR_H
+
+#include <stdbool.h>
+
+#include "Governor.h"
+
+#define DRIFT_STREAMS 5             // fps, latency, stage1-3 inference time
+#define DRIFT_WARMUP_WINDOWS 10     // windows averaged into the baseline
+#define DRIFT_DELTA 0.5             // change tolerated per window, in window-to-window deviations
+#define DRIFT_LAMBDA 12.0           // cumulative change that counts as a shift, same unit
+#define DRIFT_MIN_CV 0.01           // floor on the deviation, relative to the baseline
+
+// Two-sided Page-Hinkley test on one stream. Samples are measured in units of
+// the stream's own window-to-window deviation, so a noisy stream needs a
+// proportionally larger shift.
+typedef struct {
+    double baseline;
+    int n;
+    double mean, m2;              // Welford over all samples, for the deviation
+    double drift_mean;            // running mean of the normalized samples after warm-up
+    double up, up_min;
+    double down, down_max;
+} PageHinkley;
+
+void page_hinkley_reset(PageHinkley *ph);
+
+// Returns +1 or -1 once the stream has shifted up or down, 0 otherwise.
+int page_hinkley_add(PageHinkley *ph, double x);
+
+// Watches the streams of one held configuration. After DRIFT_WARMUP_WINDOWS
+// windows set the baselines, a stream that moves by more than DRIFT_DELTA
+// deviations per window for long enough to accumulate DRIFT_LAMBDA is a
+// shift; noise around the baseline is absorbed by the DRIFT_DELTA allowance.
+typedef struct {
+    PageHinkley streams[DRIFT_STREAMS];
+    int windows;
+    int shifted_stream;
+    int direction;
+} DriftDetector;
+
+void drift_detector_reset(DriftDetector *detector);
+
+bool drift_detector_add(DriftDetector *detector, const stats_t *window);
+
+// "fps+", "stage2-" etc. for the last detected shift.
+void drift_detector_describe(const DriftDetector *detector, char *buf, int len);
+
+#endif
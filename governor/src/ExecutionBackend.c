@@ -0,0 +1,609 @@
+#include "ExecutionBackend.h"
+#include "DeviceSession.h"
+#include "NativeBackend.h"
+#include "ReplaySimulator.h"
+#include "SequentialTest.h"
+#include "ThermalModel.h"
+#include "ApproximationModels.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+
+/* ---- scripts: the original set_freq.sh / run_inference.sh path ---- */
+
+typedef struct {
+    time_t output_mtime;
+} ScriptsBackend;
+
+static time_t get_file_mtime(const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return 0;
+    }
+    return st.st_mtime;
+}
+
+static int scripts_setup(void *ctx) {
+    (void)ctx;
+    system("adb -d root");
+
+    /* Export OpenCL library path */
+    setenv("LD_LIBRARY_PATH", "/data/local/Working_dir", 1);
+
+    /* Setup Performance Governor (CPU) */
+    system("adb -d shell \"echo performance > /sys/devices/system/cpu/cpufreq/policy0/scaling_governor\"");
+    system("adb -d shell \"echo performance > /sys/devices/system/cpu/cpufreq/policy2/scaling_governor\"");
+
+    /* GPU (Mali devfreq): performance runs at max_freq, which set_freq.sh gpu moves */
+    system("adb -d shell \"echo performance > /sys/class/devfreq/ffe40000.gpu/governor\"");
+    return 0;
+}
+
+static int scripts_apply_frequencies(void *ctx, const PipelineConfig *config) {
+    (void)ctx;
+    char command[256];
+    sprintf(command, "./set_freq.sh little %d", config->little_frequency);
+    system(command);
+    sprintf(command, "./set_freq.sh big %d", config->big_frequency);
+    system(command);
+    sprintf(command, "./set_freq.sh gpu %d", config->gpu_frequency);
+    system(command);
+    return 0;
+}
+
+static int scripts_launch(void *ctx, const PipelineConfig *config, const char *graph, int n_frames) {
+    ScriptsBackend *sb = ctx;
+    char command[256];
+
+    sb->output_mtime = get_file_mtime("last_run_output.txt");
+    sprintf(command, "./run_inference.sh %s %d %d %d %s %d %d > output.txt 2>&1",
+        graph, n_frames, config->partition_point1, config->partition_point2, config->order,
+        get_processor_threads(config, 'B'), get_processor_threads(config, 'L'));
+    system(command);
+    return 0;
+}
+
+static int scripts_collect(void *ctx, stats_t *stats) {
+    ScriptsBackend *sb = ctx;
+
+    // run_inference.sh only pulls a new file when the run finished; an unchanged
+    // mtime means it was interrupted (Ctrl-C is swallowed by system()).
+    if (get_file_mtime("last_run_output.txt") == sb->output_mtime) {
+        printf("[scripts] no new last_run_output.txt, inference was interrupted\n");
+        return -1;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    parse_results(stats);
+    return 0;
+}
+
+static int scripts_set_fan(void *ctx, int enable, int mode, int level) {
+    (void)ctx;
+    char command[64];
+    sprintf(command, "./set_fan.sh %d %d %d", enable, mode, level);
+    system(command);
+    return 0;
+}
+
+static int scripts_read_temperature(void *ctx, double *celsius) {
+    (void)ctx;
+    FILE *p = popen("adb -d shell cat " THERMAL_ZONE "/temp", "r");
+    if (!p) return -1;
+    int millidegrees = 0;
+    int n = fscanf(p, "%d", &millidegrees);
+    pclose(p);
+    if (n != 1) return -1;
+    *celsius = millidegrees / 1000.0;
+    return 0;
+}
+
+static int scripts_set_online_cores(void *ctx, unsigned int mask) {
+    (void)ctx;
+    char command[64];
+    sprintf(command, "./set_cores.sh %x", mask);
+    return system(command) == 0 ? 0 : -1;
+}
+
+
+/* ---- session: persistent device shell (DeviceSession.c) ---- */
+
+static int session_apply_frequencies(void *ctx, const PipelineConfig *config) {
+    return device_session_apply_frequencies(ctx, config);
+}
+
+static int session_launch(void *ctx, const PipelineConfig *config, const char *graph, int n_frames) {
+    return device_session_launch(ctx, config, graph, n_frames);
+}
+
+static int session_collect(void *ctx, stats_t *stats) {
+    return device_session_collect(ctx, stats);
+}
+
+static int session_set_fan(void *ctx, int enable, int mode, int level) {
+    return device_session_set_fan(ctx, enable, mode, level);
+}
+
+static int session_read_temperature(void *ctx, double *celsius) {
+    return device_session_read_temperature(ctx, celsius);
+}
+
+static int session_set_online_cores(void *ctx, unsigned int mask) {
+    return device_session_set_online_cores(ctx, mask);
+}
+
+static void session_close(void *ctx) {
+    device_session_close(ctx);
+}
+
+static int session_start(void *ctx, const PipelineConfig *config, const char *graph, int n_frames) {
+    return device_session_start(ctx, config, graph, n_frames);
+}
+
+static int session_read_window(void *ctx, int frames, stats_t *stats) {
+    (void)frames;
+    return device_session_read_window(ctx, stats);
+}
+
+static void session_stop(void *ctx) {
+    device_session_stop(ctx);
+}
+
+static int session_pause_graph(void *ctx, bool paused) {
+    return device_session_pause(ctx, paused);
+}
+
+
+/* ---- native: on-board sysfs + fork/execv (NativeBackend.c) ---- */
+
+static int native_apply_frequencies(void *ctx, const PipelineConfig *config) {
+    return native_backend_set_frequencies(ctx, config);
+}
+
+static int native_launch(void *ctx, const PipelineConfig *config, const char *graph, int n_frames) {
+    return native_backend_launch(ctx, config, graph, n_frames);
+}
+
+static int native_collect(void *ctx, stats_t *stats) {
+    return native_backend_collect(ctx, stats);
+}
+
+static int native_set_fan(void *ctx, int enable, int mode, int level) {
+    return native_backend_set_fan(ctx, enable, mode, level);
+}
+
+static int native_read_temperature(void *ctx, double *celsius) {
+    return native_backend_read_temperature(ctx, celsius);
+}
+
+static int native_set_online_cores(void *ctx, unsigned int mask) {
+    return native_backend_set_online_cores(ctx, mask);
+}
+
+static int native_read_window(void *ctx, int frames, stats_t *stats) {
+    (void)frames;
+    return native_backend_read_window(ctx, stats);
+}
+
+static void native_stop(void *ctx) {
+    native_backend_stop(ctx);
+}
+
+static int native_pause_graph(void *ctx, bool paused) {
+    return native_backend_pause(ctx, paused);
+}
+
+
+/* ---- sim: measurement replay from experiments/data (ReplaySimulator.c) ---- */
+
+typedef struct {
+    ReplaySimulator sim;
+    PipelineConfig config;
+    int n_frames;
+} SimBackend;
+
+static int sim_apply_frequencies(void *ctx, const PipelineConfig *config) {
+    SimBackend *sb = ctx;
+    sb->config.big_frequency = config->big_frequency;
+    sb->config.little_frequency = config->little_frequency;
+    sb->config.gpu_frequency = config->gpu_frequency;
+    return 0;
+}
+
+static int sim_launch(void *ctx, const PipelineConfig *config, const char *graph, int n_frames) {
+    SimBackend *sb = ctx;
+    (void)graph;
+    sb->config.partition_point1 = config->partition_point1;
+    sb->config.partition_point2 = config->partition_point2;
+    sb->config.big_threads = config->big_threads;
+    sb->config.little_threads = config->little_threads;
+    memcpy(sb->config.order, config->order, sizeof(sb->config.order));
+    sb->n_frames = n_frames;
+    return 0;
+}
+
+static int sim_collect(void *ctx, stats_t *stats) {
+    SimBackend *sb = ctx;
+    if (replay_simulator_sample(&sb->sim, &sb->config, sb->n_frames, stats) != 0) {
+        return -1;
+    }
+    printf("Throughput is: %lf FPS\n", stats->fps);
+    printf("Latency is: %lf ms\n", stats->latency);
+    return 0;
+}
+
+// A live sim graph never runs out; every block is a fresh sample under the
+// frequencies applied so far.
+static int sim_read_window(void *ctx, int frames, stats_t *stats) {
+    SimBackend *sb = ctx;
+    sb->n_frames = frames;
+    return sim_collect(ctx, stats);
+}
+
+static void sim_close(void *ctx) {
+    SimBackend *sb = ctx;
+    replay_simulator_free(&sb->sim);
+}
+
+
+int execution_backend_open(ExecutionBackend *backend, const char *name, const BackendOptions *options) {
+    memset(backend, 0, sizeof(*backend));
+    backend->fan_level = -1;
+
+    if (strcmp(name, "scripts") == 0) {
+        backend->name = "scripts";
+        backend->ctx = calloc(1, sizeof(ScriptsBackend));
+        backend->setup = scripts_setup;
+        backend->apply_frequencies = scripts_apply_frequencies;
+        backend->launch = scripts_launch;
+        backend->collect = scripts_collect;
+        backend->set_fan = scripts_set_fan;
+        backend->set_online_cores = scripts_set_online_cores;
+        backend->read_temperature = scripts_read_temperature;
+    } else if (strcmp(name, "session") == 0) {
+        DeviceSession *session = calloc(1, sizeof(DeviceSession));
+        // adbd has to be root before the shell is opened; stand-ins skip this.
+        if (strncmp(options->device_cmd, "adb", 3) == 0) {
+            system("adb -d root");
+        }
+        if (device_session_open(session, options->device_cmd, options->device_dir, options->sysfs_root) != 0) {
+            free(session);
+            return -1;
+        }
+        backend->name = "session";
+        backend->ctx = session;
+        backend->apply_frequencies = session_apply_frequencies;
+        backend->launch = session_launch;
+        backend->collect = session_collect;
+        backend->set_fan = session_set_fan;
+        backend->set_online_cores = session_set_online_cores;
+        backend->read_temperature = session_read_temperature;
+        backend->close = session_close;
+        backend->start = session_start;
+        backend->read_window = session_read_window;
+        backend->stop = session_stop;
+        backend->pause_graph = session_pause_graph;
+    } else if (strcmp(name, "native") == 0) {
+        NativeBackend *nb = calloc(1, sizeof(NativeBackend));
+        if (native_backend_init(nb, options->device_dir, options->sysfs_root) != 0) {
+            free(nb);
+            return -1;
+        }
+        backend->name = "native";
+        backend->ctx = nb;
+        backend->apply_frequencies = native_apply_frequencies;
+        backend->launch = native_launch;
+        backend->collect = native_collect;
+        backend->set_fan = native_set_fan;
+        backend->set_online_cores = native_set_online_cores;
+        backend->read_temperature = native_read_temperature;
+        backend->start = native_launch;
+        backend->read_window = native_read_window;
+        backend->stop = native_stop;
+        backend->pause_graph = native_pause_graph;
+    } else if (strcmp(name, "sim") == 0) {
+        SimBackend *sb = calloc(1, sizeof(SimBackend));
+        const char *data_dir = options->sim_data_dir ? options->sim_data_dir : REPLAY_DEFAULT_DATA_DIR;
+        if (replay_simulator_load(&sb->sim, data_dir) != 0) {
+            free(sb);
+            return -1;
+        }
+        replay_simulator_seed(&sb->sim, options->sim_seed, options->sim_noise);
+        backend->name = "sim";
+        backend->ctx = sb;
+        backend->apply_frequencies = sim_apply_frequencies;
+        backend->launch = sim_launch;
+        backend->collect = sim_collect;
+        backend->close = sim_close;
+        backend->start = sim_launch;
+        backend->read_window = sim_read_window;
+        backend->live_graph = true;
+    } else {
+        fprintf(stderr, "execution_backend_open: unknown backend '%s'\n", name);
+        return -1;
+    }
+
+    if (backend->setup && backend->setup(backend->ctx) != 0) {
+        fprintf(stderr, "execution_backend_open: setup of backend '%s' failed\n", name);
+        execution_backend_close(backend);
+        return -1;
+    }
+    return 0;
+}
+
+
+// Cores outside the affinity mask go offline before the graph that leaves them
+// unused is launched; a failed write only costs the saving.
+static void backend_park_cores(ExecutionBackend *backend, const PipelineConfig *config) {
+    if (!backend->park_cores || !backend->set_online_cores) return;
+
+    const unsigned int mask = get_affinity_mask(config);
+    if (mask == backend->online_mask) return;
+    if (backend->set_online_cores(backend->ctx, mask) != 0) {
+        fprintf(stderr, "[backend] %s: parking the cores outside 0x%x failed\n", backend->name, mask);
+    } else {
+        printf("[backend] %s: cores online 0x%x\n", backend->name, mask);
+    }
+    backend->online_mask = mask;
+}
+
+// Energy per frame from the mean board power over the last span seconds of
+// the run (all of it for 0) at the throughput the run reported.
+static void backend_measure_energy(ExecutionBackend *backend, double span, stats_t *stats) {
+    double watts;
+
+    stats->energy_per_frame = 0.0;
+    if (!power_sensor_enabled(backend->power_sensor) || stats->fps <= 0.0) return;
+    if (power_sensor_end(backend->power_sensor, span, &watts) == 0) stats->energy_per_frame = watts / stats->fps;
+}
+
+static int backend_run(ExecutionBackend *backend, const PipelineConfig *config,
+                       const char *graph, int n_frames, stats_t *stats, bool apply) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // A frequency that did not stick is reported but, as with set_freq.sh, the run goes on.
+    if (apply && backend->apply_frequencies(backend->ctx, config) != 0) {
+        fprintf(stderr, "[backend] %s: applying frequencies failed\n", backend->name);
+    }
+    if (apply) backend_park_cores(backend, config);
+    power_sensor_begin(backend->power_sensor);
+    if (backend->launch(backend->ctx, config, graph, n_frames) != 0) {
+        return -1;
+    }
+    if (backend->collect(backend->ctx, stats) != 0) {
+        return -1;
+    }
+    // Only the timed frames, not graph setup.
+    backend_measure_energy(backend, stats->fps > 0.0 ? n_frames / stats->fps : 0.0, stats);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed_ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+    backend->runs++;
+    backend->frames += n_frames;
+    backend->total_run_ms += elapsed_ms;
+    printf("[backend] %s: run %d took %.1f ms\n", backend->name, backend->runs, elapsed_ms);
+    return 0;
+}
+
+int execution_backend_run(ExecutionBackend *backend, PipelineConfig *config,
+                          const char *graph, int n_frames, stats_t *stats) {
+    latency_sketch_reset();
+    return backend_run(backend, config, graph, n_frames, stats, true);
+}
+
+
+int execution_backend_measure(ExecutionBackend *backend, PipelineConfig *config, const char *graph,
+                              int n_frames, double target_fps, double target_latency, stats_t *stats) {
+    if (backend->window_frames <= 0 || backend->window_frames >= n_frames) {
+        latency_sketch_reset();
+        return backend_run(backend, config, graph, n_frames, stats, true);
+    }
+
+    // The graph only reports totals when it exits, so every window is a short run of its own.
+    SequentialTest test;
+    SeqDecision decision = SEQ_EXTEND;
+    sequential_test_init(&test, target_fps, target_latency);
+
+    while (test.frames < n_frames && decision == SEQ_EXTEND) {
+        int frames = n_frames - test.frames;
+        if (frames > backend->window_frames) frames = backend->window_frames;
+
+        stats_t window;
+        memset(&window, 0, sizeof(window));
+        if (backend_run(backend, config, graph, frames, &window, test.windows == 0) != 0) {
+            return -1;
+        }
+        decision = sequential_test_add(&test, &window, frames);
+    }
+
+    sequential_test_result(&test, stats);
+    printf("[measure] %s after %d frames in %d windows: fps=%.2f+-%.2f latency=%.2f+-%.2fms\n",
+           sequential_test_decision_name(decision), test.frames, test.windows,
+           test.fps_mean, test.fps_half_width, test.latency_mean, test.latency_half_width);
+    return 0;
+}
+
+
+bool execution_backend_can_stream(const ExecutionBackend *backend) {
+    return backend->start && backend->read_window;
+}
+
+static int backend_window_frames(const ExecutionBackend *backend) {
+    return backend->window_frames > 0 ? backend->window_frames : SEQ_WINDOW_DEFAULT;
+}
+
+int execution_backend_start(ExecutionBackend *backend, const PipelineConfig *config, const char *graph) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (backend->apply_frequencies(backend->ctx, config) != 0) {
+        fprintf(stderr, "[backend] %s: applying frequencies failed\n", backend->name);
+    }
+    backend_park_cores(backend, config);
+    if (!backend->live_graph) {
+        // Every window pays for its own launch, so a layout change costs nothing extra.
+        latency_sketch_reset();
+        backend->launch_ms = 0.0;
+        return 0;
+    }
+    if (backend->start(backend->ctx, config, graph, BACKEND_STREAM_FRAMES) != 0) {
+        return -1;
+    }
+    backend->streaming = true;
+    backend->launches++;
+
+    stats_t warmup;
+    if (backend->read_window(backend->ctx, backend_window_frames(backend), &warmup) != 0) {
+        execution_backend_stop(backend);
+        return -1;
+    }
+    // The tail is of the frames after the warmup window.
+    latency_sketch_reset();
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    backend->launch_ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+    printf("[backend] %s: live graph %d up after %.1f ms (pp1=%d pp2=%d order=%s)\n",
+           backend->name, backend->launches, backend->launch_ms,
+           config->partition_point1, config->partition_point2, config->order);
+    return 0;
+}
+
+int execution_backend_window(ExecutionBackend *backend, const PipelineConfig *config,
+                             const char *graph, stats_t *stats) {
+    const int frames = backend_window_frames(backend);
+
+    if (!backend->live_graph) {
+        if (backend_run(backend, config, graph, frames, stats, false) != 0) return -1;
+        backend->windows++;
+        return 0;
+    }
+
+    power_sensor_begin(backend->power_sensor);
+    int rc = backend->read_window(backend->ctx, frames, stats);
+    if (rc == 1) {
+        printf("[backend] %s: live graph ran out of frames, starting it again\n", backend->name);
+        backend->streaming = false;
+        if (execution_backend_start(backend, config, graph) != 0) return -1;
+        power_sensor_begin(backend->power_sensor);
+        rc = backend->read_window(backend->ctx, frames, stats);
+    }
+    if (rc != 0) return -1;
+    backend_measure_energy(backend, 0.0, stats);
+
+    backend->windows++;
+    backend->frames += frames;
+    return 0;
+}
+
+int execution_backend_retune(ExecutionBackend *backend, const PipelineConfig *config) {
+    if (backend->apply_frequencies(backend->ctx, config) != 0) {
+        fprintf(stderr, "[backend] %s: applying frequencies failed\n", backend->name);
+        return -1;
+    }
+    return 0;
+}
+
+int execution_backend_pace(ExecutionBackend *backend, const PipelineConfig *config,
+                           const stats_t *window, double target_fps) {
+    if (!backend->pause_graph || !backend->streaming) return -1;
+    if (target_fps <= 0.0 || window->fps <= target_fps) return 0;
+
+    const double slack = 2.0 * backend_window_frames(backend) * (1.0 / target_fps - 1.0 / window->fps);
+    if (slack < BACKEND_PACE_MIN_S) return 0;
+
+    PipelineConfig idle = *config;
+    idle.big_frequency = BIG_FREQUENCY_TABLE[0];
+    idle.little_frequency = LITTLE_FREQUENCY_TABLE[0];
+    idle.gpu_frequency = GPU_FREQUENCY_TABLE[0];
+
+    if (backend->pause_graph(backend->ctx, true) != 0) return -1;
+    backend->apply_frequencies(backend->ctx, &idle);
+
+    // A signal cuts the idle period short; the caller decides what it meant.
+    const struct timespec ts = {(time_t)slack, (long)((slack - (time_t)slack) * 1e9)};
+    nanosleep(&ts, NULL);
+
+    int rc = backend->apply_frequencies(backend->ctx, config);
+    if (backend->pause_graph(backend->ctx, false) != 0 || rc != 0) {
+        fprintf(stderr, "[backend] %s: resuming the graph after pacing failed\n", backend->name);
+        return -1;
+    }
+    backend->paced++;
+    backend->paced_s += slack;
+    return 1;
+}
+
+void execution_backend_stop(ExecutionBackend *backend) {
+    if (!backend->streaming) return;
+    if (backend->stop) backend->stop(backend->ctx);
+    backend->streaming = false;
+}
+
+
+int execution_backend_set_fan(ExecutionBackend *backend, int enable, int mode, int level) {
+    if (!backend->set_fan) return 0;
+    if (backend->set_fan(backend->ctx, enable, mode, level) != 0) return -1;
+    backend->fan_level = enable ? level : 0;
+    return 0;
+}
+
+bool execution_backend_thermal(ExecutionBackend *backend, const PipelineConfig *config) {
+    double celsius;
+    if (!backend->read_temperature || backend->read_temperature(backend->ctx, &celsius) != 0) return false;
+
+    PipelineConfig ran = *config;
+    const double power = estimate_pipeline_power(&ran);
+    const int current = backend->fan_level < 0 ? 0 : backend->fan_level;
+    thermal_model_observe(celsius, power, current);
+
+    const double limit = thermal_model_throttle() - THERMAL_MARGIN;
+    int level = thermal_model_fan_level(power);
+    if (level < 0) level = FAN_LEVELS - 1;
+    if (celsius >= limit && level <= current) level = current + 1;
+    // Slow down only once well clear of the limit, or the fan hunts.
+    if (level < current && celsius > limit - THERMAL_MARGIN) level = current;
+    if (level >= FAN_LEVELS) level = FAN_LEVELS - 1;
+
+    if (backend->set_fan && level != backend->fan_level) {
+        printf("[thermal] %.1fC at %.2fW: fan level %d -> %d\n", celsius, power, backend->fan_level, level);
+        execution_backend_set_fan(backend, 1, 0, level);
+    }
+    return celsius >= limit && level == FAN_LEVELS - 1;
+}
+
+
+void execution_backend_report(const ExecutionBackend *backend) {
+    if (backend->launches > 0) {
+        printf("[backend] %s: %d live graph launches, %d windows, %ld frames, last launch %.1f ms\n",
+               backend->name, backend->launches, backend->windows, backend->frames, backend->launch_ms);
+    }
+    if (backend->paced > 0) {
+        printf("[backend] %s: paced %d times, %.1f s idle at the lowest OPPs\n",
+               backend->name, backend->paced, backend->paced_s);
+    }
+    if (backend->runs == 0) {
+        if (backend->launches == 0) printf("[backend] %s: no completed runs\n", backend->name);
+        return;
+    }
+    printf("[backend] %s: %d runs, %ld frames, %.1f ms total, %.1f ms per run\n",
+           backend->name, backend->runs, backend->frames, backend->total_run_ms,
+           backend->total_run_ms / backend->runs);
+}
+
+
+void execution_backend_close(ExecutionBackend *backend) {
+    execution_backend_stop(backend);
+    if (backend->online_mask != 0 && backend->online_mask != ALL_CORES_MASK) {
+        backend->set_online_cores(backend->ctx, ALL_CORES_MASK);
+        backend->online_mask = ALL_CORES_MASK;
+    }
+    if (backend->close) {
+        backend->close(backend->ctx);
+    }
+    free(backend->ctx);
+    backend->ctx = NULL;
+}
@@ -0,0 +1,117 @@
+#ifndef EXECUTIONBACKEND_H
+#define EXECUTIONBACKEND_H
+
+#include <stdbool.h>
+
+#include "PipelineConfig.h"
+#include "Governor.h"
+#include "PowerSensor.h"
+
+#define BACKEND_DEFAULT "session"
+#define BACKEND_STREAM_FRAMES 100000    // --n of a live graph; it is relaunched when it runs out
+#define BACKEND_PACE_MIN_S 0.05         // shorter idle periods cost more in OPP changes than they save
+
+typedef struct {
+    const char *device_cmd;
+    const char *device_dir;
+    const char *sysfs_root;
+    const char *sim_data_dir;
+    unsigned long long sim_seed;
+    double sim_noise;
+} BackendOptions;
+
+// Everything the governor needs from whatever executes the pipeline: the real
+// board over adb, the board itself (native) or a simulator. Each run is
+// apply_frequencies -> launch -> collect; setup, set_fan, set_online_cores,
+// read_temperature and close are optional.
+// Backends that can keep a graph running also provide start, read_window and
+// stop; frequencies are then applied while it runs, and pause_graph, where
+// present, stops and resumes it for frame pacing. That takes a graph that
+// prints its statistics while it runs (live_graph); the ARMCL graph only
+// prints them at exit.
+typedef struct ExecutionBackend {
+    const char *name;
+    void *ctx;
+    int (*setup)(void *ctx);
+    int (*apply_frequencies)(void *ctx, const PipelineConfig *config);
+    int (*launch)(void *ctx, const PipelineConfig *config, const char *graph, int n_frames);
+    int (*collect)(void *ctx, stats_t *stats);
+    int (*set_fan)(void *ctx, int enable, int mode, int level);
+    int (*set_online_cores)(void *ctx, unsigned int mask);
+    int (*read_temperature)(void *ctx, double *celsius);
+    void (*close)(void *ctx);
+    int (*start)(void *ctx, const PipelineConfig *config, const char *graph, int n_frames);
+    int (*read_window)(void *ctx, int frames, stats_t *stats);
+    void (*stop)(void *ctx);
+    int (*pause_graph)(void *ctx, bool paused);
+
+    int window_frames;            // measurement window for execution_backend_measure, 0 = one run
+    bool live_graph;              // the graph prints a statistics block every window (--live-graph)
+    bool park_cores;              // take the cores outside the affinity mask offline
+    unsigned int online_mask;     // cores last left online, 0 = untouched
+    int fan_level;                // last level set, -1 = unknown
+    PowerSensor *power_sensor;    // fills stats->energy_per_frame, NULL = none
+    bool pace;                    // idle the live graph at the lowest OPPs between windows (--pace)
+    int paced;                    // idle periods taken
+    double paced_s;
+    int runs;
+    long frames;
+    double total_run_ms;
+    bool streaming;
+    int windows;                  // statistics blocks read from live graphs
+    int launches;
+    double launch_ms;             // start to the end of the warm-up block, last launch
+} ExecutionBackend;
+
+int execution_backend_open(ExecutionBackend *backend, const char *name, const BackendOptions *options);
+
+int execution_backend_run(ExecutionBackend *backend, PipelineConfig *config,
+                          const char *graph, int n_frames, stats_t *stats);
+
+// Measures a configuration in windows of backend->window_frames until a
+// sequential test (SequentialTest.h) decides it clearly meets or misses the
+// targets, or n_frames are used up. Frequencies are applied once.
+int execution_backend_measure(ExecutionBackend *backend, PipelineConfig *config, const char *graph,
+                              int n_frames, double target_fps, double target_latency, stats_t *stats);
+
+bool execution_backend_can_stream(const ExecutionBackend *backend);
+
+// Starts a live graph with config and discards its first statistics block,
+// which covers graph setup and warm-up. Without backend->live_graph it only
+// applies config; every window is then a short run of its own.
+int execution_backend_start(ExecutionBackend *backend, const PipelineConfig *config, const char *graph);
+
+// Next statistics block of the live graph; a graph that ran out of frames is
+// started again with the same configuration.
+int execution_backend_window(ExecutionBackend *backend, const PipelineConfig *config,
+                             const char *graph, stats_t *stats);
+
+// Changes the frequencies under the live graph.
+int execution_backend_retune(ExecutionBackend *backend, const PipelineConfig *config);
+
+// Frame pacing after a window of the live graph that ran faster than
+// target_fps: the graph is stopped, the clusters and the GPU drop to their
+// lowest OPPs for the time it got ahead over this window and the next, and
+// config is restored before it resumes. The window after is therefore not a
+// measurement of config. Returns 1 if it idled, 0 if the slack was too short
+// to be worth it, -1 if the backend cannot stop its graph.
+int execution_backend_pace(ExecutionBackend *backend, const PipelineConfig *config,
+                           const stats_t *window, double target_fps);
+
+void execution_backend_stop(ExecutionBackend *backend);
+
+int execution_backend_set_fan(ExecutionBackend *backend, int enable, int mode, int level);
+
+// Reads the thermal zone, feeds it to the thermal model together with the
+// power of config, which ran since the last reading, and moves the fan to the
+// lowest level that keeps config THERMAL_MARGIN below the throttle point; one
+// level up regardless while the reading is that close. Returns true if the
+// zone is that close with the fan at its top level. A no-op without a
+// temperature reading.
+bool execution_backend_thermal(ExecutionBackend *backend, const PipelineConfig *config);
+
+void execution_backend_report(const ExecutionBackend *backend);
+
+void execution_backend_close(ExecutionBackend *backend);
+
+#endif
@@ -0,0 +1,277 @@
+#include "FrontierTable.h"
+#include "ApproximationModels.h"
+#include "Optimizer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+static int frontier_cmp_latency(const void *a, const void *b) {
+    const FrontierEntry *x = a;
+    const FrontierEntry *y = b;
+    if (x->latency != y->latency) return (x->latency > y->latency) - (x->latency < y->latency);
+    return (x->power > y->power) - (x->power < y->power);
+}
+
+// Adds p to the staircase (fps ascending, power ascending). Returns 1 if the
+// staircase changed, 0 if p is dominated by a point that is at least as fast and cheap.
+static int frontier_staircase_insert(FrontierEntry *stairs, int *n, const FrontierEntry *p) {
+    int i = 0;
+    while (i < *n && stairs[i].fps < p->fps) i++;
+    if (i < *n && stairs[i].power <= p->power) return 0;
+
+    // Drop what p dominates: slower or equally fast points that cost at least as much.
+    int end = (i < *n && stairs[i].fps == p->fps) ? i + 1 : i;
+    int start = i;
+    while (start > 0 && stairs[start - 1].power >= p->power) start--;
+
+    memmove(&stairs[start + 1], &stairs[end], (size_t)(*n - end) * sizeof(FrontierEntry));
+    stairs[start] = *p;
+    *n += 1 - (end - start);
+    return 1;
+}
+
+
+int frontier_table_build(const char *graph, const char *path) {
+    const int max_configs = OPTIMIZER_NUM_ORDERS * (TOTAL_LAYERS + 1) * (TOTAL_LAYERS + 1) *
+                            NUM_BIG_FREQUENCIES * NUM_LITTLE_FREQUENCIES * NUM_GPU_FREQUENCIES *
+                            MAX_BIG_THREADS * MAX_LITTLE_THREADS;
+    FrontierEntry *points = malloc((size_t)max_configs * sizeof(FrontierEntry));
+    FrontierEntry *stairs = malloc((size_t)max_configs * sizeof(FrontierEntry));
+    FrontierBucket *buckets = NULL;
+    FrontierEntry *entries = NULL;
+    int n_points = 0, n_stairs = 0, n_buckets = 0, n_entries = 0;
+    int cap_buckets = 0, cap_entries = 0;
+    int ret = -1;
+
+    if (!points || !stairs) goto out;
+
+    for (int o = 0; o < OPTIMIZER_NUM_ORDERS; o++) {
+        for (int pp1 = 1; pp1 <= TOTAL_LAYERS; pp1++) {
+            for (int pp2 = pp1; pp2 <= TOTAL_LAYERS; pp2++) {
+                if (pp1 == 1 || pp2 - pp1 == 1 || TOTAL_LAYERS - pp2 == 1) continue;
+
+                for (int b = 0; b < NUM_BIG_FREQUENCIES; b++) {
+                    for (int l = 0; l < NUM_LITTLE_FREQUENCIES; l++) {
+                        for (int g = 0; g < NUM_GPU_FREQUENCIES; g++) {
+                            for (int bt = 1; bt <= MAX_BIG_THREADS; bt++) {
+                                for (int lt = 1; lt <= MAX_LITTLE_THREADS; lt++) {
+                                    PipelineConfig config = {pp1, pp2, BIG_FREQUENCY_TABLE[b], LITTLE_FREQUENCY_TABLE[l], "",
+                                                             GPU_FREQUENCY_TABLE[g], bt, lt};
+                                    double fps, latency;
+                                    strcpy(config.order, OPTIMIZER_ORDERS[o]);
+                                    if (optimizer_predict(&config, &fps, &latency) != 0) continue;
+
+                                    FrontierEntry *e = &points[n_points++];
+                                    memset(e, 0, sizeof(*e));
+                                    e->fps = (float)fps;
+                                    e->latency = (float)latency;
+                                    e->power = (float)estimate_power(&config);
+                                    e->partition_point1 = (uint8_t)pp1;
+                                    e->partition_point2 = (uint8_t)pp2;
+                                    e->order_idx = (uint8_t)o;
+                                    e->big_idx = (uint8_t)b;
+                                    e->little_idx = (uint8_t)l;
+                                    e->gpu_idx = (uint8_t)g;
+                                    e->big_threads = (uint8_t)bt;
+                                    e->little_threads = (uint8_t)lt;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    qsort(points, (size_t)n_points, sizeof(FrontierEntry), frontier_cmp_latency);
+
+    // Sweep in latency order; every latency at which the staircase changes becomes a bucket.
+    for (int i = 0; i < n_points; ) {
+        int changed = 0;
+        int j = i;
+        for (; j < n_points && points[j].latency == points[i].latency; j++) {
+            changed |= frontier_staircase_insert(stairs, &n_stairs, &points[j]);
+        }
+
+        if (changed) {
+            if (n_buckets == cap_buckets) {
+                cap_buckets = cap_buckets ? cap_buckets * 2 : 256;
+                buckets = realloc(buckets, (size_t)cap_buckets * sizeof(FrontierBucket));
+            }
+            while (n_entries + n_stairs > cap_entries) {
+                cap_entries = cap_entries ? cap_entries * 2 : 4096;
+                entries = realloc(entries, (size_t)cap_entries * sizeof(FrontierEntry));
+            }
+            if (!buckets || !entries) goto out;
+
+            buckets[n_buckets].latency_max = points[i].latency;
+            buckets[n_buckets].first_entry = (uint32_t)n_entries;
+            buckets[n_buckets].n_entries = (uint32_t)n_stairs;
+            n_buckets++;
+            memcpy(&entries[n_entries], stairs, (size_t)n_stairs * sizeof(FrontierEntry));
+            n_entries += n_stairs;
+        }
+        i = j;
+    }
+
+    FrontierHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = FRONTIER_MAGIC;
+    header.version = FRONTIER_VERSION;
+    header.n_buckets = (uint32_t)n_buckets;
+    header.n_entries = (uint32_t)n_entries;
+    header.n_configs = (uint32_t)n_points;
+    header.parked_cores = get_core_parking() ? 1 : 0;
+    snprintf(header.graph, sizeof(header.graph), "%s", graph);
+
+    char tmp_path[512];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *fp = fopen(tmp_path, "wb");
+    if (!fp) {
+        fprintf(stderr, "frontier_table_build: cannot open %s: %s\n", tmp_path, strerror(errno));
+        goto out;
+    }
+    int ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+             (n_buckets == 0 || fwrite(buckets, sizeof(FrontierBucket), (size_t)n_buckets, fp) == (size_t)n_buckets) &&
+             (n_entries == 0 || fwrite(entries, sizeof(FrontierEntry), (size_t)n_entries, fp) == (size_t)n_entries);
+    if (fclose(fp) != 0) ok = 0;
+    if (!ok || rename(tmp_path, path) != 0) {
+        fprintf(stderr, "frontier_table_build: cannot write %s: %s\n", path, strerror(errno));
+        remove(tmp_path);
+        goto out;
+    }
+
+    printf("frontier_table_build: %d configurations -> %d latency buckets, %d entries (%zu bytes) in %s\n",
+           n_points, n_buckets, n_entries,
+           sizeof(header) + (size_t)n_buckets * sizeof(FrontierBucket) + (size_t)n_entries * sizeof(FrontierEntry),
+           path);
+    ret = 0;
+
+out:
+    free(points);
+    free(stairs);
+    free(buckets);
+    free(entries);
+    return ret;
+}
+
+
+int frontier_table_open(FrontierTable *table, const char *path) {
+    memset(table, 0, sizeof(*table));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(FrontierHeader)) {
+        close(fd);
+        return -1;
+    }
+
+    void *base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return -1;
+
+    const FrontierHeader *header = base;
+    size_t expected = sizeof(FrontierHeader) + (size_t)header->n_buckets * sizeof(FrontierBucket) +
+                      (size_t)header->n_entries * sizeof(FrontierEntry);
+    if (header->magic != FRONTIER_MAGIC || header->version != FRONTIER_VERSION ||
+        expected != (size_t)st.st_size) {
+        fprintf(stderr, "frontier_table_open: %s is not a version %d frontier table\n", path, FRONTIER_VERSION);
+        munmap(base, (size_t)st.st_size);
+        return -1;
+    }
+
+    table->base = base;
+    table->size = (size_t)st.st_size;
+    table->header = header;
+    table->buckets = (const FrontierBucket *)(header + 1);
+    table->entries = (const FrontierEntry *)(table->buckets + header->n_buckets);
+
+    for (uint32_t b = 0; b < header->n_buckets; b++) {
+        if ((uint64_t)table->buckets[b].first_entry + table->buckets[b].n_entries > header->n_entries) {
+            fprintf(stderr, "frontier_table_open: %s has a corrupt bucket %u\n", path, b);
+            frontier_table_close(table);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+int frontier_table_lookup(const FrontierTable *table, const char *graph, double target_fps,
+                          double target_latency, PipelineConfig *config, double *power) {
+    if (!table->base || strncmp(table->header->graph, graph, FRONTIER_GRAPH_LEN) != 0) return -1;
+    if ((table->header->parked_cores != 0) != get_core_parking()) {
+        printf("[frontier] table was built %s --park-cores; searching instead\n",
+               table->header->parked_cores ? "with" : "without");
+        return -1;
+    }
+
+    // Last bucket whose latency bound is within the target.
+    int lo = 0, hi = (int)table->header->n_buckets;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (table->buckets[mid].latency_max <= target_latency) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == 0) return -1;
+    const FrontierBucket *bucket = &table->buckets[lo - 1];
+
+    // First staircase entry with enough fps.
+    const FrontierEntry *stairs = &table->entries[bucket->first_entry];
+    lo = 0;
+    hi = (int)bucket->n_entries;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (stairs[mid].fps < target_fps) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == (int)bucket->n_entries) return -1;
+
+    // Energy can favour a faster, dearer step that idles for longer; every
+    // such candidate is further up the same staircase.
+    if (get_objective() == OBJECTIVE_ENERGY) {
+        int best = lo;
+        double best_cost = objective_cost(stairs[lo].power, stairs[lo].fps, target_fps);
+        for (int i = lo + 1; i < (int)bucket->n_entries; i++) {
+            double cost = objective_cost(stairs[i].power, stairs[i].fps, target_fps);
+            if (cost < best_cost) {
+                best = i;
+                best_cost = cost;
+            }
+        }
+        lo = best;
+    }
+
+    const FrontierEntry *e = &stairs[lo];
+    if (e->order_idx >= OPTIMIZER_NUM_ORDERS || e->big_idx >= NUM_BIG_FREQUENCIES ||
+        e->little_idx >= NUM_LITTLE_FREQUENCIES || e->gpu_idx >= NUM_GPU_FREQUENCIES ||
+        e->big_threads < 1 || e->big_threads > MAX_BIG_THREADS ||
+        e->little_threads < 1 || e->little_threads > MAX_LITTLE_THREADS) {
+        return -1;
+    }
+
+    config->partition_point1 = e->partition_point1;
+    config->partition_point2 = e->partition_point2;
+    config->big_frequency = BIG_FREQUENCY_TABLE[e->big_idx];
+    config->little_frequency = LITTLE_FREQUENCY_TABLE[e->little_idx];
+    config->gpu_frequency = GPU_FREQUENCY_TABLE[e->gpu_idx];
+    config->big_threads = e->big_threads;
+    config->little_threads = e->little_threads;
+    strcpy(config->order, OPTIMIZER_ORDERS[e->order_idx]);
+    *power = e->power;
+    return 0;
+}
+
+
+void frontier_table_close(FrontierTable *table) {
+    if (table->base) munmap(table->base, table->size);
+    memset(table, 0, sizeof(*table));
+}
@@ -0,0 +1,75 @@
+#ifndef FRONTIERTABLE_H
+#define FRONTIERTABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "PipelineConfig.h"
+
+#define FRONTIER_MAGIC 0x46505647u   // "GVPF"
+#define FRONTIER_VERSION 5
+#define FRONTIER_DEFAULT_PATH "frontier.bin"
+#define FRONTIER_GRAPH_LEN 64
+
+// On-disk layout: header, n_buckets buckets, n_entries entries, all little endian.
+// Bucket b holds the (fps, power) staircase of every configuration with a
+// predicted latency <= latency_max, sorted by fps; fps and power both rise
+// along a staircase, so the first entry with enough fps is the cheapest one.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t n_buckets;
+    uint32_t n_entries;
+    uint32_t n_configs;              // configurations evaluated by the generator
+    uint32_t parked_cores;           // powers were estimated with core parking
+    char graph[FRONTIER_GRAPH_LEN];
+} FrontierHeader;
+
+typedef struct {
+    float latency_max;
+    uint32_t first_entry;
+    uint32_t n_entries;
+} FrontierBucket;
+
+typedef struct {
+    float fps;
+    float latency;
+    float power;
+    uint8_t partition_point1;
+    uint8_t partition_point2;
+    uint8_t order_idx;               // index into OPTIMIZER_ORDERS
+    uint8_t big_idx;
+    uint8_t little_idx;
+    uint8_t gpu_idx;
+    uint8_t big_threads;
+    uint8_t little_threads;
+} FrontierEntry;
+
+typedef struct {
+    void *base;
+    size_t size;
+    const FrontierHeader *header;
+    const FrontierBucket *buckets;
+    const FrontierEntry *entries;
+} FrontierTable;
+
+// Offline: evaluates every PipelineConfig with the optimizer's models and
+// writes the Pareto frontier. Needs the measurement grid loaded; the powers
+// follow the current core parking mode (set_core_parking).
+int frontier_table_build(const char *graph, const char *path);
+
+// Maps a generated table read-only; fails on a foreign or truncated file.
+int frontier_table_open(FrontierTable *table, const char *path);
+
+// Two binary searches: the latency bucket, then fps within its staircase.
+// For the energy objective the rest of the staircase is scanned for the
+// lowest objective_cost.
+// Returns -1 if no frontier point meets both targets, or the graph or the
+// core parking mode differs.
+int frontier_table_lookup(const FrontierTable *table, const char *graph, double target_fps,
+                          double target_latency, PipelineConfig *config, double *power);
+
+void frontier_table_close(FrontierTable *table);
+
+#endif
@@ -5,10 +5,14 @@
 #include "Governor.h"
 #include "PipelineConfig.h"
 #include "ApproximationModels.h"
+#include "QuantileSketch.h"
 
 // This config is a very well performing config.
 // From this config on, we will try to find a better config, by tweaking values slightly.
-PipelineConfig ROOT_CONFIG = {4, 6, 1800000, 1200000, "G-B-L"};
+PipelineConfig ROOT_CONFIG = {4, 6, 1800000, 1200000, "G-B-L", 800000, 4, 2};
+
+static double latency_quantile = 0.0;
+static QuantileSketch frame_latencies;
 
 
 void apply_policy(Policy *policy, PipelineConfig *config, stats_t *stats, double target_fps, double target_latency){
@@ -16,101 +20,158 @@ void apply_policy(Policy *policy, PipelineConfig *config, stats_t *stats, double
 }
 
 
-/* Get feedback by parsing the results */
-void parse_results(stats_t *ret){
+/* Extract the statistics of a single line of graph output */
+void parse_result_line(char *line, stats_t *ret){
 	double fps;
 	double latency;
 	double stage1_inference_time;
 	double stage2_inference_time;
 	double stage3_inference_time;
-	FILE *output_file;
-    char *line = NULL;
-    size_t len = 0;
-    
-    if ((output_file = fopen("last_run_output.txt", "r")) == NULL) {
-		printf("Error opening file\n");
+	double input_time;
+	char *temp;
+
+	/* Extract Per-Frame Latency */
+	if ( latency_quantile > 0.0 && strstr(line, "frame_latency:")!=NULL &&
+	     sscanf(strstr(line, "frame_latency:") + strlen("frame_latency:"), "%lf", &latency) == 1 ){
+		quantile_sketch_add(&frame_latencies, latency);
 		return;
 	}
+	/* Extract Frame Rate */
+	if ( strstr(line, "Frame rate is:")!=NULL ){
 
-	/* Read Output.txt File and Extract Data */
-	while (getline(&line, &len, output_file) != -1)
-	{
-		char *temp;
-		/* Extract Frame Rate */
-		if ( strstr(line, "Frame rate is:")!=NULL ){
-
-			temp = strtok(line, " ");
-			while (temp != NULL) {
-				/* Checking the given word is double or not */
-				if (sscanf(temp, "%lf", &fps) == 1){
-					ret->fps = fps;
-					printf("Throughput is: %lf FPS\n", fps);
-					break;
-				}
-				temp = strtok(NULL, " ");
+		temp = strtok(line, " ");
+		while (temp != NULL) {
+			/* Checking the given word is double or not */
+			if (sscanf(temp, "%lf", &fps) == 1){
+				ret->fps = fps;
+				printf("Throughput is: %lf FPS\n", fps);
+				break;
 			}
+			temp = strtok(NULL, " ");
 		}
-		/* Extract Frame Latency */
-		if ( strstr(line, "Frame latency is:")!=NULL ){
-
-			temp = strtok(line, " ");
-			while (temp != NULL) {
-				/* Checking the given word is double or not */
-				if (sscanf(temp, "%lf", &latency) == 1){
-					ret->latency = latency;
-					printf("Latency is: %lf ms\n", latency);
-					break;
+	}
+	/* Extract Frame Latency */
+	if ( strstr(line, "Frame latency is:")!=NULL ){
+
+		temp = strtok(line, " ");
+		while (temp != NULL) {
+			/* Checking the given word is double or not */
+			if (sscanf(temp, "%lf", &latency) == 1){
+				ret->latency = latency;
+				printf("Latency is: %lf ms\n", latency);
+				if (latency_quantile > 0.0 && quantile_sketch_count(&frame_latencies) > 0) {
+					ret->latency_tail = quantile_sketch_value(&frame_latencies);
+					printf("p%g latency is: %lf ms over %d frames\n", 100.0 * latency_quantile,
+					       ret->latency_tail, quantile_sketch_count(&frame_latencies));
 				}
-				temp = strtok(NULL, " ");
+				break;
 			}
+			temp = strtok(NULL, " ");
 		}
-		/* Extract Stage One Inference Time */
-		if ( strstr(line, "stage1_inference_time:")!=NULL ){
-			
-			temp = strtok(line, " ");
-			while (temp != NULL) {
-				/* Checking the given word is double or not */
-				if (sscanf(temp, "%lf", &stage1_inference_time) == 1){
-					ret->stage1_inference_time = stage1_inference_time;
-					break;
-				}
-				temp = strtok(NULL, " ");
+	}
+	/* Extract Stage One Inference Time */
+	if ( strstr(line, "stage1_inference_time:")!=NULL ){
+		
+		temp = strtok(line, " ");
+		while (temp != NULL) {
+			/* Checking the given word is double or not */
+			if (sscanf(temp, "%lf", &stage1_inference_time) == 1){
+				ret->stage1_inference_time = stage1_inference_time;
+				break;
 			}
+			temp = strtok(NULL, " ");
 		}
-		/* Extract Stage Two Inference Time */
-		if ( strstr(line, "stage2_inference_time:")!=NULL ){
-			temp = strtok(line, " ");
-			while (temp != NULL) {
-				/* Checking the given word is double or not */
-				if (sscanf(temp, "%lf", &stage2_inference_time) == 1){
-					ret->stage2_inference_time = stage2_inference_time;
-					break;
-				}
-				temp = strtok(NULL, " ");
+	}
+	/* Extract Stage Two Inference Time */
+	if ( strstr(line, "stage2_inference_time:")!=NULL ){
+		temp = strtok(line, " ");
+		while (temp != NULL) {
+			/* Checking the given word is double or not */
+			if (sscanf(temp, "%lf", &stage2_inference_time) == 1){
+				ret->stage2_inference_time = stage2_inference_time;
+				break;
 			}
+			temp = strtok(NULL, " ");
 		}
-		/* Extract Stage Three Inference Time */
-		if ( strstr(line, "stage3_inference_time:")!=NULL ){
-            temp = strtok(line, " ");
-			while (temp != NULL) {
-				/* Checking the given word is double or not */
-				if (sscanf(temp, "%lf", &stage3_inference_time) == 1){
-					ret->stage3_inference_time = stage3_inference_time;
-					break;
-				}
-				temp = strtok(NULL, " ");
+	}
+	/* Extract Stage Three Inference Time */
+	if ( strstr(line, "stage3_inference_time:")!=NULL ){
+		temp = strtok(line, " ");
+		while (temp != NULL) {
+			/* Checking the given word is double or not */
+			if (sscanf(temp, "%lf", &stage3_inference_time) == 1){
+				ret->stage3_inference_time = stage3_inference_time;
+				break;
 			}
+			temp = strtok(NULL, " ");
+		}
+	}
+	/* Extract Stage Input (transfer + wait) Times */
+	for (int stage = 1; stage <= 3; stage++) {
+		char key[32];
+		sprintf(key, "stage%d_input_time:", stage);
+		if ( strstr(line, key)!=NULL && sscanf(strstr(line, key) + strlen(key), "%lf", &input_time) == 1 ){
+			if (stage == 1) ret->stage1_input_time = input_time;
+			if (stage == 2) ret->stage2_input_time = input_time;
+			if (stage == 3) ret->stage3_input_time = input_time;
 		}
 	}
 }
 
 
+/* Get feedback by parsing the results */
+void parse_results(stats_t *ret){
+	FILE *output_file;
+    char *line = NULL;
+    size_t len = 0;
+    
+    if ((output_file = fopen("last_run_output.txt", "r")) == NULL) {
+		printf("Error opening file\n");
+		return;
+	}
+
+	/* Read Output.txt File and Extract Data */
+	while (getline(&line, &len, output_file) != -1)
+	{
+		parse_result_line(line, ret);
+	}
+
+	free(line);
+	fclose(output_file);
+}
+
+
 bool conditions_met(stats_t *s, double target_fps, double target_latency) {
 
-	if (s->latency <= target_latency && s->fps >= target_fps){
+	if (slo_latency(s) <= target_latency && s->fps >= target_fps){
 		return true;
 	}
 	return false;
 }
 
 
+
+void set_latency_quantile(double q) {
+	latency_quantile = q;
+	latency_sketch_reset();
+}
+
+double get_latency_quantile(void) {
+	return latency_quantile;
+}
+
+void latency_sketch_reset(void) {
+	quantile_sketch_init(&frame_latencies, latency_quantile);
+}
+
+int latency_sketch_frames(void) {
+	return quantile_sketch_count(&frame_latencies);
+}
+
+double slo_latency(const stats_t *stats) {
+	return (latency_quantile > 0.0 && stats->latency_tail > 0.0) ? stats->latency_tail : stats->latency;
+}
+
+double measured_power(const stats_t *stats) {
+	return stats->energy_per_frame * stats->fps;
+}
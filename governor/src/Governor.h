@@ -12,6 +12,11 @@ typedef struct {
 	double stage1_inference_time;
 	double stage2_inference_time;
 	double stage3_inference_time;
+	double stage1_input_time;
+	double stage2_input_time;
+	double stage3_input_time;
+	double energy_per_frame;	// J from the power sensor, 0 = not measured
+	double latency_tail;		// ms at the latency quantile over the frames since latency_sketch_reset, 0 = no per-frame lines
 } stats_t;
 
 typedef struct {
@@ -23,8 +28,32 @@ typedef struct {
 
 void apply_policy(Policy *policy, PipelineConfig *config, stats_t *stats, double target_fps, double target_latency);
 
+void parse_result_line(char *line, stats_t *ret);
+
 void parse_results(stats_t *ret);
 
 bool conditions_met(stats_t *s, double target_fps, double target_latency);
 
+// Latency targets on a quantile of the per-frame latencies rather than on
+// the mean: q in (0, 1), 0 goes back to the mean. The graph prints a
+// "frame_latency: <ms>" line per frame, which parse_result_line feeds into a
+// sketch; the "Frame latency is:" summary stores the quantile of everything
+// since the last reset in latency_tail.
+void set_latency_quantile(double q);
+
+double get_latency_quantile(void);
+
+// Starts the sketch over, at the start of a run or of a sequential test.
+void latency_sketch_reset(void);
+
+// Frames in the sketch since the last reset.
+int latency_sketch_frames(void);
+
+// The latency the targets are held to: the tail when a quantile is set and
+// the run printed per-frame lines, otherwise the mean.
+double slo_latency(const stats_t *stats);
+
+// Mean power of the run behind stats as the power sensor saw it, 0 if it did not.
+double measured_power(const stats_t *stats);
+
 #endif
@@ -0,0 +1,288 @@
+#include "LayerModel.h"
+#include "ApproximationModels.h"
+#include "ModelEstimator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static LayerModelCell cells[LAYER_MODEL_CELLS];
+
+
+// Cell 0 is the GPU, then one per big and one per little table frequency. The
+// GPU cell holds times at GPU_MAX_FREQUENCY and the CPU cells times on all
+// cores of the cluster, normalised with estimate_stage_scale.
+static int layer_cell_index(char processor_code, int freq_idx) {
+    if (processor_code == 'G') return 0;
+    if (processor_code == 'B' && freq_idx >= 0 && freq_idx < NUM_BIG_FREQUENCIES) return 1 + freq_idx;
+    if (processor_code == 'L' && freq_idx >= 0 && freq_idx < NUM_LITTLE_FREQUENCIES) {
+        return 1 + NUM_BIG_FREQUENCIES + freq_idx;
+    }
+    return -1;
+}
+
+static int layer_freq_index(char processor_code, double khz) {
+    const int *table = (processor_code == 'B') ? BIG_FREQUENCY_TABLE : LITTLE_FREQUENCY_TABLE;
+    const int n = (processor_code == 'B') ? NUM_BIG_FREQUENCIES : NUM_LITTLE_FREQUENCIES;
+
+    if (processor_code == 'G') return 0;
+    for (int i = 0; i < n; i++) {
+        if (table[i] == (int)khz) return i;
+    }
+    return -1;
+}
+
+static double layer_cell_khz(char processor_code, int freq_idx) {
+    if (processor_code == 'B') return BIG_FREQUENCY_TABLE[freq_idx];
+    if (processor_code == 'L') return LITTLE_FREQUENCY_TABLE[freq_idx];
+    return 0.0;
+}
+
+// Gaussian elimination with partial pivoting on an n x n system; a is destroyed.
+static int layer_solve(double a[TOTAL_LAYERS][TOTAL_LAYERS], double *b, double *x, int n) {
+    for (int col = 0; col < n; col++) {
+        int pivot = col;
+        for (int r = col + 1; r < n; r++) {
+            if (fabs(a[r][col]) > fabs(a[pivot][col])) pivot = r;
+        }
+        if (fabs(a[pivot][col]) < 1e-12) return -1;
+        if (pivot != col) {
+            for (int c = 0; c < n; c++) {
+                double tmp = a[col][c];
+                a[col][c] = a[pivot][c];
+                a[pivot][c] = tmp;
+            }
+            double tmp = b[col];
+            b[col] = b[pivot];
+            b[pivot] = tmp;
+        }
+        for (int r = col + 1; r < n; r++) {
+            double f = a[r][col] / a[col][col];
+            for (int c = col; c < n; c++) a[r][c] -= f * a[col][c];
+            b[r] -= f * b[col];
+        }
+    }
+    for (int r = n - 1; r >= 0; r--) {
+        double sum = b[r];
+        for (int c = r + 1; c < n; c++) sum -= a[r][c] * x[c];
+        x[r] = sum / a[r][r];
+    }
+    return 0;
+}
+
+// Ridge towards the prior with weight LAYER_MODEL_RIDGE / prior per layer, so
+// whatever the equations leave open is split in proportion to the prior. The
+// fit is bounded below by LAYER_MODEL_MIN_FRACTION of the prior per layer with
+// an active set: layers that come out under their floor are pinned to it and
+// the rest are solved again. A cell whose fit is still not positive is kept
+// out of the estimates.
+static void layer_cell_solve(LayerModelCell *cell, char processor_code, double khz) {
+    double floor_ms[TOTAL_LAYERS];
+    bool pinned[TOTAL_LAYERS] = {false};
+    const double network = model_estimator_latency(processor_code, khz);
+
+    cell->solved = true;
+    cell->usable = false;
+
+    for (int i = 0; i < TOTAL_LAYERS; i++) {
+        double prior = compute_weighted_fraction(i, i + 1) * network;
+        if (prior < 1e-3) prior = 1e-3;
+        floor_ms[i] = LAYER_MODEL_MIN_FRACTION * prior;
+    }
+
+    for (int pass = 0; pass < TOTAL_LAYERS; pass++) {
+        double a[TOTAL_LAYERS][TOTAL_LAYERS];
+        double b[TOTAL_LAYERS];
+        double x[TOTAL_LAYERS];
+        int free_layer[TOTAL_LAYERS];
+        int n = 0;
+
+        for (int i = 0; i < TOTAL_LAYERS; i++) {
+            if (!pinned[i]) free_layer[n++] = i;
+        }
+        for (int r = 0; r < n; r++) {
+            const int i = free_layer[r];
+            double prior = floor_ms[i] / LAYER_MODEL_MIN_FRACTION;
+            double d = LAYER_MODEL_RIDGE / prior;
+
+            b[r] = cell->Atb[i] + d * prior;
+            for (int j = 0; j < TOTAL_LAYERS; j++) {
+                if (pinned[j]) b[r] -= cell->AtA[i][j] * floor_ms[j];
+            }
+            for (int c = 0; c < n; c++) a[r][c] = cell->AtA[i][free_layer[c]];
+            a[r][r] += d;
+        }
+        if (n > 0 && layer_solve(a, b, x, n) != 0) return;
+
+        bool clamped = false;
+        for (int r = 0; r < n; r++) {
+            if (x[r] < floor_ms[free_layer[r]]) {
+                pinned[free_layer[r]] = true;
+                clamped = true;
+            }
+        }
+        for (int i = 0; i < TOTAL_LAYERS; i++) cell->cost[i] = floor_ms[i];
+        for (int r = 0; r < n; r++) cell->cost[free_layer[r]] = x[r];
+        if (!clamped) break;
+    }
+
+    for (int i = 0; i < TOTAL_LAYERS; i++) {
+        if (!isfinite(cell->cost[i]) || cell->cost[i] <= 0.0) return;
+    }
+    cell->usable = true;
+}
+
+
+void layer_model_reset(void) {
+    memset(cells, 0, sizeof(cells));
+}
+
+void layer_model_observe(const PipelineConfig *config, const stats_t *stats) {
+    const double stage_ms[3] = {
+        stats->stage1_inference_time, stats->stage2_inference_time, stats->stage3_inference_time
+    };
+    const int bounds[4] = {0, config->partition_point1, config->partition_point2, TOTAL_LAYERS};
+
+    // The priors follow the online latency models, which move with every run too.
+    for (int idx = 0; idx < LAYER_MODEL_CELLS; idx++) cells[idx].solved = false;
+
+    for (int s = 0; s < 3; s++) {
+        if (bounds[s + 1] <= bounds[s] || stage_ms[s] <= 0.0) continue;
+
+        char code = config->order[2 * s];
+        double khz = get_processor_frequency(config, code);
+        int idx = layer_cell_index(code, layer_freq_index(code, khz));
+        if (idx < 0) continue;
+
+        double ms = stage_ms[s] / estimate_stage_scale(config, code);
+        LayerModelCell *cell = &cells[idx];
+        for (int i = bounds[s]; i < bounds[s + 1]; i++) {
+            for (int j = bounds[s]; j < bounds[s + 1]; j++) cell->AtA[i][j] += 1.0;
+            cell->Atb[i] += ms;
+        }
+        cell->n_obs++;
+    }
+}
+
+int layer_model_range_time(char processor_code, double khz, int start, int end, double *ms) {
+    int freq_idx = layer_freq_index(processor_code, khz);
+    if (freq_idx < 0) return -1;
+
+    // Closest measured frequency of this processor.
+    const int n_freqs = (processor_code == 'G') ? 1 :
+                        (processor_code == 'B') ? NUM_BIG_FREQUENCIES : NUM_LITTLE_FREQUENCIES;
+    int best = -1;
+    for (int f = 0; f < n_freqs; f++) {
+        int idx = layer_cell_index(processor_code, f);
+        if (idx < 0 || cells[idx].n_obs == 0) continue;
+        if (!cells[idx].solved) layer_cell_solve(&cells[idx], processor_code, layer_cell_khz(processor_code, f));
+        if (!cells[idx].usable) continue;
+        if (best < 0 || abs(f - freq_idx) < abs(best - freq_idx)) best = f;
+    }
+    if (best < 0) return -1;
+
+    LayerModelCell *cell = &cells[layer_cell_index(processor_code, best)];
+    const double cell_khz = layer_cell_khz(processor_code, best);
+
+    double sum = 0.0;
+    for (int i = start; i < end; i++) sum += cell->cost[i];
+
+    if (processor_code == 'G') {
+        sum *= gpu_latency_scale(khz);
+    } else if (best != freq_idx) {
+        sum *= model_estimator_latency(processor_code, khz) / model_estimator_latency(processor_code, cell_khz);
+    }
+    *ms = sum;
+    return 0;
+}
+
+
+int layer_model_load(const char *path, const char *device_id) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return -1;
+
+    char stored_id[256] = "";
+    if (fscanf(fp, "device %255s", stored_id) != 1 || strcmp(stored_id, device_id) != 0) {
+        printf("layer_model_load: %s belongs to device '%s', not '%s'; starting empty\n", path, stored_id, device_id);
+        fclose(fp);
+        return -1;
+    }
+
+    int idx, n_obs, loaded = 0;
+    while (fscanf(fp, "%d %d", &idx, &n_obs) == 2) {
+        LayerModelCell cell;
+        memset(&cell, 0, sizeof(cell));
+        cell.n_obs = n_obs;
+
+        int ok = idx >= 0 && idx < LAYER_MODEL_CELLS;
+        for (int i = 0; i < TOTAL_LAYERS && ok; i++) {
+            for (int j = 0; j < TOTAL_LAYERS && ok; j++) ok = fscanf(fp, "%lf", &cell.AtA[i][j]) == 1;
+        }
+        for (int i = 0; i < TOTAL_LAYERS && ok; i++) ok = fscanf(fp, "%lf", &cell.Atb[i]) == 1;
+        if (!ok) break;
+
+        cells[idx] = cell;
+        loaded++;
+    }
+    fclose(fp);
+
+    printf("layer_model_load: %d measured cells for '%s' from %s\n", loaded, device_id, path);
+    return 0;
+}
+
+int layer_model_save(const char *path, const char *device_id) {
+    char tmp_path[512];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *fp = fopen(tmp_path, "w");
+    if (!fp) return -1;
+
+    fprintf(fp, "device %s\n", device_id);
+    for (int idx = 0; idx < LAYER_MODEL_CELLS; idx++) {
+        const LayerModelCell *cell = &cells[idx];
+        if (cell->n_obs == 0) continue;
+
+        fprintf(fp, "%d %d", idx, cell->n_obs);
+        for (int i = 0; i < TOTAL_LAYERS; i++) {
+            for (int j = 0; j < TOTAL_LAYERS; j++) fprintf(fp, " %.9g", cell->AtA[i][j]);
+        }
+        for (int i = 0; i < TOTAL_LAYERS; i++) fprintf(fp, " %.9g", cell->Atb[i]);
+        fprintf(fp, "\n");
+    }
+
+    if (fclose(fp) != 0 || rename(tmp_path, path) != 0) {
+        remove(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+bool layer_model_calibrated(void) {
+    for (int idx = 0; idx < LAYER_MODEL_CELLS; idx++) {
+        if (cells[idx].n_obs > 0) return true;
+    }
+    return false;
+}
+
+void layer_model_report(void) {
+    const char codes[3] = {'G', 'B', 'L'};
+
+    for (int p = 0; p < 3; p++) {
+        const int n_freqs = (codes[p] == 'G') ? 1 : (codes[p] == 'B') ? NUM_BIG_FREQUENCIES : NUM_LITTLE_FREQUENCIES;
+
+        for (int f = 0; f < n_freqs; f++) {
+            LayerModelCell *cell = &cells[layer_cell_index(codes[p], f)];
+            if (cell->n_obs == 0) continue;
+            if (!cell->solved) layer_cell_solve(cell, codes[p], layer_cell_khz(codes[p], f));
+
+            printf("[layer-model] %c", codes[p]);
+            if (codes[p] != 'G') printf(" @%d", (int)layer_cell_khz(codes[p], f));
+            printf(" (%d stages):", cell->n_obs);
+            if (!cell->usable) {
+                printf(" no positive fit, not used\n");
+                continue;
+            }
+            for (int i = 0; i < TOTAL_LAYERS; i++) printf(" %.1f", cell->cost[i]);
+            printf(" ms\n");
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef LAYERMODEL_H
+#define LAYERMODEL_H
+
+#include <stdbool.h>
+
+#include "PipelineConfig.h"
+#include "Governor.h"
+
+#define LAYER_MODEL_RIDGE 1.0           // pull towards the prior, in ms of stage time
+#define LAYER_MODEL_MIN_FRACTION 0.1    // no layer is fitted below this share of its prior
+#define LAYER_MODEL_CELLS (1 + NUM_BIG_FREQUENCIES + NUM_LITTLE_FREQUENCIES)
+#define LAYER_MODEL_PREFIX "layer_model_"
+
+// Normal equations of one (processor, frequency) cell: every measured stage
+// on that processor at that frequency adds the equation
+// sum(cost[layer] for layer in the stage) = stageN_inference_time.
+typedef struct {
+    double AtA[TOTAL_LAYERS][TOTAL_LAYERS];
+    double Atb[TOTAL_LAYERS];
+    int n_obs;
+    double cost[TOTAL_LAYERS];
+    bool solved;
+    bool usable;     // the solved costs are all positive
+} LayerModelCell;
+
+// Per-layer latency table learned from stage timings, one table per processor
+// and frequency (a single one for the GPU, at its top OPP). Layers a cell cannot tell apart
+// share their time in proportion to the prior, LAYER_WEIGHTS times the
+// processor's whole-network latency. No layer is fitted below
+// LAYER_MODEL_MIN_FRACTION of its prior.
+void layer_model_reset(void);
+
+int layer_model_load(const char *path, const char *device_id);
+
+int layer_model_save(const char *path, const char *device_id);
+
+void layer_model_observe(const PipelineConfig *config, const stats_t *stats);
+
+// Time of layers [start, end) on a processor ('G', 'B' or 'L') at khz. Cells
+// without measurements borrow the closest measured frequency of the same
+// processor, scaled by the latency model. Returns -1 if the processor has none.
+int layer_model_range_time(char processor_code, double khz, int start, int end, double *ms);
+
+// Some processor has measured stages, so the estimates no longer match the priors.
+bool layer_model_calibrated(void);
+
+void layer_model_report(void);
+
+#endif
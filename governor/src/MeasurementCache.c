@@ -0,0 +1,219 @@
+#include "MeasurementCache.h"
+#include "ApproximationModels.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static CacheEntry *entries = NULL;
+static int n_entries = 0;
+static int capacity = 0;
+static bool cache_enabled = true;
+static int hits = 0;
+static int misses = 0;
+
+
+static void cache_to_array(const stats_t *stats, double *v) {
+    v[0] = stats->fps;
+    v[1] = stats->latency;
+    v[2] = stats->stage1_inference_time;
+    v[3] = stats->stage2_inference_time;
+    v[4] = stats->stage3_inference_time;
+    v[5] = stats->stage1_input_time;
+    v[6] = stats->stage2_input_time;
+    v[7] = stats->stage3_input_time;
+    v[8] = stats->energy_per_frame;
+}
+
+static void cache_from_array(const double *v, stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->fps = v[0];
+    stats->latency = v[1];
+    stats->stage1_inference_time = v[2];
+    stats->stage2_inference_time = v[3];
+    stats->stage3_inference_time = v[4];
+    stats->stage1_input_time = v[5];
+    stats->stage2_input_time = v[6];
+    stats->stage3_input_time = v[7];
+    stats->energy_per_frame = v[8];
+}
+
+static bool cache_same_config(const PipelineConfig *a, const PipelineConfig *b) {
+    return a->partition_point1 == b->partition_point1 &&
+           a->partition_point2 == b->partition_point2 &&
+           a->big_frequency == b->big_frequency &&
+           a->little_frequency == b->little_frequency &&
+           a->gpu_frequency == b->gpu_frequency &&
+           get_processor_threads(a, 'B') == get_processor_threads(b, 'B') &&
+           get_processor_threads(a, 'L') == get_processor_threads(b, 'L') &&
+           strcmp(a->order, b->order) == 0;
+}
+
+static CacheEntry *cache_find(const char *graph, const PipelineConfig *config, bool parked) {
+    for (int i = 0; i < n_entries; i++) {
+        if (cache_same_config(&entries[i].config, config) && entries[i].parked == parked &&
+            strcmp(entries[i].graph, graph) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+static CacheEntry *cache_append(const char *graph, const PipelineConfig *config, bool parked) {
+    if (n_entries == capacity) {
+        int new_capacity = capacity ? 2 * capacity : 64;
+        CacheEntry *grown = realloc(entries, new_capacity * sizeof(CacheEntry));
+        if (!grown) return NULL;
+        entries = grown;
+        capacity = new_capacity;
+    }
+
+    CacheEntry *entry = &entries[n_entries++];
+    memset(entry, 0, sizeof(*entry));
+    snprintf(entry->graph, sizeof(entry->graph), "%s", graph);
+    entry->config = *config;
+    entry->parked = parked;
+    return entry;
+}
+
+
+void measurement_cache_set_enabled(bool enabled) {
+    cache_enabled = enabled;
+}
+
+void measurement_cache_add(const char *graph, const PipelineConfig *config, const stats_t *stats) {
+    if (!cache_enabled || stats->fps <= 0.0) return;
+
+    CacheEntry *entry = cache_find(graph, config, get_core_parking());
+    if (!entry) entry = cache_append(graph, config, get_core_parking());
+    if (!entry) return;
+
+    double v[CACHE_STATS];
+    cache_to_array(stats, v);
+
+    entry->n++;
+    for (int i = 0; i < CACHE_STATS; i++) {
+        double delta = v[i] - entry->mean[i];
+        entry->mean[i] += delta / entry->n;
+        entry->m2[i] += delta * (v[i] - entry->mean[i]);
+    }
+    entry->updated = time(NULL);
+}
+
+int measurement_cache_lookup(const char *graph, const PipelineConfig *config, stats_t *stats) {
+    if (!cache_enabled) return -1;
+
+    const CacheEntry *entry = cache_find(graph, config, get_core_parking());
+    if (!entry || entry->n == 0 || difftime(time(NULL), entry->updated) > MEASUREMENT_CACHE_MAX_AGE_S) {
+        misses++;
+        return -1;
+    }
+
+    // fps and latency must agree across the measurements that were merged.
+    if (entry->n > 1) {
+        for (int i = 0; i < 2; i++) {
+            double sd = sqrt(entry->m2[i] / (entry->n - 1));
+            if (sd > MEASUREMENT_CACHE_MAX_CV * fabs(entry->mean[i])) {
+                misses++;
+                return -1;
+            }
+        }
+    }
+
+    cache_from_array(entry->mean, stats);
+    hits++;
+    return 0;
+}
+
+
+int measurement_cache_load(const char *path, const char *device_id) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return -1;
+
+    char stored_id[256] = "";
+    int version = 0;
+    if (fscanf(fp, "device %255s version %d", stored_id, &version) != 2 || version != CACHE_VERSION) {
+        printf("measurement_cache_load: %s is not a version %d cache; starting empty\n", path, CACHE_VERSION);
+        fclose(fp);
+        return -1;
+    }
+    if (strcmp(stored_id, device_id) != 0) {
+        printf("measurement_cache_load: %s belongs to device '%s', not '%s'; starting empty\n", path, stored_id, device_id);
+        fclose(fp);
+        return -1;
+    }
+
+    char line[2048];
+    char graph[CACHE_GRAPH_LEN];
+    PipelineConfig config;
+    int n, pos, parked;
+    long updated;
+    int loaded = 0;
+
+    memset(&config, 0, sizeof(config));
+    fgets(line, sizeof(line), fp);   // rest of the device line
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "%63s %d %d %d %d %d %d %d %5s %d %d %ld%n", graph,
+                   &config.partition_point1, &config.partition_point2,
+                   &config.big_frequency, &config.little_frequency, &config.gpu_frequency,
+                   &config.big_threads, &config.little_threads, config.order,
+                   &parked, &n, &updated, &pos) != 12) {
+            break;
+        }
+
+        double v[2 * CACHE_STATS];
+        int ok = 1;
+        for (int i = 0; i < 2 * CACHE_STATS && ok; i++) {
+            int used;
+            ok = sscanf(line + pos, "%lf%n", &v[i], &used) == 1;
+            pos += used;
+        }
+        if (!ok) break;
+
+        CacheEntry *entry = cache_find(graph, &config, parked != 0);
+        if (!entry) entry = cache_append(graph, &config, parked != 0);
+        if (!entry) break;
+
+        entry->n = n;
+        entry->updated = (time_t)updated;
+        for (int i = 0; i < CACHE_STATS; i++) {
+            entry->mean[i] = v[2 * i];
+            entry->m2[i] = v[2 * i + 1];
+        }
+        loaded++;
+    }
+    fclose(fp);
+
+    printf("measurement_cache_load: %d configurations for '%s' from %s\n", loaded, device_id, path);
+    return 0;
+}
+
+int measurement_cache_save(const char *path, const char *device_id) {
+    char tmp_path[512];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *fp = fopen(tmp_path, "w");
+    if (!fp) return -1;
+
+    fprintf(fp, "device %s version %d\n", device_id, CACHE_VERSION);
+    for (int e = 0; e < n_entries; e++) {
+        const CacheEntry *entry = &entries[e];
+        fprintf(fp, "%s %d %d %d %d %d %d %d %s %d %d %ld", entry->graph,
+                entry->config.partition_point1, entry->config.partition_point2,
+                entry->config.big_frequency, entry->config.little_frequency, entry->config.gpu_frequency,
+                get_processor_threads(&entry->config, 'B'), get_processor_threads(&entry->config, 'L'),
+                entry->config.order, entry->parked ? 1 : 0, entry->n, (long)entry->updated);
+        for (int i = 0; i < CACHE_STATS; i++) fprintf(fp, " %.9g %.9g", entry->mean[i], entry->m2[i]);
+        fprintf(fp, "\n");
+    }
+
+    if (fclose(fp) != 0 || rename(tmp_path, path) != 0) {
+        remove(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+void measurement_cache_report(void) {
+    if (!cache_enabled) return;
+    printf("[cache] %d configurations cached, %d hits, %d misses\n", n_entries, hits, misses);
+}
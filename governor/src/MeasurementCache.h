@@ -0,0 +1,48 @@
+#ifndef MEASUREMENTCACHE_H
+#define MEASUREMENTCACHE_H
+
+#include <stdbool.h>
+#include <time.h>
+
+#include "PipelineConfig.h"
+#include "Governor.h"
+
+// The stats_t fields up to energy_per_frame. latency_tail is left out: it
+// only exists at the quantile of a percentile session, and those run without
+// the cache (main.c).
+#define CACHE_STATS 9
+#define CACHE_VERSION 1                     // line format; files of another version start empty
+#define CACHE_GRAPH_LEN 64
+#define MEASUREMENT_CACHE_MAX_AGE_S 86400   // older entries are measured again
+#define MEASUREMENT_CACHE_MAX_CV 0.05       // entries that disagree with themselves more are measured again
+#define MEASUREMENT_CACHE_PREFIX "measurement_cache_"
+
+// Every measurement of one configuration of one graph, merged: the mean and
+// the spread (Welford) of each stats_t field over the measurements. Parked
+// cores change the power of a configuration, so entries measured with and
+// without --park-cores are kept apart.
+typedef struct {
+    char graph[CACHE_GRAPH_LEN];
+    PipelineConfig config;
+    bool parked;
+    int n;
+    time_t updated;
+    double mean[CACHE_STATS];
+    double m2[CACHE_STATS];
+} CacheEntry;
+
+void measurement_cache_set_enabled(bool enabled);
+
+int measurement_cache_load(const char *path, const char *device_id);
+
+int measurement_cache_save(const char *path, const char *device_id);
+
+void measurement_cache_add(const char *graph, const PipelineConfig *config, const stats_t *stats);
+
+// The merged stats of a configuration if its entry is recent and consistent;
+// returns -1 if it has to be measured.
+int measurement_cache_lookup(const char *graph, const PipelineConfig *config, stats_t *stats);
+
+void measurement_cache_report(void);
+
+#endif
@@ -0,0 +1,369 @@
+#include "ModelEstimator.h"
+#include "ApproximationModels.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define MODEL_PROCESSORS 3
+
+static const char MODEL_PROCESSOR_CODES[MODEL_PROCESSORS] = {'G', 'B', 'L'};
+
+static const double MODEL_PRIORS[MODEL_PROCESSORS][RLS_MAX_PARAMS] = {
+    {GPU_NETWORK_LATENCY, 0.0},
+    {BCPU_LATENCY_PER_GHZ, BCPU_LATENCY_OFFSET},
+    {LCPU_LATENCY_PER_GHZ, LCPU_LATENCY_OFFSET},
+};
+
+static RLSEstimator processor_models[MODEL_PROCESSORS];
+static double holdout_error[MODEL_PROCESSORS][2];   // learned, fitted; relative, this session
+static bool validated[MODEL_PROCESSORS];
+static RLSEstimator power_model;
+static double power_holdout_error[2];
+static bool power_validated;
+static int models_initialized = 0;
+
+
+void rls_init(RLSEstimator *rls, int n, const double *theta0, const double *p0, double lambda) {
+    memset(rls, 0, sizeof(*rls));
+    rls->n = n;
+    rls->lambda = lambda;
+    for (int i = 0; i < n; i++) {
+        rls->theta[i] = theta0[i];
+        rls->P[i][i] = p0[i];
+        rls->max_trace += p0[i];
+    }
+}
+
+double rls_predict(const RLSEstimator *rls, const double *x) {
+    double y = 0.0;
+    for (int i = 0; i < rls->n; i++) y += rls->theta[i] * x[i];
+    return y;
+}
+
+void rls_update(RLSEstimator *rls, const double *x, double y) {
+    const int n = rls->n;
+    double px[RLS_MAX_PARAMS], k[RLS_MAX_PARAMS];
+
+    double denom = rls->lambda;
+    for (int i = 0; i < n; i++) {
+        px[i] = 0.0;
+        for (int j = 0; j < n; j++) px[i] += rls->P[i][j] * x[j];
+        denom += x[i] * px[i];
+    }
+    for (int i = 0; i < n; i++) k[i] = px[i] / denom;
+
+    const double error = y - rls_predict(rls, x);
+    for (int i = 0; i < n; i++) rls->theta[i] += k[i] * error;
+
+    // P = (P - k x^T P) / lambda; P is symmetric, so x^T P = px^T.
+    double trace = 0.0;
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            rls->P[i][j] = (rls->P[i][j] - k[i] * px[j]) / rls->lambda;
+        }
+        trace += rls->P[i][i];
+    }
+    if (trace > rls->max_trace) {
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) rls->P[i][j] *= rls->max_trace / trace;
+        }
+    }
+    rls->updates++;
+}
+
+
+static int model_index(char processor_code) {
+    for (int p = 0; p < MODEL_PROCESSORS; p++) {
+        if (MODEL_PROCESSOR_CODES[p] == processor_code) return p;
+    }
+    return -1;
+}
+
+// Regressors of the latency models: a / ghz + b for the CPUs; for the GPU the
+// latency at GPU_MAX_FREQUENCY, carried to khz by the fixed gpu_latency_scale.
+static int model_regressors(int p, double khz, double *x) {
+    if (MODEL_PROCESSOR_CODES[p] == 'G') {
+        x[0] = gpu_latency_scale(khz);
+        return 1;
+    }
+    x[0] = 1e6 / khz;
+    x[1] = 1.0;
+    return 2;
+}
+
+// The slope carries the model and the intercept may only add to it, so every
+// frequency gets a positive latency.
+static bool model_positive(const RLSEstimator *rls) {
+    return rls->theta[0] > 0.0 && (rls->n < 2 || rls->theta[1] >= 0.0);
+}
+
+// An update of the CPU slope alone, for samples that would pull the intercept
+// below zero: the intercept stays where it is, and the slope is decoupled from it.
+static void model_update_slope(RLSEstimator *rls, const double *x, double y) {
+    const double px = rls->P[0][0] * x[0];
+    const double k = px / (rls->lambda + x[0] * px);
+
+    rls->theta[0] += k * (y - rls_predict(rls, x));
+    rls->P[0][0] = (rls->P[0][0] - k * px) / rls->lambda;
+    rls->P[0][1] = rls->P[1][0] = 0.0;
+    if (rls->P[0][0] + rls->P[1][1] > rls->max_trace) rls->P[0][0] = rls->max_trace - rls->P[1][1];
+    rls->updates++;
+}
+
+static double model_fitted_latency(int p, const double *x) {
+    double y = 0.0;
+    for (int i = 0; i < processor_models[p].n; i++) y += MODEL_PRIORS[p][i] * x[i];
+    return y;
+}
+
+static void model_prior_init(int p) {
+    double p0[RLS_MAX_PARAMS];
+    for (int i = 0; i < RLS_MAX_PARAMS; i++) {
+        double std = RLS_PRIOR_REL_STD * MODEL_PRIORS[p][i];
+        p0[i] = std * std;
+    }
+    rls_init(&processor_models[p], MODEL_PROCESSOR_CODES[p] == 'G' ? 1 : 2, MODEL_PRIORS[p], p0, RLS_FORGETTING_FACTOR);
+    holdout_error[p][0] = holdout_error[p][1] = 0.0;
+    validated[p] = false;
+}
+
+static void power_prior_init(void) {
+    const double theta0[RLS_MAX_PARAMS] = {1.0, 0.0};
+    const double p0[RLS_MAX_PARAMS] = {RLS_PRIOR_REL_STD * RLS_PRIOR_REL_STD,
+                                       POWER_PRIOR_OFFSET_STD * POWER_PRIOR_OFFSET_STD};
+    rls_init(&power_model, 2, theta0, p0, RLS_FORGETTING_FACTOR);
+    power_holdout_error[0] = power_holdout_error[1] = 0.0;
+    power_validated = false;
+}
+
+// The board never draws less than it does idle, so the model only has to stay
+// positive from there up.
+static bool power_positive(const RLSEstimator *rls) {
+    return rls->theta[0] > 0.0 && rls->theta[0] * IDLE_POWER + rls->theta[1] > 0.0;
+}
+
+void model_estimator_reset(void) {
+    for (int p = 0; p < MODEL_PROCESSORS; p++) model_prior_init(p);
+    power_prior_init();
+    models_initialized = 1;
+}
+
+static void model_estimator_init(void) {
+    if (!models_initialized) model_estimator_reset();
+}
+
+
+int model_estimator_load(const char *path, const char *device_id) {
+    model_estimator_init();
+
+    FILE *fp = fopen(path, "r");
+    if (!fp) return -1;
+
+    char line[512];
+    char stored_id[256] = "";
+    if (!fgets(line, sizeof(line), fp) || sscanf(line, "device %255s", stored_id) != 1 ||
+        strcmp(stored_id, device_id) != 0) {
+        printf("model_estimator_load: %s belongs to device '%s', not '%s'; starting from the fitted models\n",
+               path, stored_id, device_id);
+        fclose(fp);
+        return -1;
+    }
+
+    int loaded = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        char code;
+        int updates;
+        double v[6];
+
+        int n = sscanf(line, "%c %d %lf %lf %lf %lf %lf %lf", &code, &updates, &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]);
+        int p = model_index(code);
+        if (p < 0 && code != 'P') continue;
+
+        RLSEstimator *rls = p < 0 ? &power_model : &processor_models[p];
+        if (rls->n == 1 && n == 4) {
+            rls->theta[0] = v[0];
+            rls->P[0][0] = v[1];
+        } else if (rls->n == 2 && n == 8) {
+            rls->theta[0] = v[0];
+            rls->theta[1] = v[1];
+            rls->P[0][0] = v[2];
+            rls->P[0][1] = v[3];
+            rls->P[1][0] = v[4];
+            rls->P[1][1] = v[5];
+        } else {
+            continue;
+        }
+        rls->updates = updates;
+        if (p < 0 ? !power_positive(rls) : !model_positive(rls)) {
+            printf("model_estimator_load: the %c model in %s is not positive, starting it from the fitted model\n", code, path);
+            if (p < 0) power_prior_init();
+            else model_prior_init(p);
+            continue;
+        }
+        loaded++;
+    }
+    fclose(fp);
+
+    printf("model_estimator_load: %d processor models for '%s' from %s\n", loaded, device_id, path);
+    return 0;
+}
+
+int model_estimator_save(const char *path, const char *device_id) {
+    model_estimator_init();
+
+    char tmp_path[512];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *fp = fopen(tmp_path, "w");
+    if (!fp) return -1;
+
+    fprintf(fp, "device %s\n", device_id);
+    for (int p = 0; p < MODEL_PROCESSORS; p++) {
+        const RLSEstimator *rls = &processor_models[p];
+        if (rls->n == 1) {
+            fprintf(fp, "%c %d %.9g %.9g\n", MODEL_PROCESSOR_CODES[p], rls->updates, rls->theta[0], rls->P[0][0]);
+        } else {
+            fprintf(fp, "%c %d %.9g %.9g %.9g %.9g %.9g %.9g\n", MODEL_PROCESSOR_CODES[p], rls->updates,
+                    rls->theta[0], rls->theta[1], rls->P[0][0], rls->P[0][1], rls->P[1][0], rls->P[1][1]);
+        }
+    }
+    fprintf(fp, "P %d %.9g %.9g %.9g %.9g %.9g %.9g\n", power_model.updates, power_model.theta[0], power_model.theta[1],
+            power_model.P[0][0], power_model.P[0][1], power_model.P[1][0], power_model.P[1][1]);
+
+    if (fclose(fp) != 0 || rename(tmp_path, path) != 0) {
+        remove(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+
+// One run with a power sensor reading is one sample of the board power at the
+// fitted estimate, with the same outlier, held-out and positivity rules as
+// the latency samples.
+static void model_power_observe(const PipelineConfig *config, const stats_t *stats) {
+    const double sample = measured_power(stats);
+    if (sample <= 0.0) return;
+
+    PipelineConfig ran = *config;
+    const double x[RLS_MAX_PARAMS] = {estimate_fitted_power(&ran), 1.0};
+    const double predicted = rls_predict(&power_model, x);
+    if (predicted > 0.0 && (sample > predicted * MODEL_OUTLIER_RATIO || sample < predicted / MODEL_OUTLIER_RATIO)) {
+        printf("[models] ignoring power sample %.3fW (model %.3fW)\n", sample, predicted);
+        return;
+    }
+
+    if (power_model.updates > 0) {
+        const double lambda = power_model.lambda;
+        power_holdout_error[0] = lambda * power_holdout_error[0] + fabs(predicted - sample) / sample;
+        power_holdout_error[1] = lambda * power_holdout_error[1] + fabs(x[0] - sample) / sample;
+        power_validated = power_holdout_error[0] <= power_holdout_error[1];
+    }
+
+    RLSEstimator updated = power_model;
+    rls_update(&updated, x, sample);
+    if (!power_positive(&updated)) {
+        printf("[models] dropping power sample %.3fW, it would make the model non-positive\n", sample);
+        return;
+    }
+    power_model = updated;
+}
+
+void model_estimator_observe(const PipelineConfig *config, const stats_t *stats) {
+    const double stage_ms[3] = {
+        stats->stage1_inference_time, stats->stage2_inference_time, stats->stage3_inference_time
+    };
+    const int bounds[4] = {0, config->partition_point1, config->partition_point2, TOTAL_LAYERS};
+
+    model_estimator_init();
+
+    for (int s = 0; s < 3; s++) {
+        if (bounds[s + 1] <= bounds[s] || stage_ms[s] <= 0.0) continue;
+
+        double fraction = compute_weighted_fraction(bounds[s], bounds[s + 1]);
+        int p = model_index(config->order[2 * s]);
+        if (p < 0 || fraction < MODEL_MIN_FRACTION) continue;
+
+        double khz = get_processor_frequency(config, config->order[2 * s]);
+        double x[RLS_MAX_PARAMS];
+        model_regressors(p, khz, x);
+
+        // A stage time divided by its share of the work is one sample of the
+        // whole-network latency; CPU stages on fewer cores count as all cores.
+        double sample = stage_ms[s] / fraction;
+        if (config->order[2 * s] != 'G') sample /= estimate_stage_scale(config, config->order[2 * s]);
+        double predicted = rls_predict(&processor_models[p], x);
+        if (predicted > 0.0 && (sample > predicted * MODEL_OUTLIER_RATIO || sample < predicted / MODEL_OUTLIER_RATIO)) {
+            printf("[models] ignoring stage%d sample %.1fms for %c (model %.1fms)\n", s + 1, sample, config->order[2 * s], predicted);
+            continue;
+        }
+
+        // The sample is held out of the learned model until it has been predicted.
+        if (processor_models[p].updates > 0) {
+            const double lambda = processor_models[p].lambda;
+            holdout_error[p][0] = lambda * holdout_error[p][0] + fabs(predicted - sample) / sample;
+            holdout_error[p][1] = lambda * holdout_error[p][1] + fabs(model_fitted_latency(p, x) - sample) / sample;
+            validated[p] = holdout_error[p][0] <= holdout_error[p][1];
+        }
+
+        RLSEstimator updated = processor_models[p];
+        rls_update(&updated, x, sample);
+        if (updated.n == 2 && updated.theta[1] < 0.0) {
+            updated = processor_models[p];
+            model_update_slope(&updated, x, sample);
+        }
+        if (!model_positive(&updated)) {
+            printf("[models] dropping stage%d sample %.1fms for %c, it would make the model non-positive\n",
+                   s + 1, sample, config->order[2 * s]);
+            continue;
+        }
+        processor_models[p] = updated;
+    }
+
+    model_power_observe(config, stats);
+}
+
+double model_estimator_latency(char processor_code, double khz) {
+    model_estimator_init();
+
+    int p = model_index(processor_code);
+    if (p < 0) return NAN;
+
+    double x[RLS_MAX_PARAMS];
+    model_regressors(p, khz, x);
+    double latency = validated[p] ? rls_predict(&processor_models[p], x) : model_fitted_latency(p, x);
+    return latency > MODEL_MIN_LATENCY_MS ? latency : MODEL_MIN_LATENCY_MS;
+}
+
+double model_estimator_power(double fitted_watts) {
+    model_estimator_init();
+
+    if (!power_validated) return fitted_watts;
+    const double x[RLS_MAX_PARAMS] = {fitted_watts, 1.0};
+    const double watts = rls_predict(&power_model, x);
+    return watts > POWER_MIN_WATTS ? watts : POWER_MIN_WATTS;
+}
+
+bool model_estimator_ready(char processor_code) {
+    model_estimator_init();
+
+    if (processor_code == 'P') return power_validated && power_model.updates >= MODEL_MIN_UPDATES;
+    int p = model_index(processor_code);
+    return p >= 0 && validated[p] && processor_models[p].updates >= MODEL_MIN_UPDATES;
+}
+
+void model_estimator_report(void) {
+    model_estimator_init();
+
+    const RLSEstimator *g = &processor_models[0];
+    const RLSEstimator *b = &processor_models[1];
+    const RLSEstimator *l = &processor_models[2];
+    printf("[models] GPU latency=%.1fms (%d updates%s) | big latency=%.1f/ghz%+.1fms (%d updates%s) | little latency=%.1f/ghz%+.1fms (%d updates%s)\n",
+           g->theta[0], g->updates, validated[0] ? "" : ", fitted in use",
+           b->theta[0], b->theta[1], b->updates, validated[1] ? "" : ", fitted in use",
+           l->theta[0], l->theta[1], l->updates, validated[2] ? "" : ", fitted in use");
+    if (power_model.updates > 0) {
+        printf("[models] power=%.3f*fitted%+.3fW (%d updates%s)\n", power_model.theta[0], power_model.theta[1],
+               power_model.updates, power_validated ? "" : ", fitted in use");
+    }
+}
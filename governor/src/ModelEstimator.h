@@ -0,0 +1,73 @@
+#ifndef MODELESTIMATOR_H
+#define MODELESTIMATOR_H
+
+#include <stdbool.h>
+
+#include "PipelineConfig.h"
+#include "Governor.h"
+
+#define RLS_MAX_PARAMS 2
+#define RLS_FORGETTING_FACTOR 0.95
+#define RLS_PRIOR_REL_STD 0.25    // prior standard deviation relative to the fitted coefficient
+
+#define MODEL_MIN_UPDATES 3       // observations before a processor model is trusted for decisions
+#define MODEL_MIN_FRACTION 0.05   // stages carrying less of the network are too noisy to learn from
+#define MODEL_OUTLIER_RATIO 4.0   // samples this far off the current model are dropped
+#define MODEL_MIN_LATENCY_MS 1.0  // floor on any prediction
+#define POWER_PRIOR_OFFSET_STD 0.5  // W, prior standard deviation of the power model's offset
+#define POWER_MIN_WATTS 0.1         // floor on a recalibrated power estimate
+#define MODEL_STATE_PREFIX "model_state_"
+
+// Recursive least squares with exponential forgetting: y ~ theta . x, where
+// old observations lose weight by lambda per update. The covariance is kept
+// below its prior trace so directions the data never excites (e.g. a single
+// frequency) do not wind up between informative runs.
+typedef struct {
+    int n;
+    double theta[RLS_MAX_PARAMS];
+    double P[RLS_MAX_PARAMS][RLS_MAX_PARAMS];
+    double lambda;
+    double max_trace;
+    int updates;
+} RLSEstimator;
+
+void rls_init(RLSEstimator *rls, int n, const double *theta0, const double *p0, double lambda);
+
+double rls_predict(const RLSEstimator *rls, const double *x);
+
+void rls_update(RLSEstimator *rls, const double *x, double y);
+
+// Online recalibration of the whole-network latency models
+// (fx_latency_bcpu, fx_latency_lcpu, fx_latency_gpu). The fitted
+// constants are the prior; every measured stage time refines the model of
+// the processor that ran it. Models stay positive at every table frequency
+// (slope > 0, intercept >= 0); an update that would break that is dropped.
+// Each sample is first held out and predicted by both models: until the
+// learned model's held-out error (decayed like its data) is no larger than the
+// fitted one's, the fitted model is what the rest of the governor sees.
+void model_estimator_reset(void);
+
+int model_estimator_load(const char *path, const char *device_id);
+
+int model_estimator_save(const char *path, const char *device_id);
+
+void model_estimator_observe(const PipelineConfig *config, const stats_t *stats);
+
+// Current whole-network latency of a processor ('G', 'B' or 'L') at khz: the
+// learned model once it passed the held-out check, the fitted one before.
+double model_estimator_latency(char processor_code, double khz);
+
+// Measured board power against the fitted estimate_power, fed by runs with a
+// power sensor reading: watts ~ a * fitted + b, prior a = 1, b = 0, kept
+// positive from IDLE_POWER up and held out like the latency models.
+// The fitted estimate carries the power fits (fx_power_*) and everything the
+// thermal model adds, so one correction covers them all.
+double model_estimator_power(double fitted_watts);
+
+// The learned model has MODEL_MIN_UPDATES updates and passed the held-out
+// check; 'P' asks about the power model.
+bool model_estimator_ready(char processor_code);
+
+void model_estimator_report(void);
+
+#endif
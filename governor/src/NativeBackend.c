@@ -0,0 +1,328 @@
+#define _GNU_SOURCE
+#include "NativeBackend.h"
+#include "ThermalModel.h"
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define CPUFREQ_LITTLE_POLICY "/sys/devices/system/cpu/cpufreq/policy0"
+#define CPUFREQ_BIG_POLICY "/sys/devices/system/cpu/cpufreq/policy2"
+#define DEVFREQ_GPU "/sys/class/devfreq/ffe40000.gpu"
+#define FAN_CLASS "/sys/class/fan"
+#define CPU_DEVICES "/sys/devices/system/cpu"
+
+
+static int native_write_node(NativeBackend *nb, const char *node, const char *value) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s%s", nb->sysfs_root, node);
+
+    int fd = open(path, O_WRONLY | O_TRUNC);
+    if (fd < 0) {
+        fprintf(stderr, "native_backend: cannot open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    size_t len = strlen(value);
+    ssize_t written = write(fd, value, len);
+    close(fd);
+
+    if (written != (ssize_t)len) {
+        fprintf(stderr, "native_backend: cannot write %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static int native_read_node_int(NativeBackend *nb, const char *node, int *value) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s%s", nb->sysfs_root, node);
+
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    int n = fscanf(f, "%d", value);
+    fclose(f);
+    return n == 1 ? 0 : -1;
+}
+
+static int native_set_policy_frequency(NativeBackend *nb, const char *policy, const char *name, int freq) {
+    char node[256];
+    char value[32];
+
+    snprintf(node, sizeof(node), "%s/scaling_governor", policy);
+    if (native_write_node(nb, node, "performance\n") != 0) return -1;
+
+    snprintf(node, sizeof(node), "%s/scaling_max_freq", policy);
+    snprintf(value, sizeof(value), "%d\n", freq);
+    if (native_write_node(nb, node, value) != 0) return -1;
+
+    int readback = 0;
+    if (native_read_node_int(nb, node, &readback) != 0 || readback != freq) {
+        fprintf(stderr, "Error: Frequency was not set correctly (%s: wanted %d, got %d)\n", name, freq, readback);
+        return -1;
+    }
+    return 0;
+}
+
+// Same for the Mali through devfreq, in Hz; the readback is the OPP it clamped to.
+static int native_set_gpu_frequency(NativeBackend *nb, int freq) {
+    char value[32];
+    const int hz = gpu_devfreq_hz(freq);
+
+    if (native_write_node(nb, DEVFREQ_GPU "/governor", "performance\n") != 0) return -1;
+
+    snprintf(value, sizeof(value), "%d\n", hz);
+    if (native_write_node(nb, DEVFREQ_GPU "/max_freq", value) != 0) return -1;
+
+    int readback = 0;
+    if (native_read_node_int(nb, DEVFREQ_GPU "/max_freq", &readback) != 0 ||
+        gpu_devfreq_mhz(readback) != gpu_devfreq_mhz(hz)) {
+        fprintf(stderr, "Error: Frequency was not set correctly (gpu: wanted %d, got %d)\n", hz, readback);
+        return -1;
+    }
+    return 0;
+}
+
+
+int native_backend_init(NativeBackend *nb, const char *graph_dir, const char *sysfs_root) {
+    snprintf(nb->graph_dir, sizeof(nb->graph_dir), "%s", graph_dir);
+    snprintf(nb->sysfs_root, sizeof(nb->sysfs_root), "%s", sysfs_root ? sysfs_root : "");
+
+    if (access(nb->graph_dir, X_OK) != 0) {
+        fprintf(stderr, "native_backend_init: graph directory %s not accessible\n", nb->graph_dir);
+        return -1;
+    }
+
+    nb->graph_pid = -1;
+    nb->from_graph = NULL;
+
+    setenv("LD_LIBRARY_PATH", nb->graph_dir, 1);
+    printf("[native] graph_dir=%s sysfs_root=\"%s\"\n", nb->graph_dir, nb->sysfs_root);
+    return 0;
+}
+
+
+int native_backend_set_frequencies(NativeBackend *nb, const PipelineConfig *config) {
+    int ret = 0;
+    ret |= native_set_policy_frequency(nb, CPUFREQ_LITTLE_POLICY, "little", config->little_frequency);
+    ret |= native_set_policy_frequency(nb, CPUFREQ_BIG_POLICY, "big", config->big_frequency);
+    ret |= native_set_gpu_frequency(nb, config->gpu_frequency);
+    return ret;
+}
+
+
+int native_backend_set_fan(NativeBackend *nb, int enable, int mode, int level) {
+    char value[16];
+    int ret = 0;
+
+    snprintf(value, sizeof(value), "%d\n", enable);
+    ret |= native_write_node(nb, FAN_CLASS "/enable", value);
+    snprintf(value, sizeof(value), "%d\n", mode);
+    ret |= native_write_node(nb, FAN_CLASS "/mode", value);
+    snprintf(value, sizeof(value), "%d\n", level);
+    ret |= native_write_node(nb, FAN_CLASS "/level", value);
+    return ret;
+}
+
+
+int native_backend_set_online_cores(NativeBackend *nb, unsigned int mask) {
+    char node[64];
+    int ret = 0;
+
+    for (int cpu = 0; cpu < NUM_CORES; cpu++) {
+        if (!is_parkable_core(cpu)) continue;
+        const int online = (mask >> cpu) & 1;
+        snprintf(node, sizeof(node), CPU_DEVICES "/cpu%d/online", cpu);
+        if (native_write_node(nb, node, online ? "1\n" : "0\n") != 0) {
+            ret = -1;
+            continue;
+        }
+
+        int readback = -1;
+        if (native_read_node_int(nb, node, &readback) != 0 || readback != online) {
+            fprintf(stderr, "Error: Core was not hotplugged (cpu%d: wanted %d, got %d)\n", cpu, online, readback);
+            ret = -1;
+        }
+    }
+    return ret;
+}
+
+
+int native_backend_read_temperature(NativeBackend *nb, double *celsius) {
+    int millidegrees;
+    if (native_read_node_int(nb, THERMAL_ZONE "/temp", &millidegrees) != 0) return -1;
+    *celsius = millidegrees / 1000.0;
+    return 0;
+}
+
+
+int native_backend_launch(NativeBackend *nb, const PipelineConfig *config,
+                          const char *graph, int n_frames) {
+    char path[512];
+    char n_arg[32], pp1_arg[48], pp2_arg[48], order_arg[32], threads_arg[32], threads2_arg[32];
+
+    snprintf(path, sizeof(path), "%s/%s", nb->graph_dir, graph);
+    snprintf(n_arg, sizeof(n_arg), "--n=%d", n_frames);
+    snprintf(pp1_arg, sizeof(pp1_arg), "--partition_point=%d", config->partition_point1);
+    snprintf(pp2_arg, sizeof(pp2_arg), "--partition_point2=%d", config->partition_point2);
+    snprintf(order_arg, sizeof(order_arg), "--order=%s", config->order);
+    snprintf(threads_arg, sizeof(threads_arg), "--threads=%d", get_processor_threads(config, 'B'));
+    snprintf(threads2_arg, sizeof(threads2_arg), "--threads2=%d", get_processor_threads(config, 'L'));
+
+    char *argv[] = {
+        path, threads_arg, threads2_arg, "--target=CL",
+        n_arg, pp1_arg, pp2_arg, order_arg, NULL
+    };
+
+    int pipefd[2];
+    if (pipe(pipefd) != 0) {
+        perror("native_backend_launch: pipe");
+        return -1;
+    }
+
+    const unsigned int mask = get_affinity_mask(config);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("native_backend_launch: fork");
+        close(pipefd[0]);
+        close(pipefd[1]);
+        return -1;
+    }
+
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_RDONLY);
+        if (null_fd >= 0) dup2(null_fd, STDIN_FILENO);
+        dup2(pipefd[1], STDOUT_FILENO);
+        dup2(pipefd[1], STDERR_FILENO);
+        close(pipefd[0]);
+        close(pipefd[1]);
+
+        // The graph expects to be started from its own directory, on the cores it was given.
+        if (chdir(nb->graph_dir) != 0) {
+            fprintf(stderr, "native_backend_launch: cannot chdir to %s\n", nb->graph_dir);
+        }
+        cpu_set_t graph_mask;
+        CPU_ZERO(&graph_mask);
+        for (int cpu = 0; cpu < 32; cpu++) {
+            if (mask & (1u << cpu)) CPU_SET(cpu, &graph_mask);
+        }
+        if (sched_setaffinity(0, sizeof(graph_mask), &graph_mask) != 0) {
+            fprintf(stderr, "native_backend_launch: cannot pin to cores 0x%x: %s\n", mask, strerror(errno));
+        }
+
+        execv(path, argv);
+        fprintf(stderr, "native_backend_launch: cannot exec %s: %s\n", path, strerror(errno));
+        _exit(127);
+    }
+    close(pipefd[1]);
+
+    nb->graph_pid = pid;
+    nb->from_graph = fdopen(pipefd[0], "r");
+    return 0;
+}
+
+
+int native_backend_collect(NativeBackend *nb, stats_t *stats) {
+    if (nb->graph_pid < 0 || !nb->from_graph) {
+        fprintf(stderr, "native_backend_collect: no graph running\n");
+        return -1;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+
+    char *line = NULL;
+    size_t len = 0;
+
+    errno = 0;
+    while (getline(&line, &len, nb->from_graph) != -1) {
+        parse_result_line(line, stats);
+    }
+    bool interrupted = (errno == EINTR);
+    free(line);
+    fclose(nb->from_graph);
+    nb->from_graph = NULL;
+
+    pid_t pid = nb->graph_pid;
+    nb->graph_pid = -1;
+
+    if (interrupted) {
+        kill(pid, SIGTERM);
+    }
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+        kill(pid, SIGTERM);
+    }
+
+    if (interrupted || (WIFSIGNALED(status) && WTERMSIG(status) == SIGINT)) {
+        printf("[native] interrupted while waiting for the graph\n");
+        return -1;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "native_backend_collect: graph exited abnormally (status=0x%x)\n", status);
+        return -1;
+    }
+    return 0;
+}
+
+
+int native_backend_read_window(NativeBackend *nb, stats_t *stats) {
+    if (nb->graph_pid < 0 || !nb->from_graph) {
+        fprintf(stderr, "native_backend_read_window: no graph running\n");
+        return -1;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+
+    char *line = NULL;
+    size_t len = 0;
+    bool block = false;
+
+    errno = 0;
+    while (getline(&line, &len, nb->from_graph) != -1) {
+        // parse_result_line tokenizes the line, so look for the end of the block first.
+        block = strstr(line, "Frame latency is:") != NULL;
+        parse_result_line(line, stats);
+        if (block) break;
+    }
+    bool interrupted = !block && (errno == EINTR);
+    free(line);
+
+    if (block) return 0;
+    if (interrupted) {
+        printf("[native] interrupted while waiting for the graph\n");
+        return -1;
+    }
+
+    // End of output: reap the graph; collect does the bookkeeping.
+    stats_t discard;
+    native_backend_collect(nb, &discard);
+    return 1;
+}
+
+
+int native_backend_pause(NativeBackend *nb, bool paused) {
+    if (nb->graph_pid < 0) return -1;
+    return kill(nb->graph_pid, paused ? SIGSTOP : SIGCONT);
+}
+
+
+void native_backend_stop(NativeBackend *nb) {
+    if (nb->graph_pid < 0) return;
+
+    kill(nb->graph_pid, SIGTERM);
+    if (nb->from_graph) {
+        fclose(nb->from_graph);
+        nb->from_graph = NULL;
+    }
+
+    int status;
+    while (waitpid(nb->graph_pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    nb->graph_pid = -1;
+}
@@ -0,0 +1,47 @@
+#ifndef NATIVEBACKEND_H
+#define NATIVEBACKEND_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "PipelineConfig.h"
+#include "Governor.h"
+
+// On-board execution: the governor runs on the VIM3 itself, writes the cpufreq
+// nodes directly and spawns the graph binary, parsing its stdout from a pipe
+// while it runs. sysfs_root and graph_dir can point at a fake tree and a stub
+// graph (see experiments/fake_device.sh setup) to run it on any Linux box.
+typedef struct {
+    char graph_dir[256];
+    char sysfs_root[256];
+    pid_t graph_pid;
+    FILE *from_graph;
+} NativeBackend;
+
+int native_backend_init(NativeBackend *nb, const char *graph_dir, const char *sysfs_root);
+
+int native_backend_set_frequencies(NativeBackend *nb, const PipelineConfig *config);
+
+int native_backend_set_fan(NativeBackend *nb, int enable, int mode, int level);
+
+int native_backend_set_online_cores(NativeBackend *nb, unsigned int mask);
+
+int native_backend_read_temperature(NativeBackend *nb, double *celsius);
+
+int native_backend_launch(NativeBackend *nb, const PipelineConfig *config,
+                          const char *graph, int n_frames);
+
+// Waits for the graph and parses its output. Returns -1 if it was
+// interrupted, crashed or exited non-zero.
+int native_backend_collect(NativeBackend *nb, stats_t *stats);
+
+// Live mode: reads the running graph's output up to the next "Frame latency is:"
+// line. Returns 1 once the graph has exited.
+int native_backend_read_window(NativeBackend *nb, stats_t *stats);
+
+void native_backend_stop(NativeBackend *nb);
+
+int native_backend_pause(NativeBackend *nb, bool paused);
+
+#endif
@@ -0,0 +1,438 @@
+#include "Optimizer.h"
+#include "ApproximationModels.h"
+#include "PipelineSim.h"
+#include "PIDController.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+const char *const OPTIMIZER_ORDERS[OPTIMIZER_NUM_ORDERS] = {
+    "G-B-L", "G-L-B", "B-G-L", "B-L-G", "L-G-B", "L-B-G"
+};
+
+// Measured exp4 partition and exp5 order sweeps at big 1.8 GHz, little
+// 1.2 GHz, GPU and threads at max: mean of the replicates of each layout.
+typedef struct {
+    int partition_point1;
+    int partition_point2;
+    const char *order;
+    double fps;
+    double latency;
+} OptimizerCalibrationPoint;
+
+static const OptimizerCalibrationPoint OPTIMIZER_CALIBRATION_POINTS[] = {
+    {1, 4, "G-B-L",  6.45, 261.9}, {1, 6, "G-B-L",  6.70, 311.0}, {1, 7, "G-B-L",  5.91, 351.0},
+    {2, 2, "G-B-L",  4.49, 248.5}, {2, 3, "G-B-L",  5.35, 243.3}, {2, 4, "G-B-L",  6.39, 220.6},
+    {2, 5, "G-B-L",  7.60, 208.5}, {2, 6, "G-B-L", 10.87, 211.9}, {2, 7, "G-B-L",  8.94, 250.6},
+    {2, 8, "G-B-L", 11.19, 120.0}, {3, 5, "G-B-L",  7.68, 199.0}, {3, 6, "G-B-L", 13.04, 191.2},
+    {3, 7, "G-B-L", 10.45, 226.0}, {4, 6, "G-B-L", 16.21, 166.5}, {4, 7, "G-B-L", 12.31, 203.2},
+    {5, 6, "G-B-L", 18.32, 152.0}, {5, 7, "G-B-L", 14.45, 183.7}, {5, 8, "G-B-L", 13.42, 119.2},
+    {6, 6, "G-B-L", 12.41, 130.8}, {6, 7, "G-B-L", 12.56, 238.7}, {6, 8, "G-B-L", 12.77, 156.5},
+    {2, 5, "G-L-B",  9.62, 237.1}, {3, 6, "G-L-B",  6.97, 321.5},
+    {2, 5, "B-G-L",  7.59, 203.7}, {3, 6, "B-G-L", 15.63, 172.9},
+    {2, 5, "B-L-G", 13.43, 208.5}, {3, 5, "B-L-G", 14.91, 200.3}, {3, 6, "B-L-G",  8.41, 281.6},
+    {4, 6, "B-L-G",  9.34, 261.6}, {5, 7, "B-L-G",  8.19, 291.2}, {6, 8, "B-L-G", 10.49, 189.8},
+    {2, 5, "L-G-B",  4.98, 602.0}, {3, 6, "L-G-B",  4.25, 702.7},
+    {2, 5, "L-B-G",  3.96, 757.4}, {3, 6, "L-B-G",  3.77, 792.3},
+};
+
+static double optimizer_fps_scale[OPTIMIZER_NUM_ORDERS];
+static double optimizer_latency_scale[OPTIMIZER_NUM_ORDERS];
+static int optimizer_calibrated = 0;
+
+
+// Index into OPTIMIZER_ORDERS of the order a layout runs as, with empty
+// stages folded away the way get_order_overhead does.
+static int optimizer_order_index(const PipelineConfig *config) {
+    const char *order = get_order_overhead(config)->order;
+
+    for (int o = 0; o < OPTIMIZER_NUM_ORDERS; o++) {
+        if (strcmp(OPTIMIZER_ORDERS[o], order) == 0) return o;
+    }
+    return 0;
+}
+
+// Frame rate from the simulator and latency as the sum of the stage times;
+// optimizer_bounds and optimizer_predict share them before calibration.
+static int optimizer_raw_timing(const PipelineConfig *config, double *fps, double *slowest_ms, double *sum_ms) {
+    PipelineSimParams params;
+
+    pipeline_sim_params_from_config(config, &params);
+    *slowest_ms = 0.0;
+    *sum_ms = 0.0;
+    for (int s = 0; s < PIPELINE_SIM_STAGES; s++) {
+        double stage = params.transfer_ms[s] + params.service_ms[s];
+        if (stage > *slowest_ms) *slowest_ms = stage;
+        *sum_ms += stage;
+    }
+    if (*slowest_ms <= 0.0) return -1;
+
+    if (fps) {
+        PipelineSimResult sim;
+        if (pipeline_sim_run(&params, &sim) != 0 || sim.fps <= 0.0) return -1;
+        *fps = sim.fps;
+    }
+    return 0;
+}
+
+// The simulator only knows the layer weights and the single-processor fits, so
+// its absolute numbers are off, and by how much depends on the order: each
+// order gets the geometric mean of measured over predicted across its exp4/exp5
+// layouts. Orders without a layout of their own keep G-B-L's.
+static void optimizer_calibrate(void) {
+    double log_fps[OPTIMIZER_NUM_ORDERS] = {0.0}, log_latency[OPTIMIZER_NUM_ORDERS] = {0.0};
+    int n[OPTIMIZER_NUM_ORDERS] = {0};
+
+    for (size_t i = 0; i < sizeof(OPTIMIZER_CALIBRATION_POINTS) / sizeof(OPTIMIZER_CALIBRATION_POINTS[0]); i++) {
+        const OptimizerCalibrationPoint *point = &OPTIMIZER_CALIBRATION_POINTS[i];
+        PipelineConfig reference = {point->partition_point1, point->partition_point2, 1800000, 1200000, "",
+                                    GPU_MAX_FREQUENCY, MAX_BIG_THREADS, MAX_LITTLE_THREADS};
+        double fps, slowest, sum;
+
+        strcpy(reference.order, point->order);
+        if (optimizer_raw_timing(&reference, &fps, &slowest, &sum) != 0) continue;
+
+        const int o = optimizer_order_index(&reference);
+        log_fps[o] += log(point->fps / fps);
+        log_latency[o] += log(point->latency / sum);
+        n[o]++;
+    }
+
+    for (int o = 0; o < OPTIMIZER_NUM_ORDERS; o++) {
+        const int from = n[o] > 0 ? o : 0;
+        optimizer_fps_scale[o] = n[from] > 0 ? exp(log_fps[from] / n[from]) : 1.0;
+        optimizer_latency_scale[o] = n[from] > 0 ? exp(log_latency[from] / n[from]) : 1.0;
+    }
+    optimizer_calibrated = 1;
+}
+
+int optimizer_predict(const PipelineConfig *config, double *fps, double *latency) {
+    double slowest, sum;
+
+    if (!optimizer_calibrated) optimizer_calibrate();
+
+    // The exp6 sweep point itself is a measurement, not a prediction.
+    if (config->partition_point1 == 4 && config->partition_point2 == 6 && strcmp(config->order, "G-B-L") == 0 &&
+        config->gpu_frequency == GPU_MAX_FREQUENCY &&
+        get_processor_threads(config, 'B') == MAX_BIG_THREADS && get_processor_threads(config, 'L') == MAX_LITTLE_THREADS &&
+        get_measurement_grid_point(get_frequency_index(config->big_frequency, BIG_CPU),
+                                   get_frequency_index(config->little_frequency, LITTLE_CPU), fps, latency) == 0) {
+        return 0;
+    }
+
+    if (optimizer_raw_timing(config, fps, &slowest, &sum) != 0) return -1;
+
+    const int o = optimizer_order_index(config);
+    *fps *= optimizer_fps_scale[o];
+    *latency = sum * optimizer_latency_scale[o];
+    return 0;
+}
+
+static bool optimizer_meets(const PipelineConfig *config, double target_fps, double target_latency,
+                            OptimizerReport *report, double *fps) {
+    double latency;
+
+    report->simulations++;
+    if (optimizer_predict(config, fps, &latency) != 0) return false;
+    return *fps > 0.0 && latency > 0.0 && *fps >= target_fps && latency <= target_latency;
+}
+
+// A CPU axis runs over (frequency, threads) pairs, threads fastest, so the
+// last index is the top frequency on all cores.
+#define OPTIMIZER_BIG_AXIS (NUM_BIG_FREQUENCIES * MAX_BIG_THREADS)
+#define OPTIMIZER_LITTLE_AXIS (NUM_LITTLE_FREQUENCIES * MAX_LITTLE_THREADS)
+
+static void optimizer_set_freqs(PipelineConfig *config, int big_idx, int little_idx, int gpu_idx) {
+    config->big_frequency = BIG_FREQUENCY_TABLE[big_idx / MAX_BIG_THREADS];
+    config->big_threads = big_idx % MAX_BIG_THREADS + 1;
+    config->little_frequency = LITTLE_FREQUENCY_TABLE[little_idx / MAX_LITTLE_THREADS];
+    config->little_threads = little_idx % MAX_LITTLE_THREADS + 1;
+    config->gpu_frequency = GPU_FREQUENCY_TABLE[gpu_idx];
+}
+
+// Cheap bounds without simulating: throughput can never beat the slowest
+// stage, and the latency is the calibrated sum of the stages, which only
+// improves with frequency.
+static bool optimizer_bounds(const PipelineConfig *config, double *max_fps, double *min_latency) {
+    double slowest, sum;
+
+    if (optimizer_raw_timing(config, NULL, &slowest, &sum) != 0) return false;
+
+    const int o = optimizer_order_index(config);
+    *max_fps = 1000.0 / slowest * optimizer_fps_scale[o];
+    *min_latency = sum * optimizer_latency_scale[o];
+    return true;
+}
+
+static bool optimizer_may_meet(const PipelineConfig *config, double target_fps, double target_latency) {
+    double max_fps, min_latency;
+    return optimizer_bounds(config, &max_fps, &min_latency) &&
+           max_fps >= target_fps && min_latency <= target_latency;
+}
+
+typedef struct {
+    double power;
+    int big_idx;
+    int little_idx;
+    int gpu_idx;
+} OptimizerLeaf;
+
+static int optimizer_cmp_leaf(const void *a, const void *b) {
+    const OptimizerLeaf *x = a;
+    const OptimizerLeaf *y = b;
+    return (x->power > y->power) - (x->power < y->power);
+}
+
+
+int optimize_configuration(double target_fps, double target_latency,
+                           PipelineConfig *config, OptimizerReport *report) {
+    const int big_max = OPTIMIZER_BIG_AXIS - 1;
+    const int little_max = OPTIMIZER_LITTLE_AXIS - 1;
+    const int gpu_max = NUM_GPU_FREQUENCIES - 1;
+
+    PipelineConfig best;
+    double best_power = INFINITY;
+    double best_cost = INFINITY;
+    double fps;
+
+    memset(report, 0, sizeof(*report));
+    if (!optimizer_calibrated) optimizer_calibrate();
+
+    // The starting point gives the search an incumbent before the first subtree.
+    if (validate_frequency(config->big_frequency, BIG_CPU) &&
+        validate_frequency(config->little_frequency, LITTLE_CPU) &&
+        validate_frequency(config->gpu_frequency, GPU) &&
+        optimizer_meets(config, target_fps, target_latency, report, &fps)) {
+        best = *config;
+        best_power = estimate_power(&best);
+        best_cost = objective_cost(best_power, fps, target_fps);
+    }
+
+    for (int o = 0; o < OPTIMIZER_NUM_ORDERS; o++) {
+        for (int pp1 = 1; pp1 <= TOTAL_LAYERS; pp1++) {
+            for (int pp2 = pp1; pp2 <= TOTAL_LAYERS; pp2++) {
+                if (pp1 == 1 || pp2 - pp1 == 1 || TOTAL_LAYERS - pp2 == 1) continue;
+
+                PipelineConfig node = {pp1, pp2, 0, 0, "", 0, 0, 0};
+                strcpy(node.order, OPTIMIZER_ORDERS[o]);
+                report->subtrees++;
+
+                optimizer_set_freqs(&node, big_max, little_max, gpu_max);
+                if (!optimizer_may_meet(&node, target_fps, target_latency)) {
+                    report->pruned_infeasible++;
+                    continue;
+                }
+
+                // The objective rises with power and falls with fps, so the
+                // subtree's fps at its top frequencies turns power bounds into cost bounds.
+                double max_fps, min_latency;
+                optimizer_bounds(&node, &max_fps, &min_latency);
+
+                // estimate_power is separable in the three processors, so the
+                // minima along each axis through a reference point bound every leaf.
+                static OptimizerLeaf leaves[OPTIMIZER_BIG_AXIS * OPTIMIZER_LITTLE_AXIS * NUM_GPU_FREQUENCIES];
+                double p_big[OPTIMIZER_BIG_AXIS], p_little[OPTIMIZER_LITTLE_AXIS], p_gpu[NUM_GPU_FREQUENCIES];
+                const double p_ref = estimate_power(&node);
+                double min_big = INFINITY, min_little = INFINITY, min_gpu = INFINITY;
+                for (int b = 0; b <= big_max; b++) {
+                    optimizer_set_freqs(&node, b, little_max, gpu_max);
+                    p_big[b] = estimate_power(&node);
+                    if (p_big[b] < min_big) min_big = p_big[b];
+                }
+                for (int l = 0; l <= little_max; l++) {
+                    optimizer_set_freqs(&node, big_max, l, gpu_max);
+                    p_little[l] = estimate_power(&node);
+                    if (p_little[l] < min_little) min_little = p_little[l];
+                }
+                for (int g = 0; g <= gpu_max; g++) {
+                    optimizer_set_freqs(&node, big_max, little_max, g);
+                    p_gpu[g] = estimate_power(&node);
+                    if (p_gpu[g] < min_gpu) min_gpu = p_gpu[g];
+                }
+                if (objective_cost(min_big + min_little + min_gpu - 2.0 * p_ref, max_fps, target_fps) >= best_cost) {
+                    report->pruned_power++;
+                    continue;
+                }
+
+                // Cheapest leaf first: for the watts objective the first one
+                // predicted to meet the targets is the best of this subtree;
+                // for energy a faster, dearer leaf may still idle its way below it.
+                int n_leaves = 0;
+                for (int b = 0; b <= big_max; b++) {
+                    for (int l = 0; l <= little_max; l++) {
+                        for (int g = 0; g <= gpu_max; g++) {
+                            leaves[n_leaves].power = p_big[b] + p_little[l] + p_gpu[g] - 2.0 * p_ref;
+                            leaves[n_leaves].big_idx = b;
+                            leaves[n_leaves].little_idx = l;
+                            leaves[n_leaves].gpu_idx = g;
+                            n_leaves++;
+                        }
+                    }
+                }
+                qsort(leaves, (size_t)n_leaves, sizeof(OptimizerLeaf), optimizer_cmp_leaf);
+
+                for (int i = 0; i < n_leaves && objective_cost(leaves[i].power, max_fps, target_fps) < best_cost; i++) {
+                    optimizer_set_freqs(&node, leaves[i].big_idx, leaves[i].little_idx, leaves[i].gpu_idx);
+                    report->power_evaluations++;
+                    if (!optimizer_may_meet(&node, target_fps, target_latency)) continue;
+                    if (!optimizer_meets(&node, target_fps, target_latency, report, &fps)) continue;
+
+                    const double power = estimate_power(&node);
+                    const double cost = objective_cost(power, fps, target_fps);
+                    // Leaf powers are the separable sum; a watts leaf is taken as found.
+                    if (get_objective() == OBJECTIVE_ENERGY && cost >= best_cost) continue;
+                    best_power = power;
+                    best_cost = cost;
+                    best = node;
+                    if (get_objective() == OBJECTIVE_WATTS) break;
+                }
+            }
+        }
+    }
+
+    if (isinf(best_cost)) {
+        printf("[optimizer] no configuration predicted to meet fps>=%.2f latency<=%.2f (%d subtrees, %d simulations)\n",
+               target_fps, target_latency, report->subtrees, report->simulations);
+        return -1;
+    }
+
+    *config = best;
+    report->power = best_power;
+    report->cost = best_cost;
+    optimizer_predict(&best, &report->predicted_fps, &report->predicted_latency);
+    report->fps_scale = optimizer_fps_scale[optimizer_order_index(&best)];
+    report->latency_scale = optimizer_latency_scale[optimizer_order_index(&best)];
+
+    printf("[optimizer] best: big_freq=%d, little_freq=%d, gpu_freq=%d, threads=%d/%d, pp1=%d, pp2=%d, order=%s -> %.3f W (predicted fps=%.2f, latency=%.2f)\n",
+           best.big_frequency, best.little_frequency, best.gpu_frequency, best.big_threads, best.little_threads, best.partition_point1, best.partition_point2,
+           best.order, best_power, report->predicted_fps, report->predicted_latency);
+    if (get_objective() == OBJECTIVE_ENERGY) {
+        printf("[optimizer] %.3f J/frame at %.2f fps: busy %.0f%% of every frame period%s\n",
+               best_cost / target_fps, target_fps, 100.0 * fmin(target_fps / report->predicted_fps, 1.0),
+               get_frame_pacing() ? ", idle at the lowest OPPs" : "");
+    }
+    printf("[optimizer] %d subtrees: %d pruned infeasible, %d pruned by power bound; %d simulations, %d leaves (%s calibration fps x%.3f, latency x%.3f)\n",
+           report->subtrees, report->pruned_infeasible, report->pruned_power, report->simulations,
+           report->power_evaluations, OPTIMIZER_ORDERS[optimizer_order_index(&best)], report->fps_scale, report->latency_scale);
+    return 0;
+}
+
+int optimize_capped_configuration(double power_cap, double target_latency,
+                                  PipelineConfig *config, OptimizerReport *report) {
+    const int big_max = OPTIMIZER_BIG_AXIS - 1;
+    const int little_max = OPTIMIZER_LITTLE_AXIS - 1;
+    const int gpu_max = NUM_GPU_FREQUENCIES - 1;
+
+    PipelineConfig best;
+    double best_fps = 0.0;
+    double fps;
+
+    memset(report, 0, sizeof(*report));
+    if (!optimizer_calibrated) optimizer_calibrate();
+
+    if (validate_frequency(config->big_frequency, BIG_CPU) &&
+        validate_frequency(config->little_frequency, LITTLE_CPU) &&
+        validate_frequency(config->gpu_frequency, GPU) &&
+        estimate_power(config) <= power_cap &&
+        optimizer_meets(config, 0.0, target_latency, report, &fps)) {
+        best = *config;
+        best_fps = fps;
+    }
+
+    for (int o = 0; o < OPTIMIZER_NUM_ORDERS; o++) {
+        for (int pp1 = 1; pp1 <= TOTAL_LAYERS; pp1++) {
+            for (int pp2 = pp1; pp2 <= TOTAL_LAYERS; pp2++) {
+                if (pp1 == 1 || pp2 - pp1 == 1 || TOTAL_LAYERS - pp2 == 1) continue;
+
+                PipelineConfig node = {pp1, pp2, 0, 0, "", 0, 0, 0};
+                strcpy(node.order, OPTIMIZER_ORDERS[o]);
+                report->subtrees++;
+
+                // No frequency in the subtree beats its top one on fps or latency.
+                double max_fps, min_latency;
+                optimizer_set_freqs(&node, big_max, little_max, gpu_max);
+                if (!optimizer_bounds(&node, &max_fps, &min_latency) || min_latency > target_latency) {
+                    report->pruned_infeasible++;
+                    continue;
+                }
+                if (max_fps <= best_fps) {
+                    report->pruned_power++;
+                    continue;
+                }
+
+                static OptimizerLeaf leaves[OPTIMIZER_BIG_AXIS * OPTIMIZER_LITTLE_AXIS * NUM_GPU_FREQUENCIES];
+                double p_big[OPTIMIZER_BIG_AXIS], p_little[OPTIMIZER_LITTLE_AXIS], p_gpu[NUM_GPU_FREQUENCIES];
+                const double p_ref = estimate_power(&node);
+                for (int b = 0; b <= big_max; b++) {
+                    optimizer_set_freqs(&node, b, little_max, gpu_max);
+                    p_big[b] = estimate_power(&node);
+                }
+                for (int l = 0; l <= little_max; l++) {
+                    optimizer_set_freqs(&node, big_max, l, gpu_max);
+                    p_little[l] = estimate_power(&node);
+                }
+                for (int g = 0; g <= gpu_max; g++) {
+                    optimizer_set_freqs(&node, big_max, little_max, g);
+                    p_gpu[g] = estimate_power(&node);
+                }
+
+                int n_leaves = 0;
+                for (int b = 0; b <= big_max; b++) {
+                    for (int l = 0; l <= little_max; l++) {
+                        for (int g = 0; g <= gpu_max; g++) {
+                            const double power = p_big[b] + p_little[l] + p_gpu[g] - 2.0 * p_ref;
+                            if (power > power_cap) continue;
+                            leaves[n_leaves].power = power;
+                            leaves[n_leaves].big_idx = b;
+                            leaves[n_leaves].little_idx = l;
+                            leaves[n_leaves].gpu_idx = g;
+                            n_leaves++;
+                        }
+                    }
+                }
+                if (n_leaves == 0) {
+                    report->pruned_infeasible++;
+                    continue;
+                }
+                qsort(leaves, (size_t)n_leaves, sizeof(OptimizerLeaf), optimizer_cmp_leaf);
+
+                // Dearest leaf first: it tends to be the fastest, which
+                // tightens the fps bound for the rest of the subtree.
+                for (int i = n_leaves - 1; i >= 0; i--) {
+                    optimizer_set_freqs(&node, leaves[i].big_idx, leaves[i].little_idx, leaves[i].gpu_idx);
+                    report->power_evaluations++;
+                    if (!optimizer_bounds(&node, &max_fps, &min_latency) ||
+                        max_fps <= best_fps || min_latency > target_latency) {
+                        continue;
+                    }
+                    if (estimate_power(&node) > power_cap) continue;
+                    if (!optimizer_meets(&node, 0.0, target_latency, report, &fps) || fps <= best_fps) continue;
+
+                    best_fps = fps;
+                    best = node;
+                }
+            }
+        }
+    }
+
+    if (best_fps <= 0.0) {
+        printf("[optimizer] no configuration predicted to stay under %.2f W with latency<=%.2f (%d subtrees, %d simulations)\n",
+               power_cap, target_latency, report->subtrees, report->simulations);
+        return -1;
+    }
+
+    *config = best;
+    report->power = estimate_power(&best);
+    report->cost = report->power;
+    optimizer_predict(&best, &report->predicted_fps, &report->predicted_latency);
+    report->fps_scale = optimizer_fps_scale[optimizer_order_index(&best)];
+    report->latency_scale = optimizer_latency_scale[optimizer_order_index(&best)];
+
+    printf("[optimizer] fastest under %.2f W: big_freq=%d, little_freq=%d, gpu_freq=%d, threads=%d/%d, pp1=%d, pp2=%d, order=%s -> %.3f W (predicted fps=%.2f, latency=%.2f)\n",
+           power_cap, best.big_frequency, best.little_frequency, best.gpu_frequency, best.big_threads, best.little_threads,
+           best.partition_point1, best.partition_point2, best.order, report->power, report->predicted_fps, report->predicted_latency);
+    printf("[optimizer] %d subtrees: %d pruned infeasible, %d pruned by fps bound; %d simulations, %d leaves (%s calibration fps x%.3f, latency x%.3f)\n",
+           report->subtrees, report->pruned_infeasible, report->pruned_power, report->simulations,
+           report->power_evaluations, OPTIMIZER_ORDERS[optimizer_order_index(&best)], report->fps_scale, report->latency_scale);
+    return 0;
+}
@@ -0,0 +1,46 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <stdbool.h>
+
+#include "PipelineConfig.h"
+
+#define OPTIMIZER_NUM_ORDERS 6
+
+extern const char *const OPTIMIZER_ORDERS[OPTIMIZER_NUM_ORDERS];
+
+typedef struct {
+    int subtrees;            // (order, partition) pairs considered
+    int pruned_infeasible;   // subtrees that miss the targets even at max frequencies
+    int pruned_power;        // subtrees whose power lower bound cannot beat the incumbent
+    int simulations;         // pipeline_sim_predict calls
+    int power_evaluations;   // leaves visited in power order
+    double fps_scale;        // calibration of the simulator for the result's order (exp4/exp5)
+    double latency_scale;
+    double predicted_fps;
+    double predicted_latency;
+    double power;
+    double cost;             // objective_cost of the result
+} OptimizerReport;
+
+// Branch-and-bound over order x (pp1, pp2) x big x little frequency.
+// Returns 0 and writes the configuration predicted to meet both targets at the
+// lowest objective_cost (estimate_power for the watts objective) into config,
+// or -1 (config untouched) when none is.
+// The config passed in seeds the incumbent if it is predicted feasible.
+int optimize_configuration(double target_fps, double target_latency,
+                           PipelineConfig *config, OptimizerReport *report);
+
+// Power-capped mode (--power-cap): the same search, but for the highest
+// predicted fps among configurations whose estimate_power stays under
+// power_cap and whose predicted latency meets target_latency. report->pruned_power
+// counts subtrees cut by the fps bound instead. Returns -1 (config untouched)
+// when nothing fits under the cap.
+int optimize_capped_configuration(double power_cap, double target_latency,
+                                  PipelineConfig *config, OptimizerReport *report);
+
+// Calibrated prediction used by the search, for logging and comparisons:
+// simulated fps and the sum of the stage times, each scaled per order.
+int optimizer_predict(const PipelineConfig *config, double *fps, double *latency);
+
+#endif
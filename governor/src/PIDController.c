@@ -1,6 +1,12 @@
 #include "PIDController.h"
 #include "ApproximationModels.h"
 #include "PipelineConfig.h"
+#include "PipelineSim.h"
+#include "ModelEstimator.h"
+#include "LayerModel.h"
+#include "MeasurementCache.h"
+#include "Optimizer.h"
+#include "ThermalModel.h"
 #include <stdio.h>
 #include <math.h>
 #include <stdlib.h>
@@ -72,43 +78,62 @@ static double pid_governor_constraint_violation(const PIDGovernor *gov, const st
     if (stats->fps < gov->target_fps) {
         fps_deficit = (gov->target_fps - stats->fps) / gov->target_fps;
     }
-    if (stats->latency > gov->target_latency) {
-        lat_excess = (stats->latency - gov->target_latency) / gov->target_latency;
+    if (slo_latency(stats) > gov->target_latency) {
+        lat_excess = (slo_latency(stats) - gov->target_latency) / gov->target_latency;
     }
 
     return fmax(fps_deficit, lat_excess);
 }
 
-static void pid_governor_maybe_update_best(PIDGovernor *gov, const PipelineConfig *config,
-                                          const stats_t *stats, double estimated_power) {
-    const bool meets_targets = (stats->fps >= gov->target_fps) && (stats->latency <= gov->target_latency);
-    const double violation = pid_governor_constraint_violation(gov, stats);
-
-    if (!gov->best_valid) {
-        gov->best_config = *config;
-        gov->best_estimated_power = estimated_power;
-        gov->best_violation = violation;
-        gov->best_meets_targets = meets_targets;
-        gov->best_valid = true;
-        return;
-    }
+// Power-capped mode: how far a run is over the cap or the latency target. The
+// power is the sensor's where the run has a reading, the model's otherwise.
+// The cap is hard, so any power over it outranks the latency excess of any
+// run that stays under it, which is far below 1000 targets.
+static double pid_cap_violation(const PIDGovernor *gov, double power, double latency) {
+    if (power > gov->power_cap) return 1e3 * (1.0 + (power - gov->power_cap) / gov->power_cap);
+    return fmax(latency - gov->target_latency, 0.0) / gov->target_latency;
+}
 
-    if (violation < gov->best_violation - 1e-12) {
-        gov->best_config = *config;
-        gov->best_estimated_power = estimated_power;
-        gov->best_violation = violation;
-        gov->best_meets_targets = meets_targets;
-        return;
-    }
+// Power of a run or a candidate as the objective counts it (objective_cost).
+static double pid_cost(const PIDGovernor *gov, double power, double fps) {
+    return objective_cost(power, fps, gov->target_fps);
+}
 
-    if (fabs(violation - gov->best_violation) <= 1e-12) {
-        if (estimated_power < gov->best_estimated_power - 1e-12) {
-            gov->best_config = *config;
-            gov->best_estimated_power = estimated_power;
-            gov->best_violation = violation;
-            gov->best_meets_targets = meets_targets;
-        }
+// Among configurations that violate the targets equally, the one with the
+// lower objective cost wins: measured power when both runs had a power sensor
+// reading, the model otherwise, since the two are not on the same scale.
+// Under a power cap the violation is that of the cap and the faster one wins.
+static void pid_governor_maybe_update_best(PIDGovernor *gov, const PipelineConfig *config,
+                                          const stats_t *stats, double estimated_power) {
+    const double power = measured_power(stats);
+    const double violation = gov->power_cap > 0.0 ?
+        pid_cap_violation(gov, power > 0.0 ? power : estimated_power, slo_latency(stats)) :
+        pid_governor_constraint_violation(gov, stats);
+    const bool meets_targets = (stats->fps >= gov->target_fps) && (slo_latency(stats) <= gov->target_latency) &&
+                               (gov->power_cap <= 0.0 || violation <= 0.0);
+    bool better;
+
+    if (!gov->best_valid || violation < gov->best_violation - 1e-12) {
+        better = true;
+    } else if (fabs(violation - gov->best_violation) > 1e-12) {
+        better = false;
+    } else if (gov->power_cap > 0.0) {
+        better = stats->fps > gov->best_fps + 1e-9;
+    } else if (power > 0.0 && gov->best_measured_power > 0.0) {
+        better = pid_cost(gov, power, stats->fps) < pid_cost(gov, gov->best_measured_power, gov->best_fps) - 1e-12;
+    } else {
+        better = pid_cost(gov, estimated_power, stats->fps) <
+                 pid_cost(gov, gov->best_estimated_power, gov->best_fps) - 1e-12;
     }
+    if (!better) return;
+
+    gov->best_config = *config;
+    gov->best_estimated_power = estimated_power;
+    gov->best_measured_power = power;
+    gov->best_fps = stats->fps;
+    gov->best_violation = violation;
+    gov->best_meets_targets = meets_targets;
+    gov->best_valid = true;
 }
 
 BottleneckStage detect_bottleneck(stats_t *stats, double *bottleneck_ratio) {
@@ -205,11 +230,15 @@ void pid_governor_init(PIDGovernor *gov, double target_fps, double target_latenc
     
     gov->target_fps = target_fps;
     gov->target_latency = target_latency;
+    gov->power_cap = 0.0;
     gov->power_reduction_rate = 0.05;
     gov->iteration = 0;
     gov->max_iterations = max_iterations;
     gov->converged = false;
     gov->partition_step_cooldown = 0;
+    gov->order_switches = 0;
+    gov->thread_trades = 0;
+    gov->order_trial = false;
     gov->has_prev = false;
 
     gov->has_last_config = false;
@@ -218,16 +247,95 @@ void pid_governor_init(PIDGovernor *gov, double target_fps, double target_latenc
     gov->best_valid = false;
     gov->best_meets_targets = false;
     gov->best_estimated_power = 0.0;
+    gov->best_measured_power = 0.0;
+    gov->best_fps = 0.0;
     gov->best_violation = 0.0;
+
+    gov->history_len = 0;
+    gov->history_next = 0;
+    gov->cached_stats = false;
 }
 
 void pid_governor_reset_best(PIDGovernor *gov) {
     gov->best_valid = false;
     gov->best_meets_targets = false;
     gov->best_estimated_power = 0.0;
+    gov->best_measured_power = 0.0;
+    gov->best_fps = 0.0;
     gov->best_violation = 0.0;
 }
 
+void pid_governor_rearm(PIDGovernor *gov) {
+    pid_reset(&gov->fps_pid);
+    pid_reset(&gov->latency_pid);
+    gov->iteration = 0;
+    gov->converged = false;
+    gov->partition_step_cooldown = 0;
+    gov->order_switches = 0;
+    gov->thread_trades = 0;
+    gov->order_trial = false;
+    gov->has_prev = false;
+    gov->has_last_config = false;
+    gov->same_config_streak = 0;
+    pid_governor_reset_best(gov);
+}
+
+static void pid_governor_record(PIDGovernor *gov, const PipelineConfig *config,
+                                const stats_t *stats, double estimated_power) {
+    PIDMeasurement *slot = NULL;
+
+    for (int i = 0; i < gov->history_len && !slot; i++) {
+        if (memcmp(&gov->history[i].config, config, sizeof(*config)) == 0) slot = &gov->history[i];
+    }
+    if (!slot) {
+        slot = &gov->history[gov->history_next];
+        gov->history_next = (gov->history_next + 1) % PID_HISTORY_SIZE;
+        if (gov->history_len < PID_HISTORY_SIZE) gov->history_len++;
+    }
+    slot->config = *config;
+    slot->stats = *stats;
+    slot->estimated_power = estimated_power;
+}
+
+void pid_governor_retarget(PIDGovernor *gov, double target_fps, double target_latency,
+                           PipelineConfig *config) {
+    gov->target_fps = target_fps;
+    gov->target_latency = target_latency;
+    pid_governor_rearm(gov);
+
+    for (int i = 0; i < gov->history_len; i++) {
+        const PIDMeasurement *m = &gov->history[i];
+        pid_governor_maybe_update_best(gov, &m->config, &m->stats, m->estimated_power);
+    }
+
+    if (!gov->best_valid) {
+        printf("[PID] Retargeted to fps=%.2f, latency=%.2f with no measurements yet\n", target_fps, target_latency);
+        return;
+    }
+    *config = gov->best_config;
+    printf("[PID] Retargeted to fps=%.2f, latency=%.2f: resuming from big_freq=%d, little_freq=%d, pp1=%d, pp2=%d, order=%s "
+           "(best of %d measured configurations, meets_targets=%s)\n",
+           target_fps, target_latency, config->big_frequency, config->little_frequency,
+           config->partition_point1, config->partition_point2, config->order,
+           gov->history_len, gov->best_meets_targets ? "YES" : "NO");
+}
+
+void pid_governor_seed(PIDGovernor *gov, const PipelineConfig *config, const stats_t *stats,
+                       double estimated_power) {
+    pid_governor_record(gov, config, stats, estimated_power);
+    pid_governor_maybe_update_best(gov, config, stats, estimated_power);
+}
+
+bool pid_governor_find_measurement(const PIDGovernor *gov, const PipelineConfig *config, stats_t *stats) {
+    for (int i = 0; i < gov->history_len; i++) {
+        if (memcmp(&gov->history[i].config, config, sizeof(*config)) == 0) {
+            *stats = gov->history[i].stats;
+            return true;
+        }
+    }
+    return false;
+}
+
 bool pid_governor_get_best(const PIDGovernor *gov, PipelineConfig *out_config,
                            double *out_estimated_power, bool *out_meets_targets) {
     if (!gov->best_valid) {
@@ -254,6 +362,9 @@ int get_frequency_index(int freq, processor cpu) {
     if (cpu == BIG_CPU) {
         table = BIG_FREQUENCY_TABLE;
         num_freqs = NUM_BIG_FREQUENCIES;
+    } else if (cpu == GPU) {
+        table = GPU_FREQUENCY_TABLE;
+        num_freqs = NUM_GPU_FREQUENCIES;
     } else {
         table = LITTLE_FREQUENCY_TABLE;
         num_freqs = NUM_LITTLE_FREQUENCIES;
@@ -282,6 +393,9 @@ int frequency_step(int current_freq, int steps, processor cpu) {
     if (cpu == BIG_CPU) {
         table = BIG_FREQUENCY_TABLE;
         num_freqs = NUM_BIG_FREQUENCIES;
+    } else if (cpu == GPU) {
+        table = GPU_FREQUENCY_TABLE;
+        num_freqs = NUM_GPU_FREQUENCIES;
     } else {
         table = LITTLE_FREQUENCY_TABLE;
         num_freqs = NUM_LITTLE_FREQUENCIES;
@@ -304,6 +418,9 @@ int snap_to_valid_frequency(int freq, processor cpu) {
     if (cpu == BIG_CPU) {
         table = BIG_FREQUENCY_TABLE;
         num_freqs = NUM_BIG_FREQUENCIES;
+    } else if (cpu == GPU) {
+        table = GPU_FREQUENCY_TABLE;
+        num_freqs = NUM_GPU_FREQUENCIES;
     } else {
         table = LITTLE_FREQUENCY_TABLE;
         num_freqs = NUM_LITTLE_FREQUENCIES;
@@ -452,6 +569,251 @@ void pid_governor_adjust_partition_points(PIDGovernor *gov, PipelineConfig *conf
     }
 }
 
+// Scales the measured fps/latency by the modelled change in frame period and
+// latency (stage times plus order overhead), so only the relative accuracy of
+// the (recalibrated) models matters. A latency tail scales with the mean.
+static void pid_scale_by_stage_times(const PipelineConfig *from, const double before[3],
+                                     const PipelineConfig *to, const double after[3], const stats_t *stats,
+                                     double *fps, double *latency) {
+    double period_before, period_after, latency_before, latency_after;
+
+    estimate_pipeline_timing(from, before, &period_before, &latency_before);
+    estimate_pipeline_timing(to, after, &period_after, &latency_after);
+
+    *fps = (period_after > 0.0) ? stats->fps * period_before / period_after : stats->fps;
+    *latency = (latency_before > 0.0) ? slo_latency(stats) * latency_after / latency_before : slo_latency(stats);
+}
+
+static void pid_model_predict(const PipelineConfig *from, const PipelineConfig *to, const stats_t *stats,
+                              double *fps, double *latency) {
+    double before[3], after[3];
+
+    estimate_stage_times(from, before);
+    estimate_stage_times(to, after);
+    pid_scale_by_stage_times(from, before, to, after, stats, fps, latency);
+}
+
+static bool pid_models_ready(const PipelineConfig *config) {
+    const int bounds[4] = {0, config->partition_point1, config->partition_point2, TOTAL_LAYERS};
+
+    for (int s = 0; s < 3; s++) {
+        if (bounds[s + 1] > bounds[s] && !model_estimator_ready(config->order[2 * s])) return false;
+    }
+    return true;
+}
+
+// Layers that change processor between two configurations.
+static int pid_layer_shift(const PipelineConfig *a, const PipelineConfig *b) {
+    PipelineConfig ca = *a, cb = *b;
+    int ga = 0, ba = 0, la = 0, gb = 0, bb = 0, lb = 0;
+
+    calc_partition_sizes(&ca, TOTAL_LAYERS, &ga, &ba, &la);
+    calc_partition_sizes(&cb, TOTAL_LAYERS, &gb, &bb, &lb);
+    return abs(ga - gb) + abs(ba - bb) + abs(la - lb);
+}
+
+// Whether some fan level keeps a configuration below the throttle point.
+static bool pid_thermal_safe(const PipelineConfig *config) {
+    PipelineConfig copy = *config;
+    return thermal_model_fan_level(estimate_pipeline_power(&copy)) >= 0;
+}
+
+// What a candidate would measure: its measurement if it has one this session,
+// otherwise the more pessimistic of the learned and the fitted models with
+// PID_ORDER_MODEL_MARGIN of headroom. False if the models are not ready or
+// the candidate would throttle.
+static bool pid_predict_candidate(const PIDGovernor *gov, const PipelineConfig *config,
+                                  const PipelineConfig *candidate, const stats_t *stats, stats_t *predicted) {
+    if (!pid_thermal_safe(candidate)) return false;
+    if (pid_governor_find_measurement(gov, candidate, predicted)) return true;
+    if (!pid_models_ready(candidate)) return false;
+
+    double before[3], after[3], fitted_fps, fitted_latency;
+    *predicted = *stats;
+    pid_model_predict(config, candidate, stats, &predicted->fps, &predicted->latency);
+    estimate_fitted_stage_times(config, before);
+    estimate_fitted_stage_times(candidate, after);
+    pid_scale_by_stage_times(config, before, candidate, after, stats, &fitted_fps, &fitted_latency);
+    predicted->fps = fmin(predicted->fps, fitted_fps) * (1.0 - PID_ORDER_MODEL_MARGIN);
+    predicted->latency = fmax(predicted->latency, fitted_latency) * (1.0 + PID_ORDER_MODEL_MARGIN);
+    return true;
+}
+
+// Searches the other orders, with every partition, at the current frequencies.
+// With the targets met, the cheapest candidate (by pid_cost) predicted to keep meeting them
+// wins if it saves PID_ORDER_MIN_SAVING; otherwise the one predicted to come
+// closest to the targets wins if it halves the current violation. Configurations
+// measured in this session are judged by their measurement, the others by the
+// more pessimistic of the learned and the fitted models, with
+// PID_ORDER_MODEL_MARGIN of headroom.
+static bool pid_try_order_switch(PIDGovernor *gov, PipelineConfig *config, const stats_t *stats,
+                                 bool targets_met) {
+    if (gov->order_switches >= PID_ORDER_MAX_SWITCHES) return false;
+
+    const double current_power = estimate_power(config);
+    const double current_cost = pid_cost(gov, current_power, stats->fps);
+    const double current_violation = pid_governor_constraint_violation(gov, stats);
+    PipelineConfig best = *config;
+    double best_power = INFINITY, best_cost = INFINITY, best_violation = INFINITY;
+    int best_shift = 0;
+    bool found = false;
+
+    for (int o = 0; o < OPTIMIZER_NUM_ORDERS; o++) {
+        if (strcmp(OPTIMIZER_ORDERS[o], config->order) == 0) continue;
+
+        for (int pp1 = 1; pp1 <= TOTAL_LAYERS; pp1++) {
+            for (int pp2 = pp1; pp2 <= TOTAL_LAYERS; pp2++) {
+                if (pp1 == 1 || pp2 - pp1 == 1 || TOTAL_LAYERS - pp2 == 1) continue;
+
+                PipelineConfig candidate = *config;
+                candidate.partition_point1 = pp1;
+                candidate.partition_point2 = pp2;
+                strcpy(candidate.order, OPTIMIZER_ORDERS[o]);
+
+                stats_t predicted;
+                if (!pid_predict_candidate(gov, config, &candidate, stats, &predicted)) continue;
+
+                const double power = estimate_power(&candidate);
+                const double cost = pid_cost(gov, power, predicted.fps);
+                const double violation = pid_governor_constraint_violation(gov, &predicted);
+                const int shift = pid_layer_shift(config, &candidate);
+
+                bool better;
+                if (targets_met) {
+                    if (violation > 0.0 || cost > current_cost * (1.0 - PID_ORDER_MIN_SAVING)) continue;
+                    better = cost < best_cost - 1e-9 || (fabs(cost - best_cost) <= 1e-9 && shift < best_shift);
+                } else {
+                    if (violation >= current_violation * 0.5) continue;
+                    better = violation < best_violation - 1e-9 ||
+                             (fabs(violation - best_violation) <= 1e-9 && cost < best_cost);
+                }
+                if (!better) continue;
+
+                best = candidate;
+                best_power = power;
+                best_cost = cost;
+                best_violation = violation;
+                best_shift = shift;
+                found = true;
+            }
+        }
+    }
+
+    if (!found) {
+        printf("  [order] no other order %s at big_freq=%d little_freq=%d\n",
+               targets_met ? "saves power" : "comes closer to the targets",
+               config->big_frequency, config->little_frequency);
+        return false;
+    }
+
+    printf("[PID] Order: %s pp1=%d pp2=%d -> %s pp1=%d pp2=%d (power %.3f -> %.3f W, %d layers move, %s)\n",
+           config->order, config->partition_point1, config->partition_point2,
+           best.order, best.partition_point1, best.partition_point2,
+           current_power, best_power, best_shift,
+           targets_met ? "same targets" : "closer to the targets");
+    gov->order_trial = true;
+    gov->order_trial_from = *config;
+    gov->order_trial_violation = current_violation;
+    *config = best;
+    gov->order_switches++;
+    gov->partition_step_cooldown = 2;
+    gov->has_prev = false;
+    pid_reset(&gov->fps_pid);
+    pid_reset(&gov->latency_pid);
+    return true;
+}
+
+// Stage that runs on a processor ('G', 'B' or 'L'), -1 if it has no layers.
+static int pid_processor_stage(const PipelineConfig *config, char processor_code) {
+    const int bounds[4] = {0, config->partition_point1, config->partition_point2, TOTAL_LAYERS};
+
+    for (int s = 0; s < 3; s++) {
+        if (config->order[2 * s] == processor_code && bounds[s + 1] > bounds[s]) return s;
+    }
+    return -1;
+}
+
+// The GPU has slack when its stage is not the bottleneck and one OPP down
+// keeps it below the slowest other stage and within the latency margin.
+static bool pid_gpu_has_slack(const PipelineConfig *config, const stats_t *stats, double margin_latency,
+                              int *lower_freq) {
+    const double t[3] = {
+        stats->stage1_inference_time, stats->stage2_inference_time, stats->stage3_inference_time
+    };
+    const int gpu_stage = pid_processor_stage(config, 'G');
+
+    if (gpu_stage < 0 || config->gpu_frequency <= GPU_FREQUENCY_TABLE[0]) return false;
+    if (detect_bottleneck((stats_t *)stats, NULL) == (BottleneckStage)(BOTTLENECK_STAGE1_GPU + gpu_stage)) return false;
+
+    double slowest_other = 0.0;
+    for (int s = 0; s < 3; s++) {
+        if (s != gpu_stage && t[s] > slowest_other) slowest_other = t[s];
+    }
+
+    *lower_freq = frequency_step(config->gpu_frequency, -1, GPU);
+    const double slower = t[gpu_stage] * gpu_latency_scale(*lower_freq) / gpu_latency_scale(config->gpu_frequency);
+    return slower <= slowest_other && slower - t[gpu_stage] < margin_latency;
+}
+
+// Cores for frequency: one thread fewer on a busy cluster, at the lowest
+// frequency predicted to keep the targets (pid_predict_candidate). Taken if it
+// saves PID_THREAD_MIN_SAVING of the estimated power (pid_cost).
+static bool pid_try_thread_trade(PIDGovernor *gov, PipelineConfig *config, const stats_t *stats) {
+    if (gov->thread_trades >= PID_THREAD_MAX_TRADES) return false;
+
+    const double current_power = estimate_power(config);
+    PipelineConfig best = *config;
+    double best_power = current_power;
+    double best_cost = pid_cost(gov, current_power, stats->fps) * (1.0 - PID_THREAD_MIN_SAVING);
+    bool found = false;
+
+    for (int c = 0; c < 2; c++) {
+        const char code = (c == 0) ? 'B' : 'L';
+        const int threads = get_processor_threads(config, code);
+        const int *table = (code == 'B') ? BIG_FREQUENCY_TABLE : LITTLE_FREQUENCY_TABLE;
+        const int n_freqs = (code == 'B') ? NUM_BIG_FREQUENCIES : NUM_LITTLE_FREQUENCIES;
+
+        if (threads <= 1 || pid_processor_stage(config, code) < 0) continue;
+
+        for (int f = 0; f < n_freqs; f++) {
+            PipelineConfig candidate = *config;
+            if (code == 'B') {
+                candidate.big_threads = threads - 1;
+                candidate.big_frequency = table[f];
+            } else {
+                candidate.little_threads = threads - 1;
+                candidate.little_frequency = table[f];
+            }
+
+            stats_t predicted;
+            if (!pid_predict_candidate(gov, config, &candidate, stats, &predicted)) break;
+            if (pid_governor_constraint_violation(gov, &predicted) > 0.0) continue;
+
+            // Power rises with frequency, so the first feasible one is this cluster's best.
+            const double power = estimate_power(&candidate);
+            const double cost = pid_cost(gov, power, predicted.fps);
+            if (cost < best_cost) {
+                best = candidate;
+                best_power = power;
+                best_cost = cost;
+                found = true;
+            }
+            break;
+        }
+    }
+
+    if (!found) return false;
+
+    printf("[PID] Threads: big %d -> %d, little %d -> %d at big_freq=%d little_freq=%d (power %.3f -> %.3f W)\n",
+           get_processor_threads(config, 'B'), get_processor_threads(&best, 'B'),
+           get_processor_threads(config, 'L'), get_processor_threads(&best, 'L'),
+           best.big_frequency, best.little_frequency, current_power, best_power);
+    *config = best;
+    gov->thread_trades++;
+    gov->has_prev = false;
+    return true;
+}
+
 static bool try_reduce_power(PIDGovernor *gov, PipelineConfig *config, 
                              stats_t *stats, double margin_fps, double margin_latency) {
     printf("  [power-reduce] checking: fps_margin=%.2f (%.1f%%), lat_margin=%.2fms (%.1f%%)\n",
@@ -614,6 +976,14 @@ static bool try_reduce_power(PIDGovernor *gov, PipelineConfig *config,
     } else {
         printf("  [power-reduce] margin<=10%%, skipping little freq reduction\n");
     }
+
+    int lower_gpu;
+    if (margin_fps > 0.0 && pid_gpu_has_slack(config, stats, margin_latency, &lower_gpu)) {
+        printf("  [power-reduce] GPU stage has slack: reducing gpu freq %d -> %d\n",
+               config->gpu_frequency, lower_gpu);
+        test_config.gpu_frequency = lower_gpu;
+        reduced = true;
+    }
     
     if (usable_margin > 0.15) {
         printf("  [power-reduce] margin>15%%: considering partition adjustment\n");
@@ -626,6 +996,46 @@ static bool try_reduce_power(PIDGovernor *gov, PipelineConfig *config,
         printf("  [power-reduce] margin<=15%%, skipping partition adjustment\n");
     }
     
+    // Once the models have seen this board, skip reductions they predict to
+    // miss the targets instead of spending a run to find out; try dropping
+    // the little, the big, then the GPU frequency step before giving up.
+    // Under the energy objective a reduction must also lower pid_cost, since
+    // the slower configuration idles for less of every frame period.
+    if (reduced && pid_models_ready(config)) {
+        PipelineConfig candidates[4] = {test_config, test_config, test_config, test_config};
+        candidates[1].little_frequency = config->little_frequency;
+        candidates[2].big_frequency = config->big_frequency;
+        candidates[3].gpu_frequency = config->gpu_frequency;
+
+        int accepted = -1;
+        for (int c = 0; c < 4 && accepted < 0; c++) {
+            if (c > 0 && (memcmp(&candidates[c], config, sizeof(*config)) == 0 ||
+                          memcmp(&candidates[c], &candidates[0], sizeof(*config)) == 0)) {
+                continue;
+            }
+
+            double predicted_fps, predicted_latency;
+            pid_model_predict(config, &candidates[c], stats, &predicted_fps, &predicted_latency);
+            if (predicted_fps >= gov->target_fps && predicted_latency <= gov->target_latency &&
+                (get_objective() == OBJECTIVE_WATTS ||
+                 pid_cost(gov, estimate_power(&candidates[c]), predicted_fps) <
+                 pid_cost(gov, estimate_power(config), stats->fps))) {
+                accepted = c;
+            } else {
+                printf("  [power-reduce] models veto big_freq=%d little_freq=%d gpu_freq=%d pp1=%d pp2=%d (predicted fps=%.2f, latency=%.2f)\n",
+                       candidates[c].big_frequency, candidates[c].little_frequency, candidates[c].gpu_frequency,
+                       candidates[c].partition_point1, candidates[c].partition_point2,
+                       predicted_fps, predicted_latency);
+            }
+        }
+
+        if (accepted < 0) {
+            reduced = false;
+        } else {
+            test_config = candidates[accepted];
+        }
+    }
+
     if (reduced) {
         printf("  [power-reduce] applied reductions to config\n");
         *config = test_config;
@@ -695,11 +1105,113 @@ static bool try_reduce_power(PIDGovernor *gov, PipelineConfig *config,
     return reduced;
 }
 
+// One step of the power-capped climb. Candidates are one OPP up (one down
+// while over the cap or the latency target) on each processor with layers,
+// the same on all of them at once, and a one-layer partition move (pid_apply_partition_move) at each boundary.
+// Each is judged by its measurement if this session has one, otherwise
+// predicted from this measurement by the recalibrated models, with the model
+// power scaled by what the sensor read for this run if it did.
+// Under the cap, the fastest candidate predicted to stay under it wins if it
+// adds PID_CAP_MIN_GAIN; over it, the one closest to the cap, then the fastest.
+static PIDResult pid_capped_step(PIDGovernor *gov, PipelineConfig *config, const stats_t *stats,
+                                 double *estimated_power) {
+    const double measured = measured_power(stats);
+    const double scale = (measured > 0.0 && *estimated_power > 0.0) ? measured / *estimated_power : 1.0;
+    const double violation = pid_cap_violation(gov, *estimated_power * scale, slo_latency(stats));
+    const bool over = violation > 0.0;
+    const int step = over ? -1 : +1;
+
+    printf("[PID] iter=%d fps=%.2f lat=%.2f (target=%.2f) power=%.3fW%s (cap=%.2fW) pp1=%d pp2=%d\n",
+           gov->iteration, stats->fps, slo_latency(stats), gov->target_latency, *estimated_power * scale,
+           measured > 0.0 ? " measured" : "", gov->power_cap, config->partition_point1, config->partition_point2);
+
+    PipelineConfig candidates[8];
+    int n = 0;
+    const char codes[3] = {'B', 'L', 'G'};
+    const processor procs[3] = {BIG_CPU, LITTLE_CPU, GPU};
+    PipelineConfig all = *config;
+    for (int p = 0; p < 3; p++) {
+        if (pid_processor_stage(config, codes[p]) < 0) continue;
+        PipelineConfig candidate = *config;
+        int *freq = codes[p] == 'B' ? &candidate.big_frequency :
+                    codes[p] == 'L' ? &candidate.little_frequency : &candidate.gpu_frequency;
+        *freq = frequency_step(*freq, step, procs[p]);
+        candidates[n++] = candidate;
+        if (codes[p] == 'B') all.big_frequency = candidate.big_frequency;
+        else if (codes[p] == 'L') all.little_frequency = candidate.little_frequency;
+        else all.gpu_frequency = candidate.gpu_frequency;
+    }
+    // A stage that is not the bottleneck gains nothing alone; all of them together may.
+    candidates[n++] = all;
+    const int moves[4][2] = {{-1, 0}, {+1, 0}, {0, -1}, {0, +1}};
+    for (int m = 0; m < 4; m++) {
+        candidates[n] = *config;
+        pid_apply_partition_move(&candidates[n], moves[m][0], moves[m][1]);
+        enforce_no_single_layer_stages(&candidates[n]);
+        n++;
+    }
+
+    int best = -1;
+    double best_fps = over ? 0.0 : stats->fps * (1.0 + PID_CAP_MIN_GAIN);
+    double best_violation = violation, best_power = 0.0;
+    for (int c = 0; c < n; c++) {
+        if (memcmp(&candidates[c], config, sizeof(*config)) == 0 || !pid_thermal_safe(&candidates[c])) continue;
+
+        // Configurations measured in this session are judged by their measurement.
+        double fps, latency, power = estimate_power(&candidates[c]) * scale;
+        stats_t known;
+        if (pid_governor_find_measurement(gov, &candidates[c], &known)) {
+            fps = known.fps;
+            latency = slo_latency(&known);
+            if (measured_power(&known) > 0.0) power = measured_power(&known);
+        } else {
+            pid_model_predict(config, &candidates[c], stats, &fps, &latency);
+        }
+        const double candidate_violation = pid_cap_violation(gov, power, latency);
+
+        bool better;
+        if (!over) {
+            better = candidate_violation <= 0.0 && fps > best_fps;
+        } else {
+            better = candidate_violation < best_violation - 1e-9 ||
+                     (best >= 0 && fabs(candidate_violation - best_violation) <= 1e-9 && fps > best_fps);
+        }
+        if (!better) continue;
+
+        best = c;
+        best_fps = fps;
+        best_violation = candidate_violation;
+        best_power = power;
+    }
+
+    if (best < 0) {
+        gov->converged = true;
+        if (gov->best_valid) *config = gov->best_config;
+        *estimated_power = estimate_power(config);
+        printf("[PID] Converged at iteration %d under the %.2fW cap%s: big_freq=%d, little_freq=%d, gpu_freq=%d, threads=%d/%d, pp1=%d, pp2=%d, order=%s\n",
+               gov->iteration, gov->power_cap, over ? " (no step predicted to meet it and the latency target)" : "",
+               config->big_frequency, config->little_frequency, config->gpu_frequency,
+               config->big_threads, config->little_threads,
+               config->partition_point1, config->partition_point2, config->order);
+        return PID_CONVERGED;
+    }
+
+    printf("[PID] Cap: big_freq=%d little_freq=%d gpu_freq=%d pp1=%d pp2=%d -> big_freq=%d little_freq=%d gpu_freq=%d pp1=%d pp2=%d (predicted fps=%.2f, power=%.3fW)\n",
+           config->big_frequency, config->little_frequency, config->gpu_frequency,
+           config->partition_point1, config->partition_point2,
+           candidates[best].big_frequency, candidates[best].little_frequency, candidates[best].gpu_frequency,
+           candidates[best].partition_point1, candidates[best].partition_point2, best_fps, best_power);
+    *config = candidates[best];
+    *estimated_power = estimate_power(config);
+    return PID_CONTINUE;
+}
+
 PIDResult pid_governor_step(PIDGovernor *gov, PipelineConfig *config,
                             stats_t *stats, double *estimated_power) {
     gov->iteration++;
 
     enforce_no_single_layer_stages(config);
+    pid_governor_record(gov, config, stats, estimate_power(config));
 
     if (gov->has_last_config && memcmp(&gov->last_config, config, sizeof(*config)) == 0) {
         gov->same_config_streak++;
@@ -726,6 +1238,31 @@ PIDResult pid_governor_step(PIDGovernor *gov, PipelineConfig *config,
            gov->iteration, *estimated_power,
            stats->stage1_inference_time, stats->stage2_inference_time, stats->stage3_inference_time,
            total_inference_time);
+    if (stats->energy_per_frame > 0.0) {
+        printf("[PID-LOG] measured power=%.3fW (%.3f J/frame, model %+.1f%%)\n", measured_power(stats),
+               stats->energy_per_frame, 100.0 * (*estimated_power / measured_power(stats) - 1.0));
+    }
+
+    if (total_inference_time > 0.0) {
+        PipelineSimParams sim_params;
+        PipelineSimResult sim;
+        double ratio = 0.0;
+        BottleneckStage detected = detect_bottleneck(stats, &ratio);
+
+        pipeline_sim_params_from_stats(config, stats, &sim_params);
+        pipeline_sim_run(&sim_params, &sim);
+        printf("[PID-LOG] pipeline-sim from stage times: fps=%.2f lat=%.2fms p99=%.2fms bottleneck=stage%d | detect_bottleneck=%d (ratio=%.2f)\n",
+               sim.fps, sim.mean_latency, sim.p99_latency, sim.bottleneck_stage + 1, (int)detected, ratio);
+
+        // A throttled run measured lower frequencies than the config says.
+        if (!gov->cached_stats && thermal_model_throttling()) {
+            printf("[thermal] %.1fC, at or above the %.0fC throttle point; not learning from this run\n",
+                   thermal_model_temperature(), thermal_model_throttle());
+        } else if (!gov->cached_stats) {
+            model_estimator_observe(config, stats);
+            layer_model_observe(config, stats);
+        }
+    }
     pid_governor_maybe_update_best(gov, config, stats, *estimated_power);
     
     if (gov->iteration > gov->max_iterations) {
@@ -737,45 +1274,65 @@ PIDResult pid_governor_step(PIDGovernor *gov, PipelineConfig *config,
         }
         return PID_MAX_ITERATIONS;
     }
+
+    if (gov->power_cap > 0.0) return pid_capped_step(gov, config, stats, estimated_power);
+
+    // The latency the targets hold: a quantile of the frames if one is set.
+    const double latency = slo_latency(stats);
     
+    // An order change is a model prediction; go back if the measurement disagrees.
+    if (gov->order_trial) {
+        gov->order_trial = false;
+        if (pid_governor_constraint_violation(gov, stats) > gov->order_trial_violation + 1e-9) {
+            printf("[PID] Order: %s measured fps=%.2f latency=%.2fms, worse than %s; going back\n",
+                   config->order, stats->fps, latency, gov->order_trial_from.order);
+            *config = gov->order_trial_from;
+            *estimated_power = estimate_power(config);
+            return PID_CONTINUE;
+        }
+    }
+
     double fps_error = (gov->target_fps - stats->fps) / gov->target_fps;
-    double latency_error = (stats->latency - gov->target_latency) / gov->target_latency;
+    double latency_error = (latency - gov->target_latency) / gov->target_latency;
     
     bool latency_worsened = false;
-    if (gov->has_prev) latency_worsened = (stats->latency > gov->prev_latency + 1.0); // +1ms noise margin
-    gov->prev_latency = stats->latency;
+    if (gov->has_prev) latency_worsened = (latency > gov->prev_latency + 1.0); // +1ms noise margin
+    gov->prev_latency = latency;
     gov->prev_fps = stats->fps;
     gov->has_prev = true;
 
     double dt = 1.0;
     
     bool fps_met = stats->fps >= gov->target_fps;
-    bool latency_met = stats->latency <= gov->target_latency;
+    bool latency_met = latency <= gov->target_latency;
     
     printf("[PID] iter=%d fps=%.2f (target=%.2f, dev=%.4f) lat=%.2f (target=%.2f, dev=%.4f) pp1=%d pp2=%d\n",
            gov->iteration, stats->fps, gov->target_fps, fps_error,
-           stats->latency, gov->target_latency, latency_error,
+           latency, gov->target_latency, latency_error,
            config->partition_point1, config->partition_point2);
     
     if (fps_met && latency_met) {
         double margin_fps = stats->fps - gov->target_fps;
-        double margin_latency = gov->target_latency - stats->latency;
+        double margin_latency = gov->target_latency - latency;
         
         bool reduced = try_reduce_power(gov, config, stats, margin_fps, margin_latency);
+        if (!reduced) reduced = pid_try_thread_trade(gov, config, stats);
+        if (!reduced) reduced = pid_try_order_switch(gov, config, stats, true);
         
         if (!reduced) {
             gov->converged = true;
             *estimated_power = estimate_power(config);
             pid_governor_maybe_update_best(gov, config, stats, *estimated_power);
-            printf("[PID] Converged at iteration %d: big_freq=%d, little_freq=%d, pp1=%d, pp2=%d, power=%.3fW\n",
-                   gov->iteration, config->big_frequency, config->little_frequency,
-                   config->partition_point1, config->partition_point2, *estimated_power);
+            printf("[PID] Converged at iteration %d: big_freq=%d, little_freq=%d, gpu_freq=%d, threads=%d/%d, pp1=%d, pp2=%d, order=%s, power=%.3fW\n",
+                   gov->iteration, config->big_frequency, config->little_frequency, config->gpu_frequency,
+                   config->big_threads, config->little_threads,
+                   config->partition_point1, config->partition_point2, config->order, *estimated_power);
             return PID_CONVERGED;
         }
         
-        printf("[PID] Targets met, reducing power: big_freq=%d, little_freq=%d, pp1=%d, pp2=%d\n",
-               config->big_frequency, config->little_frequency,
-               config->partition_point1, config->partition_point2);
+        printf("[PID] Targets met, reducing power: big_freq=%d, little_freq=%d, gpu_freq=%d, threads=%d/%d, pp1=%d, pp2=%d, order=%s\n",
+               config->big_frequency, config->little_frequency, config->gpu_frequency, config->big_threads, config->little_threads,
+               config->partition_point1, config->partition_point2, config->order);
     } else {
         double fps_adjustment = 0.0;
         double latency_adjustment = 0.0;
@@ -785,9 +1342,45 @@ PIDResult pid_governor_step(PIDGovernor *gov, PipelineConfig *config,
         const bool big_at_max = (config->big_frequency >= max_big_freq);
         const bool little_at_max = (config->little_frequency >= max_little_freq);
         const bool both_at_max = (big_at_max && little_at_max);
+        const PipelineConfig before = *config;
         
         printf("  [PID] targets NOT met: fps_met=%s, latency_met=%s\n",
                fps_met ? "YES" : "NO", latency_met ? "YES" : "NO");
+
+        // A GPU slowed down for power goes back up first when its stage is the
+        // one behind or when the latency is short.
+        const int gpu_stage = pid_processor_stage(config, 'G');
+        const bool gpu_at_max = config->gpu_frequency >= GPU_MAX_FREQUENCY;
+        if (gpu_stage >= 0 && !gpu_at_max &&
+            (!latency_met || detect_bottleneck(stats, NULL) == (BottleneckStage)(BOTTLENECK_STAGE1_GPU + gpu_stage))) {
+            int raised = frequency_step(config->gpu_frequency, +1, GPU);
+            printf("  [PID] raising gpu freq %d -> %d\n", config->gpu_frequency, raised);
+            config->gpu_frequency = raised;
+        }
+
+        // Cores given up for power come back once the frequencies are spent.
+        bool cores_at_max = true;
+        if (both_at_max) {
+            if (pid_processor_stage(config, 'B') >= 0 && get_processor_threads(config, 'B') < MAX_BIG_THREADS) {
+                cores_at_max = false;
+                config->big_threads = MAX_BIG_THREADS;
+            }
+            if (pid_processor_stage(config, 'L') >= 0 && get_processor_threads(config, 'L') < MAX_LITTLE_THREADS) {
+                cores_at_max = false;
+                config->little_threads = MAX_LITTLE_THREADS;
+            }
+            if (!cores_at_max) {
+                printf("  [PID] both freqs at max, restoring threads=%d/%d\n", config->big_threads, config->little_threads);
+            }
+        }
+
+        // The frequencies are spent; a different order may still reach the targets.
+        if (both_at_max && cores_at_max && (gpu_at_max || gpu_stage < 0) &&
+            pid_try_order_switch(gov, config, stats, false)) {
+            enforce_no_single_layer_stages(config);
+            *estimated_power = estimate_power(config);
+            return PID_CONTINUE;
+        }
         
         if (!fps_met) {
             printf("  [PID-fps] computing adjustment (fps=%.2f < target=%.2f):\n", stats->fps, gov->target_fps);
@@ -804,7 +1397,7 @@ PIDResult pid_governor_step(PIDGovernor *gov, PipelineConfig *config,
         }
         
         if (!latency_met) {
-            printf("  [PID-lat] computing adjustment (lat=%.2f > target=%.2f):\n", stats->latency, gov->target_latency);
+            printf("  [PID-lat] computing adjustment (lat=%.2f > target=%.2f):\n", latency, gov->target_latency);
             if (both_at_max) {
                 printf("  [PID-lat] both freqs at max (big=%d, little=%d), skipping frequency increase\n",
                        config->big_frequency, config->little_frequency);
@@ -824,11 +1417,22 @@ PIDResult pid_governor_step(PIDGovernor *gov, PipelineConfig *config,
         }
         
         double fps_margin = stats->fps - gov->target_fps;
-        double latency_margin = gov->target_latency - stats->latency;
+        double latency_margin = gov->target_latency - latency;
         pid_governor_adjust_partition_points(gov, config, fps_margin, latency_margin, false, both_at_max);
+
+        // A raise no fan level can cool would only be throttled back.
+        if (!pid_thermal_safe(config) && pid_thermal_safe(&before)) {
+            printf("  [thermal] big_freq=%d little_freq=%d gpu_freq=%d would pass %.0fC at every fan level, holding the frequencies\n",
+                   config->big_frequency, config->little_frequency, config->gpu_frequency, thermal_model_throttle());
+            config->big_frequency = before.big_frequency;
+            config->little_frequency = before.little_frequency;
+            config->gpu_frequency = before.gpu_frequency;
+            config->big_threads = before.big_threads;
+            config->little_threads = before.little_threads;
+        }
         
-        printf("[PID] Adjusting: fps_steps=%.2f, lat_steps=%.2f -> big_freq=%d, little_freq=%d, pp1=%d, pp2=%d\n",
-               fps_adjustment, latency_adjustment, config->big_frequency, config->little_frequency,
+        printf("[PID] Adjusting: fps_steps=%.2f, lat_steps=%.2f -> big_freq=%d, little_freq=%d, gpu_freq=%d, pp1=%d, pp2=%d\n",
+               fps_adjustment, latency_adjustment, config->big_frequency, config->little_frequency, config->gpu_frequency,
                config->partition_point1, config->partition_point2);
     }
 
@@ -837,3 +1441,25 @@ PIDResult pid_governor_step(PIDGovernor *gov, PipelineConfig *config,
     *estimated_power = estimate_power(config);
     return PID_CONTINUE;
 }
+
+PIDResult pid_governor_run_step(PIDGovernor *gov, ExecutionBackend *backend,
+                                const char *graph, int n_frames, PipelineConfig *config,
+                                stats_t *stats, double *estimated_power) {
+    gov->cached_stats = measurement_cache_lookup(graph, config, stats) == 0;
+    if (gov->cached_stats) {
+        printf("[cache] big_freq=%d little_freq=%d gpu_freq=%d pp1=%d pp2=%d order=%s: fps=%.2f latency=%.2fms, not launching\n",
+               config->big_frequency, config->little_frequency, config->gpu_frequency,
+               config->partition_point1, config->partition_point2, config->order,
+               stats->fps, stats->latency);
+    } else {
+        if (execution_backend_measure(backend, config, graph, n_frames,
+                                      gov->target_fps, gov->target_latency, stats) != 0) {
+            return PID_BACKEND_ERROR;
+        }
+        measurement_cache_add(graph, config, stats);
+    }
+    // The zone keeps heating or cooling between launches, so the fan follows
+    // it on cache hits too.
+    execution_backend_thermal(backend, config);
+    return pid_governor_step(gov, config, stats, estimated_power);
+}
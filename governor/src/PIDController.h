@@ -4,8 +4,16 @@
 #include <stdbool.h>
 #include "PipelineConfig.h"
 #include "Governor.h"
+#include "ExecutionBackend.h"
 
 #define BOTTLENECK_RATIO_THRESHOLD 0.45
+#define PID_HISTORY_SIZE 64
+#define PID_ORDER_MAX_SWITCHES 2        // order changes per search
+#define PID_ORDER_MIN_SAVING 0.03       // relative power an order change must save
+#define PID_ORDER_MODEL_MARGIN 0.05     // predicted fps/latency headroom a new order must keep
+#define PID_THREAD_MAX_TRADES 2         // thread-for-frequency trades per search
+#define PID_THREAD_MIN_SAVING 0.03      // relative power a trade must save
+#define PID_CAP_MIN_GAIN 0.01           // relative fps a capped step must be predicted to add
 
 typedef enum {
     BOTTLENECK_NONE,
@@ -26,11 +34,20 @@ typedef struct {
     double output_max;
 } PIDState;
 
+// One measured configuration, kept so a change of targets can be answered
+// from what has already been run.
+typedef struct {
+    PipelineConfig config;
+    stats_t stats;
+    double estimated_power;
+} PIDMeasurement;
+
 typedef struct {
     PIDState fps_pid;
     PIDState latency_pid;
     double target_fps;
     double target_latency;
+    double power_cap;             // W; > 0 maximises fps under it instead (--power-cap)
     double prev_latency;
     double prev_fps;
     bool has_prev;
@@ -40,14 +57,25 @@ typedef struct {
     bool converged;
     int total_layers;
     int partition_step_cooldown;
+    int order_switches;
+    int thread_trades;
+    bool order_trial;             // the last step switched order; the next measurement decides
+    PipelineConfig order_trial_from;
+    double order_trial_violation;
     PipelineConfig last_config;
     bool has_last_config;
     int same_config_streak;
     PipelineConfig best_config;
     double best_estimated_power;
+    double best_measured_power;   // from the power sensor, 0 = not measured
+    double best_fps;              // measured, for objective_cost
     double best_violation;
     bool best_valid;
     bool best_meets_targets;
+    PIDMeasurement history[PID_HISTORY_SIZE];
+    int history_len;
+    int history_next;
+    bool cached_stats;            // the next step's stats come from the cache; the models have seen them
 } PIDGovernor;
 
 void pid_init(PIDState *pid, double Kp, double Ki, double Kd, 
@@ -62,18 +90,44 @@ void pid_governor_init(PIDGovernor *gov, double target_fps, double target_latenc
 
 void pid_governor_reset_best(PIDGovernor *gov);
 
+// Starts a new search from the current configuration, e.g. when a converged
+// configuration stops meeting the targets; targets and gains are kept.
+void pid_governor_rearm(PIDGovernor *gov);
+
+// New targets at runtime: re-arms the search and re-ranks the measured
+// configurations against the new targets. *config becomes the best of them,
+// or is left alone if nothing has been measured yet.
+void pid_governor_retarget(PIDGovernor *gov, double target_fps, double target_latency,
+                           PipelineConfig *config);
+
+// Warm start: a configuration measured in an earlier session enters the
+// history and competes for best_config like one measured in this session.
+void pid_governor_seed(PIDGovernor *gov, const PipelineConfig *config, const stats_t *stats,
+                       double estimated_power);
+
+// The stats measured for config in this session; false if it was not measured.
+bool pid_governor_find_measurement(const PIDGovernor *gov, const PipelineConfig *config, stats_t *stats);
+
 bool pid_governor_get_best(const PIDGovernor *gov, PipelineConfig *out_config,
                            double *out_estimated_power, bool *out_meets_targets);
 
 typedef enum {
     PID_CONTINUE,
     PID_CONVERGED,
-    PID_MAX_ITERATIONS
+    PID_MAX_ITERATIONS,
+    PID_BACKEND_ERROR
 } PIDResult;
 
+// With gov->power_cap set, a step climbs towards the highest fps whose power
+// stays under the cap and whose latency meets the target, instead of cutting
+// power at fixed targets; target_fps is then only a floor for meets_targets.
 PIDResult pid_governor_step(PIDGovernor *gov, PipelineConfig *config, 
                             stats_t *stats, double *estimated_power);
 
+PIDResult pid_governor_run_step(PIDGovernor *gov, ExecutionBackend *backend,
+                                const char *graph, int n_frames, PipelineConfig *config,
+                                stats_t *stats, double *estimated_power);
+
 void pid_governor_apply_frequency_adjustment(PIDGovernor *gov, 
                                              PipelineConfig *config,
                                              double fps_adjustment,
@@ -11,21 +11,8 @@
 
 const int LITTLE_FREQUENCY_TABLE[]={500000, 667000, 1000000, 1200000, 1398000, 1512000, 1608000, 1704000, 1800000};
 const int BIG_FREQUENCY_TABLE[]={500000, 667000, 1000000, 1200000, 1398000, 1512000, 1608000, 1704000, 1800000, 1908000, 2016000, 2100000, 2208000};
-
-
-void run_inference(PipelineConfig *config, char *graph, int n_frames){
-    
-    char command[256];
-    sprintf(command, "./set_freq.sh little %d", config->little_frequency);
-    system(command);
-    sprintf(command, "./set_freq.sh big %d", config->big_frequency);
-    system(command);
-
-    sprintf(command, "./run_inference.sh %s %d %d %d %s > output.txt 2>&1",
-        graph, n_frames, config->partition_point1, config->partition_point2, config->order);
-    system(command);
-
-}
+// Mali-G52 OPPs of the G12B device tree, rounded to kHz (the kernel lists them as 124999998 Hz etc.).
+const int GPU_FREQUENCY_TABLE[]={125000, 250000, 285714, 400000, 500000, 666667, 800000};
 
 
 void print_pipe_line_config(PipelineConfig *config){
@@ -34,6 +21,9 @@ void print_pipe_line_config(PipelineConfig *config){
     printf("Big Frequency: %d\n", config->big_frequency);
     printf("Little Frequency: %d\n", config->little_frequency);
     printf("Order: %s\n", config->order);
+    printf("GPU Frequency: %d\n", config->gpu_frequency);
+    printf("Threads: %d big, %d little (affinity 0x%x)\n",
+           get_processor_threads(config, 'B'), get_processor_threads(config, 'L'), get_affinity_mask(config));
 }
 
 
@@ -88,6 +78,8 @@ int set_frequency(PipelineConfig *config, int freq, processor cpu) {
         config->big_frequency = freq;
     else if (cpu == LITTLE_CPU)
         config->little_frequency = freq;
+    else if (cpu == GPU)
+        config->gpu_frequency = freq;
 
     return validate_frequency(freq, cpu);
 }
@@ -105,6 +97,11 @@ void increment_frequency(PipelineConfig *config, int freq, processor cpu){
             if (freq == LITTLE_FREQUENCY_TABLE[i])
                 config->little_frequency = LITTLE_FREQUENCY_TABLE[i+1];
         }
+    } else if (cpu == GPU) {
+        for(int i = 0; i < NUM_GPU_FREQUENCIES-1; i++) {
+            if (freq == GPU_FREQUENCY_TABLE[i])
+                config->gpu_frequency = GPU_FREQUENCY_TABLE[i+1];
+        }
     }
 }
 
@@ -121,6 +118,11 @@ void decrement_frequency(PipelineConfig *config, int freq, processor cpu){
             if (freq == LITTLE_FREQUENCY_TABLE[i])
                 config->little_frequency = LITTLE_FREQUENCY_TABLE[i-1];
         }
+    } else if (cpu == GPU){
+        for(int i=1; i < NUM_GPU_FREQUENCIES; i++) {
+            if (freq == GPU_FREQUENCY_TABLE[i])
+                config->gpu_frequency = GPU_FREQUENCY_TABLE[i-1];
+        }
     }
 }
 
@@ -136,10 +138,21 @@ bool validate_frequency(int freq, processor cpu){
             if (freq == LITTLE_FREQUENCY_TABLE[i])
                 return true;
         }
+    } else if (cpu == GPU) {
+        for (int i = 0; i < NUM_GPU_FREQUENCIES; i++){
+            if (freq == GPU_FREQUENCY_TABLE[i])
+                return true;
+        }
     }
     return false;
 }
 
+int get_processor_frequency(const PipelineConfig *config, char processor_code) {
+    if (processor_code == 'B') return config->big_frequency;
+    if (processor_code == 'L') return config->little_frequency;
+    return config->gpu_frequency;
+}
+
 void enforce_no_single_layer_stages(PipelineConfig *config) {
 
     if (!config) return;
@@ -224,4 +237,21 @@ void calc_partition_sizes(PipelineConfig *config, int total_parts, int *out_g, i
             *out_b = third_stage;
         }
     }
-}
\ No newline at end of file
+}
+
+int get_processor_threads(const PipelineConfig *config, char processor_code) {
+    if (processor_code == 'B') {
+        return (config->big_threads >= 1 && config->big_threads <= MAX_BIG_THREADS) ? config->big_threads : MAX_BIG_THREADS;
+    }
+    if (processor_code == 'L') {
+        return (config->little_threads >= 1 && config->little_threads <= MAX_LITTLE_THREADS) ?
+               config->little_threads : MAX_LITTLE_THREADS;
+    }
+    return 0;
+}
+
+unsigned int get_affinity_mask(const PipelineConfig *config) {
+    const unsigned int little = (1u << get_processor_threads(config, 'L')) - 1;
+    const unsigned int big = (1u << get_processor_threads(config, 'B')) - 1;
+    return (little << LITTLE_FIRST_CORE) | (big << BIG_FIRST_CORE);
+}
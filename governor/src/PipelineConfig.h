@@ -8,6 +8,16 @@
 
 #define NUM_BIG_FREQUENCIES 13
 #define NUM_LITTLE_FREQUENCIES 9
+#define NUM_GPU_FREQUENCIES 7
+#define GPU_MAX_FREQUENCY 800000
+
+// A311D: cores 0-1 are the little A53s, cores 2-5 the big A73s.
+#define MAX_LITTLE_THREADS 2
+#define MAX_BIG_THREADS 4
+#define LITTLE_FIRST_CORE 0
+#define BIG_FIRST_CORE 2
+#define NUM_CORES 6
+#define ALL_CORES_MASK ((1u << NUM_CORES) - 1)
 
 #define TOTAL_LAYERS 8
 
@@ -19,6 +29,7 @@ typedef enum {
 
 extern const int LITTLE_FREQUENCY_TABLE[];
 extern const int BIG_FREQUENCY_TABLE[];
+extern const int GPU_FREQUENCY_TABLE[];
 
 typedef struct PipelineConfig {
     int partition_point1;
@@ -26,10 +37,11 @@ typedef struct PipelineConfig {
     int big_frequency;
     int little_frequency;
     char order[6];
+    int gpu_frequency;           // devfreq OPP of the Mali, in kHz like the CPUs
+    int big_threads;             // --threads, pinned to the first big cores
+    int little_threads;          // --threads2, pinned to the first little cores
 } PipelineConfig;
 
-void run_inference(PipelineConfig *config, char *graph, int n_frames);
-
 void print_pipe_line_config(PipelineConfig *config);
 
 int set_partition_point1(PipelineConfig *config, int partition_point);
@@ -48,6 +60,36 @@ void decrement_frequency(PipelineConfig *config, int freq, processor cpu);
 
 bool validate_frequency(int freq, processor cpu);
 
+// devfreq takes Hz and floors them to an OPP; the table rounds the OPPs to
+// kHz (285714 for 285714281 Hz), so the request goes just above.
+static inline int gpu_devfreq_hz(int khz) {
+    return khz * 1000 + 999;
+}
+
+// devfreq reads back the Hz it clamped to; whole MHz tell the OPPs apart.
+static inline int gpu_devfreq_mhz(int hz) {
+    return (hz + 500000) / 1000000;
+}
+
+// Threads of a CPU cluster ('B' or 'L'); 0 means the graph default, all cores.
+int get_processor_threads(const PipelineConfig *config, char processor_code);
+
+// Cores the graph may run on: the first big_threads big and the first
+// little_threads little cores.
+unsigned int get_affinity_mask(const PipelineConfig *config);
+
+// Cores that can be taken offline: all but the first of each cluster, which
+// hold the cpufreq policies (cpu0 cannot be unplugged at all).
+static inline bool is_parkable_core(int cpu) {
+    return cpu != LITTLE_FIRST_CORE && cpu != BIG_FIRST_CORE && cpu < NUM_CORES;
+}
+
+// Frequency in kHz of the processor behind an order code ('G', 'B' or 'L').
+int get_processor_frequency(const PipelineConfig *config, char processor_code);
+
 void enforce_no_single_layer_stages(PipelineConfig *config);
 
+// Layers on the GPU, the big and the little cluster, whatever stage each runs.
+void calc_partition_sizes(PipelineConfig *config, int total_parts, int *out_g, int *out_b, int *out_l);
+
 #endif
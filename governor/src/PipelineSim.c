@@ -0,0 +1,162 @@
+#include "PipelineSim.h"
+#include "ApproximationModels.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+
+void pipeline_sim_default_params(PipelineSimParams *params) {
+    memset(params, 0, sizeof(*params));
+    params->queue_capacity = 1;
+    params->jitter_cv = 0.0;
+    params->n_frames = 200;
+    params->warmup_frames = 20;
+    params->seed = 1;
+}
+
+
+static double pipeline_sim_gaussian(unsigned long long *state) {
+    double u[2];
+    for (int k = 0; k < 2; k++) {
+        *state ^= *state >> 12;
+        *state ^= *state << 25;
+        *state ^= *state >> 27;
+        u[k] = (((*state * 0x2545F4914F6CDD1DULL) >> 11) + 0.5) / 9007199254740992.0;
+    }
+    return sqrt(-2.0 * log(u[0])) * cos(2.0 * M_PI * u[1]);
+}
+
+static int pipeline_sim_cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+
+int pipeline_sim_run(const PipelineSimParams *params, PipelineSimResult *result) {
+    static double depart[PIPELINE_SIM_MAX_FRAMES][PIPELINE_SIM_STAGES];
+    static double latency[PIPELINE_SIM_MAX_FRAMES];
+
+    memset(result, 0, sizeof(*result));
+    result->bottleneck_stage = -1;
+
+    int n = params->n_frames;
+    if (n < 2) n = 2;
+    if (n > PIPELINE_SIM_MAX_FRAMES) n = PIPELINE_SIM_MAX_FRAMES;
+    int warmup = params->warmup_frames;
+    if (warmup < 0) warmup = 0;
+    if (warmup > n - 2) warmup = n - 2;
+    const int q = params->queue_capacity < 0 ? 0 : params->queue_capacity;
+
+    unsigned long long rng = params->seed ? params->seed : 1;
+    double busy[PIPELINE_SIM_STAGES] = {0.0, 0.0, 0.0};
+
+    for (int i = 0; i < n; i++) {
+        double entered = 0.0;
+
+        for (int s = 0; s < PIPELINE_SIM_STAGES; s++) {
+            double service = params->service_ms[s];
+            if (service > 0.0 && params->jitter_cv > 0.0) {
+                double factor = 1.0 + params->jitter_cv * pipeline_sim_gaussian(&rng);
+                service *= factor < 0.05 ? 0.05 : factor;
+            }
+
+            // The input source is saturated: frame i enters stage 1 as soon as frame i-1 left it.
+            double arrival = (s == 0) ? 0.0 : depart[i][s - 1];
+            double stage_free = (i > 0) ? depart[i - 1][s] : 0.0;
+            double begin = fmax(arrival, stage_free);
+            if (s == 0) entered = begin;
+
+            double work = params->transfer_ms[s] + service;
+            double done = begin + work;
+            busy[s] += work;
+
+            // Blocking after service: the frame only leaves once the queue in
+            // front of the next stage has room, i.e. frame i-q-1 has left that stage.
+            if (s < PIPELINE_SIM_STAGES - 1 && i - q - 1 >= 0) {
+                done = fmax(done, depart[i - q - 1][s + 1]);
+            }
+            depart[i][s] = done;
+        }
+
+        latency[i] = depart[i][PIPELINE_SIM_STAGES - 1] - entered;
+    }
+
+    const double span = depart[n - 1][PIPELINE_SIM_STAGES - 1] - depart[warmup][PIPELINE_SIM_STAGES - 1];
+    const int measured = n - warmup - 1;
+    if (span > 0.0) {
+        result->fps = 1000.0 * measured / span;
+    } else if (depart[n - 1][PIPELINE_SIM_STAGES - 1] > 0.0) {
+        result->fps = 1000.0 * n / depart[n - 1][PIPELINE_SIM_STAGES - 1];
+    }
+
+    const int m = n - warmup;
+    double sum = 0.0;
+    for (int i = warmup; i < n; i++) sum += latency[i];
+    result->mean_latency = sum / m;
+
+    qsort(&latency[warmup], (size_t)m, sizeof(double), pipeline_sim_cmp_double);
+    result->p50_latency = latency[warmup + (m - 1) / 2];
+    int p99_idx = (int)ceil(0.99 * m) - 1;
+    if (p99_idx < 0) p99_idx = 0;
+    result->p99_latency = latency[warmup + p99_idx];
+    result->max_latency = latency[n - 1];
+
+    const double total = depart[n - 1][PIPELINE_SIM_STAGES - 1];
+    double max_util = 0.0;
+    for (int s = 0; s < PIPELINE_SIM_STAGES; s++) {
+        result->utilization[s] = (total > 0.0) ? busy[s] / total : 0.0;
+        if (params->service_ms[s] > 0.0 && result->utilization[s] > max_util) {
+            max_util = result->utilization[s];
+            result->bottleneck_stage = s;
+        }
+    }
+    return 0;
+}
+
+
+static double pipeline_transfer_cost(const PipelineConfig *config, int stage) {
+    if (stage == 0) return 0.0;
+    char from = config->order[2 * (stage - 1)];
+    char to = config->order[2 * stage];
+    return (from == 'G' || to == 'G') ? PIPELINE_TRANSFER_GPU_MS : PIPELINE_TRANSFER_CPU_MS;
+}
+
+void pipeline_sim_params_from_config(const PipelineConfig *config, PipelineSimParams *params) {
+    pipeline_sim_default_params(params);
+    estimate_stage_times(config, params->service_ms);
+
+    // Stages without layers pass the tensor straight through.
+    for (int s = 0; s < PIPELINE_SIM_STAGES; s++) {
+        params->transfer_ms[s] = params->service_ms[s] > 0.0 ? pipeline_transfer_cost(config, s) : 0.0;
+    }
+}
+
+void pipeline_sim_params_from_stats(const PipelineConfig *config, const stats_t *stats, PipelineSimParams *params) {
+    const double measured_input[PIPELINE_SIM_STAGES] = {
+        stats->stage1_input_time, stats->stage2_input_time, stats->stage3_input_time
+    };
+
+    pipeline_sim_default_params(params);
+    params->service_ms[0] = stats->stage1_inference_time;
+    params->service_ms[1] = stats->stage2_inference_time;
+    params->service_ms[2] = stats->stage3_inference_time;
+
+    // stageN_input_time also contains the wait for the upstream stage, which the
+    // simulation models itself; it is only trusted when it looks like a plain copy.
+    for (int s = 0; s < PIPELINE_SIM_STAGES; s++) {
+        if (params->service_ms[s] <= 0.0) continue;
+        double model = pipeline_transfer_cost(config, s);
+        params->transfer_ms[s] = (measured_input[s] > 0.0) ? fmin(measured_input[s], model) : model;
+    }
+}
+
+int pipeline_sim_predict(const PipelineConfig *config, PipelineSimResult *result) {
+    PipelineSimParams params;
+    pipeline_sim_params_from_config(config, &params);
+    // Without jitter the pipeline is periodic after a few frames.
+    params.n_frames = 32;
+    params.warmup_frames = 8;
+    return pipeline_sim_run(&params, result);
+}
@@ -0,0 +1,51 @@
+#ifndef PIPELINESIM_H
+#define PIPELINESIM_H
+
+#include <stdbool.h>
+
+#include "PipelineConfig.h"
+#include "Governor.h"
+
+#define PIPELINE_SIM_MAX_FRAMES 1024
+#define PIPELINE_SIM_STAGES 3
+
+// Copy cost of the activation tensor into a stage, by where it comes from.
+#define PIPELINE_TRANSFER_GPU_MS 0.9
+#define PIPELINE_TRANSFER_CPU_MS 0.3
+
+typedef struct {
+    double service_ms[PIPELINE_SIM_STAGES];   // inference time per frame, 0 for an empty stage
+    double transfer_ms[PIPELINE_SIM_STAGES];  // input copy before the stage starts
+    int queue_capacity;                       // frames buffered between two stages
+    double jitter_cv;                         // relative per-frame spread of the service times
+    int n_frames;
+    int warmup_frames;
+    unsigned long long seed;
+} PipelineSimParams;
+
+typedef struct {
+    double fps;
+    double mean_latency;
+    double p50_latency;
+    double p99_latency;
+    double max_latency;
+    double utilization[PIPELINE_SIM_STAGES];
+    int bottleneck_stage;                     // 0-based, -1 when all stages are empty
+} PipelineSimResult;
+
+// Frame-level discrete-event simulation of the three-stage pipeline with
+// blocking-after-service between finite inter-stage queues.
+void pipeline_sim_default_params(PipelineSimParams *params);
+
+int pipeline_sim_run(const PipelineSimParams *params, PipelineSimResult *result);
+
+// Service times from the approximation models, transfer costs from the order.
+void pipeline_sim_params_from_config(const PipelineConfig *config, PipelineSimParams *params);
+
+// Service times from a measured run (stageN_inference_time).
+void pipeline_sim_params_from_stats(const PipelineConfig *config, const stats_t *stats, PipelineSimParams *params);
+
+// Noise-free prediction for screening candidate configurations.
+int pipeline_sim_predict(const PipelineConfig *config, PipelineSimResult *result);
+
+#endif
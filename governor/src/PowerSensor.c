@@ -0,0 +1,202 @@
+#include "PowerSensor.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+
+static const char *POWER_SENSOR_KIND_NAMES[] = {"none", "hwmon", "log", "fifo"};
+
+// Log samples carry wall-clock time, so everything here does too.
+static double power_sensor_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int power_sensor_read_node(const PowerSensor *sensor, const char *node, double *value) {
+    char path[300];
+    snprintf(path, sizeof(path), "%s/%s", sensor->path, node);
+
+    FILE *fp = fopen(path, "r");
+    if (!fp) return -1;
+    int ok = fscanf(fp, "%lf", value) == 1;
+    fclose(fp);
+    return ok ? 0 : -1;
+}
+
+// Counter in J or power in W, whichever the node has.
+static int power_sensor_read_hwmon(const PowerSensor *sensor, double *value) {
+    if (power_sensor_read_node(sensor, sensor->counter ? "energy1_input" : "power1_input", value) != 0) return -1;
+    *value /= 1e6;
+    return 0;
+}
+
+static void power_sensor_add_line(PowerSensor *sensor, const char *line) {
+    double t, w;
+    if (sscanf(line, "%lf%*[ \t,]%lf", &t, &w) != 2 || w < 0.0) return;
+
+    sensor->sample_time[sensor->next_sample] = t;
+    sensor->sample_watts[sensor->next_sample] = w;
+    sensor->next_sample = (sensor->next_sample + 1) % POWER_SENSOR_SAMPLES;
+    if (sensor->n_samples < POWER_SENSOR_SAMPLES) sensor->n_samples++;
+}
+
+// Takes in every complete line written since the last call, without blocking.
+static void power_sensor_drain(PowerSensor *sensor) {
+    char buf[1024];
+    ssize_t n;
+
+    while ((n = read(sensor->fd, buf, sizeof(buf))) > 0) {
+        for (ssize_t i = 0; i < n; i++) {
+            if (buf[i] == '\n' || sensor->pending_len == sizeof(sensor->pending) - 1) {
+                sensor->pending[sensor->pending_len] = '\0';
+                if (sensor->pending_len > 0) power_sensor_add_line(sensor, sensor->pending);
+                sensor->pending_len = 0;
+                if (buf[i] == '\n') continue;
+            }
+            sensor->pending[sensor->pending_len++] = buf[i];
+        }
+    }
+}
+
+
+int power_sensor_open(PowerSensor *sensor, const char *spec) {
+    memset(sensor, 0, sizeof(*sensor));
+    sensor->fd = -1;
+    sensor->keepalive_fd = -1;
+
+    const char *colon = strchr(spec, ':');
+    if (!colon || colon[1] == '\0') {
+        fprintf(stderr, "power_sensor_open: expected hwmon:<dir>, log:<file> or fifo:<path>, got '%s'\n", spec);
+        return -1;
+    }
+    snprintf(sensor->path, sizeof(sensor->path), "%s", colon + 1);
+
+    const size_t len = colon - spec;
+    if (len == 5 && strncmp(spec, "hwmon", len) == 0) {
+        double value;
+        sensor->kind = POWER_SENSOR_HWMON;
+        sensor->counter = power_sensor_read_node(sensor, "energy1_input", &value) == 0;
+        if (!sensor->counter && power_sensor_read_node(sensor, "power1_input", &value) != 0) {
+            fprintf(stderr, "power_sensor_open: %s has neither energy1_input nor power1_input\n", sensor->path);
+            return -1;
+        }
+    } else if (len == 3 && strncmp(spec, "log", len) == 0) {
+        sensor->kind = POWER_SENSOR_LOG;
+        sensor->fd = open(sensor->path, O_RDONLY | O_NONBLOCK);
+        if (sensor->fd < 0) {
+            fprintf(stderr, "power_sensor_open: cannot open %s: %s\n", sensor->path, strerror(errno));
+            return -1;
+        }
+        // Only what the logger writes from now on belongs to this session.
+        lseek(sensor->fd, 0, SEEK_END);
+    } else if (len == 4 && strncmp(spec, "fifo", len) == 0) {
+        sensor->kind = POWER_SENSOR_FIFO;
+        if (mkfifo(sensor->path, 0600) != 0 && errno != EEXIST) {
+            fprintf(stderr, "power_sensor_open: cannot create %s: %s\n", sensor->path, strerror(errno));
+            return -1;
+        }
+        struct stat st;
+        if (stat(sensor->path, &st) != 0 || !S_ISFIFO(st.st_mode)) {
+            fprintf(stderr, "power_sensor_open: %s exists and is not a FIFO\n", sensor->path);
+            return -1;
+        }
+        sensor->fd = open(sensor->path, O_RDONLY | O_NONBLOCK);
+        if (sensor->fd < 0) {
+            fprintf(stderr, "power_sensor_open: cannot open %s: %s\n", sensor->path, strerror(errno));
+            return -1;
+        }
+        sensor->keepalive_fd = open(sensor->path, O_WRONLY | O_NONBLOCK);
+    } else {
+        fprintf(stderr, "power_sensor_open: unknown power sensor '%.*s'\n", (int)len, spec);
+        return -1;
+    }
+
+    printf("[power] %s %s%s\n", POWER_SENSOR_KIND_NAMES[sensor->kind], sensor->path,
+           sensor->kind != POWER_SENSOR_HWMON ? "" :
+           sensor->counter ? " (energy1_input)" : " (power1_input, read at both ends of a run)");
+    return 0;
+}
+
+bool power_sensor_enabled(const PowerSensor *sensor) {
+    return sensor && sensor->kind != POWER_SENSOR_NONE;
+}
+
+void power_sensor_begin(PowerSensor *sensor) {
+    if (!power_sensor_enabled(sensor)) return;
+
+    if (sensor->kind == POWER_SENSOR_HWMON) {
+        if (power_sensor_read_hwmon(sensor, &sensor->begin_value) != 0) sensor->begin_value = -1.0;
+    } else {
+        power_sensor_drain(sensor);
+    }
+    sensor->begin_time = power_sensor_now();
+}
+
+int power_sensor_end(PowerSensor *sensor, double span, double *watts) {
+    if (!power_sensor_enabled(sensor)) return -1;
+
+    const double now = power_sensor_now();
+    double from = sensor->begin_time;
+    double mean = -1.0;
+
+    if (sensor->kind == POWER_SENSOR_HWMON) {
+        // Short relaunched runs are mostly graph setup, which would then
+        // outrank the model as a measurement of the frames.
+        if (span > 0.0 && span < POWER_SENSOR_MIN_TIMED * (now - from)) {
+            sensor->setup_bound++;
+            return -1;
+        }
+        double value;
+        if (sensor->begin_value >= 0.0 && power_sensor_read_hwmon(sensor, &value) == 0 && now > from) {
+            // A counter that went backwards wrapped or was reset; drop the run.
+            if (!sensor->counter) mean = (sensor->begin_value + value) / 2.0;
+            else if (value >= sensor->begin_value) mean = (value - sensor->begin_value) / (now - from);
+        }
+    } else {
+        power_sensor_drain(sensor);
+        if (span > 0.0 && now - span > from) from = now - span;
+
+        double sum = 0.0;
+        int n = 0;
+        for (int i = 0; i < sensor->n_samples; i++) {
+            if (sensor->sample_time[i] < from || sensor->sample_time[i] > now) continue;
+            sum += sensor->sample_watts[i];
+            n++;
+        }
+        if (n > 0) mean = sum / n;
+    }
+
+    if (mean < 0.0) {
+        sensor->unmeasured++;
+        return -1;
+    }
+    sensor->runs++;
+    sensor->joules += mean * (now - from);
+    sensor->seconds += now - from;
+    *watts = mean;
+    return 0;
+}
+
+void power_sensor_report(const PowerSensor *sensor) {
+    if (!power_sensor_enabled(sensor)) return;
+    printf("[power] %s %s: %d runs measured, %d without readings", POWER_SENSOR_KIND_NAMES[sensor->kind],
+           sensor->path, sensor->runs, sensor->unmeasured);
+    if (sensor->setup_bound > 0) printf(", %d mostly graph setup", sensor->setup_bound);
+    if (sensor->seconds > 0.0) printf(", %.2f W over %.1f s", sensor->joules / sensor->seconds, sensor->seconds);
+    printf("\n");
+}
+
+void power_sensor_close(PowerSensor *sensor) {
+    if (!power_sensor_enabled(sensor)) return;
+    if (sensor->fd >= 0) close(sensor->fd);
+    if (sensor->keepalive_fd >= 0) close(sensor->keepalive_fd);
+    sensor->fd = -1;
+    sensor->keepalive_fd = -1;
+    sensor->kind = POWER_SENSOR_NONE;
+}
@@ -0,0 +1,66 @@
+#ifndef POWERSENSOR_H
+#define POWERSENSOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define POWER_SENSOR_LINE_MAX 128
+#define POWER_SENSOR_SAMPLES 4096       // about 7 minutes of a 10 Hz meter
+#define POWER_SENSOR_MIN_TIMED 0.8      // share of a hwmon reading the timed frames must fill
+
+typedef enum {
+    POWER_SENSOR_NONE,
+    POWER_SENSOR_HWMON,
+    POWER_SENSOR_LOG,
+    POWER_SENSOR_FIFO
+} PowerSensorKind;
+
+// Board power read on the machine the governor runs on, while the pipeline
+// runs. The spec picks the source:
+//   hwmon:<dir>   an INA2xx (or any hwmon) node: energy1_input in uJ where the
+//                 driver has it, otherwise power1_input in uW
+//   log:<file>    a text log a USB meter logger appends to
+//   fifo:<path>   the same lines written into a named pipe
+// Log and pipe lines are "<unix time> <watts>", separated by blanks or a
+// comma; lines that do not start that way are skipped.
+typedef struct {
+    PowerSensorKind kind;
+    char path[256];
+    int fd;
+    int keepalive_fd;             // fifo: our own writer, as in ControlChannel
+    bool counter;                 // hwmon: energy1_input rather than power1_input
+    char pending[POWER_SENSOR_LINE_MAX];
+    size_t pending_len;
+    double sample_time[POWER_SENSOR_SAMPLES];
+    double sample_watts[POWER_SENSOR_SAMPLES];
+    int n_samples;
+    int next_sample;
+    double begin_time;
+    double begin_value;           // hwmon: the counter in J or the power in W at begin
+    int runs;
+    int unmeasured;
+    int setup_bound;              // hwmon readings dropped as mostly graph setup
+    double joules;
+    double seconds;
+} PowerSensor;
+
+int power_sensor_open(PowerSensor *sensor, const char *spec);
+
+bool power_sensor_enabled(const PowerSensor *sensor);
+
+// Marks the start of a run.
+void power_sensor_begin(PowerSensor *sensor);
+
+// Mean power since power_sensor_begin. Log and pipe samples are taken from the
+// last span seconds only when span > 0, which leaves out graph setup. A hwmon
+// node can only be read at both ends of the run, so with span > 0 its reading
+// is dropped unless the span fills POWER_SENSOR_MIN_TIMED of it; a bare
+// power1_input only holds under a live graph anyway. Returns -1 if the run got
+// no reading.
+int power_sensor_end(PowerSensor *sensor, double span, double *watts);
+
+void power_sensor_report(const PowerSensor *sensor);
+
+void power_sensor_close(PowerSensor *sensor);
+
+#endif
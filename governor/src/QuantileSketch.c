@@ -0,0 +1,89 @@
+#include "QuantileSketch.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+
+static int sketch_cmp_double(const void *a, const void *b) {
+    const double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double sketch_parabolic(const QuantileSketch *s, int i, double d) {
+    const double *n = s->position, *h = s->height;
+    return h[i] + d / (n[i + 1] - n[i - 1]) *
+           ((n[i] - n[i - 1] + d) * (h[i + 1] - h[i]) / (n[i + 1] - n[i]) +
+            (n[i + 1] - n[i] - d) * (h[i] - h[i - 1]) / (n[i] - n[i - 1]));
+}
+
+static double sketch_linear(const QuantileSketch *s, int i, int d) {
+    return s->height[i] + d * (s->height[i + d] - s->height[i]) / (s->position[i + d] - s->position[i]);
+}
+
+
+void quantile_sketch_init(QuantileSketch *sketch, double q) {
+    memset(sketch, 0, sizeof(*sketch));
+    sketch->q = q;
+
+    const double desired[QUANTILE_SKETCH_MARKERS] = {1.0, 1.0 + 2.0 * q, 1.0 + 4.0 * q, 3.0 + 2.0 * q, 5.0};
+    const double increment[QUANTILE_SKETCH_MARKERS] = {0.0, q / 2.0, q, (1.0 + q) / 2.0, 1.0};
+    for (int i = 0; i < QUANTILE_SKETCH_MARKERS; i++) {
+        sketch->position[i] = i + 1;
+        sketch->desired[i] = desired[i];
+        sketch->increment[i] = increment[i];
+    }
+}
+
+void quantile_sketch_add(QuantileSketch *sketch, double x) {
+    // The first five samples are the markers themselves.
+    if (sketch->count < QUANTILE_SKETCH_MARKERS) {
+        sketch->height[sketch->count++] = x;
+        if (sketch->count == QUANTILE_SKETCH_MARKERS) {
+            qsort(sketch->height, QUANTILE_SKETCH_MARKERS, sizeof(double), sketch_cmp_double);
+        }
+        return;
+    }
+
+    int k;
+    if (x < sketch->height[0]) {
+        sketch->height[0] = x;
+        k = 0;
+    } else if (x >= sketch->height[QUANTILE_SKETCH_MARKERS - 1]) {
+        sketch->height[QUANTILE_SKETCH_MARKERS - 1] = x;
+        k = QUANTILE_SKETCH_MARKERS - 2;
+    } else {
+        for (k = 0; k < QUANTILE_SKETCH_MARKERS - 2 && x >= sketch->height[k + 1]; k++) {}
+    }
+
+    for (int i = k + 1; i < QUANTILE_SKETCH_MARKERS; i++) sketch->position[i] += 1.0;
+    for (int i = 0; i < QUANTILE_SKETCH_MARKERS; i++) sketch->desired[i] += sketch->increment[i];
+    sketch->count++;
+
+    // Move the inner markers that drifted a rank or more from where they belong.
+    for (int i = 1; i < QUANTILE_SKETCH_MARKERS - 1; i++) {
+        const double off = sketch->desired[i] - sketch->position[i];
+        if ((off >= 1.0 && sketch->position[i + 1] - sketch->position[i] > 1.0) ||
+            (off <= -1.0 && sketch->position[i - 1] - sketch->position[i] < -1.0)) {
+            const int d = off > 0.0 ? 1 : -1;
+            const double h = sketch_parabolic(sketch, i, d);
+            sketch->height[i] = (sketch->height[i - 1] < h && h < sketch->height[i + 1]) ? h : sketch_linear(sketch, i, d);
+            sketch->position[i] += d;
+        }
+    }
+}
+
+double quantile_sketch_value(const QuantileSketch *sketch) {
+    if (sketch->count == 0) return 0.0;
+    if (sketch->count >= QUANTILE_SKETCH_MARKERS) return sketch->height[2];
+
+    double sorted[QUANTILE_SKETCH_MARKERS];
+    memcpy(sorted, sketch->height, sketch->count * sizeof(double));
+    qsort(sorted, sketch->count, sizeof(double), sketch_cmp_double);
+    int rank = (int)ceil(sketch->q * sketch->count) - 1;
+    if (rank < 0) rank = 0;
+    return sorted[rank];
+}
+
+int quantile_sketch_count(const QuantileSketch *sketch) {
+    return sketch->count;
+}
@@ -0,0 +1,29 @@
+#ifndef QUANTILESKETCH_H
+#define QUANTILESKETCH_H
+
+#define QUANTILE_SKETCH_MARKERS 5
+
+// One quantile of a stream in five markers (P², Jain and Chlamtac 1985), so a
+// run of any length costs the same as a handful of frames. The markers sit at
+// the minimum, q/2, q, (1+q)/2 and the maximum and are moved by piecewise-
+// parabolic interpolation as samples come in.
+typedef struct {
+    double q;
+    int count;
+    double height[QUANTILE_SKETCH_MARKERS];
+    double position[QUANTILE_SKETCH_MARKERS];   // 1-based ranks of the markers
+    double desired[QUANTILE_SKETCH_MARKERS];
+    double increment[QUANTILE_SKETCH_MARKERS];
+} QuantileSketch;
+
+void quantile_sketch_init(QuantileSketch *sketch, double q);
+
+void quantile_sketch_add(QuantileSketch *sketch, double x);
+
+// The estimate of the quantile; exact (nearest rank) under five samples, 0
+// without any.
+double quantile_sketch_value(const QuantileSketch *sketch);
+
+int quantile_sketch_count(const QuantileSketch *sketch);
+
+#endif
@@ -0,0 +1,547 @@
+#include "ReplaySimulator.h"
+#include "ApproximationModels.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <dirent.h>
+
+#define REPLAY_DEFAULT_CV 0.02
+#define REPLAY_MAX_AXIS 32
+
+
+static int replay_find_point(const ReplaySimulator *sim, int big, int little, int pp1, int pp2, const char *order) {
+    for (int i = 0; i < sim->n_points; i++) {
+        const ReplayPoint *p = &sim->points[i];
+        if (p->big_frequency == big && p->little_frequency == little &&
+            p->partition_point1 == pp1 && p->partition_point2 == pp2 &&
+            strcmp(p->order, order) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void replay_add_row(ReplaySimulator *sim, int *capacity, int big, int little, int pp1, int pp2,
+                           const char *order, double fps, double latency, double watts, bool has_watts) {
+    int idx = replay_find_point(sim, big, little, pp1, pp2, order);
+
+    if (idx < 0) {
+        if (sim->n_points == *capacity) {
+            *capacity = *capacity ? *capacity * 2 : 256;
+            sim->points = realloc(sim->points, (size_t)*capacity * sizeof(ReplayPoint));
+        }
+        idx = sim->n_points++;
+        ReplayPoint *p = &sim->points[idx];
+        memset(p, 0, sizeof(*p));
+        p->big_frequency = big;
+        p->little_frequency = little;
+        p->partition_point1 = pp1;
+        p->partition_point2 = pp2;
+        snprintf(p->order, sizeof(p->order), "%s", order);
+    }
+
+    // Welford update over the replicates of this point.
+    ReplayPoint *p = &sim->points[idx];
+    p->n++;
+    double d_fps = fps - p->fps;
+    p->fps += d_fps / p->n;
+    p->fps_m2 += d_fps * (fps - p->fps);
+    double d_lat = latency - p->latency;
+    p->latency += d_lat / p->n;
+    p->latency_m2 += d_lat * (latency - p->latency);
+
+    if (has_watts) {
+        p->n_watts++;
+        p->watts += (watts - p->watts) / p->n_watts;
+    }
+}
+
+static int replay_load_file(ReplaySimulator *sim, int *capacity, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+
+    char line[256];
+    int rows = 0;
+
+    while (fgets(line, sizeof(line), f)) {
+        int big, little, pp1, pp2;
+        char order[16];
+        double fps, latency, watts;
+
+        int n = sscanf(line, "%d,%d,%d,%d,%15[^,],%lf,%lf,%lf", &big, &little, &pp1, &pp2, order, &fps, &latency, &watts);
+        if (n < 7 || strlen(order) != 5) continue; // title and header lines
+
+        replay_add_row(sim, capacity, big, little, pp1, pp2, order, fps, latency, watts, n == 8);
+        rows++;
+    }
+    fclose(f);
+    return rows;
+}
+
+static int replay_point_cmp(const void *a, const void *b) {
+    const ReplayPoint *x = a;
+    const ReplayPoint *y = b;
+    int c = strcmp(x->order, y->order);
+    if (c) return c;
+    if (x->partition_point1 != y->partition_point1) return x->partition_point1 - y->partition_point1;
+    if (x->partition_point2 != y->partition_point2) return x->partition_point2 - y->partition_point2;
+    if (x->big_frequency != y->big_frequency) return x->big_frequency - y->big_frequency;
+    return x->little_frequency - y->little_frequency;
+}
+
+static void replay_build_groups(ReplaySimulator *sim) {
+    qsort(sim->points, (size_t)sim->n_points, sizeof(ReplayPoint), replay_point_cmp);
+
+    sim->groups = calloc((size_t)sim->n_points, sizeof(ReplayGroup));
+    sim->n_groups = 0;
+
+    for (int i = 0; i < sim->n_points; i++) {
+        const ReplayPoint *p = &sim->points[i];
+        ReplayGroup *g = sim->n_groups ? &sim->groups[sim->n_groups - 1] : NULL;
+
+        if (!g || g->partition_point1 != p->partition_point1 || g->partition_point2 != p->partition_point2 ||
+            strcmp(g->order, p->order) != 0) {
+            g = &sim->groups[sim->n_groups++];
+            g->partition_point1 = p->partition_point1;
+            g->partition_point2 = p->partition_point2;
+            snprintf(g->order, sizeof(g->order), "%s", p->order);
+            g->first_point = i;
+            g->n_points = 0;
+        }
+        g->n_points++;
+    }
+}
+
+static void replay_calibrate_noise(ReplaySimulator *sim) {
+    double fps_sum = 0.0, lat_sum = 0.0;
+    int dof = 0;
+
+    for (int i = 0; i < sim->n_points; i++) {
+        const ReplayPoint *p = &sim->points[i];
+        if (p->n < 2 || p->fps <= 0.0 || p->latency <= 0.0) continue;
+        fps_sum += p->fps_m2 / (p->fps * p->fps);
+        lat_sum += p->latency_m2 / (p->latency * p->latency);
+        dof += p->n - 1;
+    }
+
+    if (dof > 0) {
+        sim->fps_cv = sqrt(fps_sum / dof);
+        sim->latency_cv = sqrt(lat_sum / dof);
+    } else {
+        sim->fps_cv = REPLAY_DEFAULT_CV;
+        sim->latency_cv = REPLAY_DEFAULT_CV;
+    }
+}
+
+
+int replay_simulator_load(ReplaySimulator *sim, const char *data_dir) {
+    memset(sim, 0, sizeof(*sim));
+    sim->noise_scale = 1.0;
+    sim->rng_state = 0x9E3779B97F4A7C15ULL;
+
+    DIR *dir = opendir(data_dir);
+    if (!dir) {
+        fprintf(stderr, "replay_simulator_load: cannot open %s\n", data_dir);
+        return -1;
+    }
+
+    int capacity = 0;
+    int files = 0, rows = 0;
+    struct dirent *entry;
+
+    while ((entry = readdir(dir)) != NULL) {
+        size_t len = strlen(entry->d_name);
+        if (len < 4 || strcmp(entry->d_name + len - 4, ".csv") != 0) continue;
+
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", data_dir, entry->d_name);
+        int n = replay_load_file(sim, &capacity, path);
+        if (n > 0) {
+            files++;
+            rows += n;
+        }
+    }
+    closedir(dir);
+
+    if (sim->n_points == 0) {
+        fprintf(stderr, "replay_simulator_load: no measurements found in %s\n", data_dir);
+        return -1;
+    }
+
+    replay_build_groups(sim);
+    replay_calibrate_noise(sim);
+
+    printf("[replay-sim] loaded %d rows from %d files: %d points in %d partition/order groups (noise cv: fps=%.3f, latency=%.3f)\n",
+           rows, files, sim->n_points, sim->n_groups, sim->fps_cv, sim->latency_cv);
+    return 0;
+}
+
+
+void replay_simulator_seed(ReplaySimulator *sim, unsigned long long seed, double noise_scale) {
+    sim->rng_state = seed ? seed : 0x9E3779B97F4A7C15ULL;
+    sim->noise_scale = noise_scale;
+}
+
+
+static const ReplayGroup *replay_find_group(const ReplaySimulator *sim, int pp1, int pp2, const char *order) {
+    for (int i = 0; i < sim->n_groups; i++) {
+        const ReplayGroup *g = &sim->groups[i];
+        if (g->partition_point1 == pp1 && g->partition_point2 == pp2 && strcmp(g->order, order) == 0) {
+            return g;
+        }
+    }
+    return NULL;
+}
+
+static void replay_axis_bracket(const int *axis, int n, int x, int *lo, int *hi) {
+    *lo = axis[0];
+    *hi = axis[n - 1];
+    if (x <= axis[0]) { *hi = axis[0]; return; }
+    if (x >= axis[n - 1]) { *lo = axis[n - 1]; return; }
+    for (int i = 0; i < n; i++) {
+        if (axis[i] <= x) *lo = axis[i];
+        if (axis[i] >= x) { *hi = axis[i]; break; }
+    }
+}
+
+static void replay_axis_insert(int *axis, int *n, int value) {
+    for (int i = 0; i < *n; i++) {
+        if (axis[i] == value) return;
+    }
+    if (*n >= REPLAY_MAX_AXIS) return;
+    int i = *n;
+    while (i > 0 && axis[i - 1] > value) {
+        axis[i] = axis[i - 1];
+        i--;
+    }
+    axis[i] = value;
+    (*n)++;
+}
+
+static const ReplayPoint *replay_group_point(const ReplaySimulator *sim, const ReplayGroup *g, int big, int little) {
+    for (int i = g->first_point; i < g->first_point + g->n_points; i++) {
+        if (sim->points[i].big_frequency == big && sim->points[i].little_frequency == little) {
+            return &sim->points[i];
+        }
+    }
+    return NULL;
+}
+
+// Bilinear over the group's own frequency grid, inverse-distance weighting when
+// the surrounding corners were not all measured.
+static void replay_group_sweep(const ReplaySimulator *sim, const ReplayGroup *g, int big, int little,
+                               double *fps, double *latency) {
+    int bigs[REPLAY_MAX_AXIS], littles[REPLAY_MAX_AXIS];
+    int n_bigs = 0, n_littles = 0;
+
+    for (int i = g->first_point; i < g->first_point + g->n_points; i++) {
+        replay_axis_insert(bigs, &n_bigs, sim->points[i].big_frequency);
+        replay_axis_insert(littles, &n_littles, sim->points[i].little_frequency);
+    }
+
+    int b_lo, b_hi, l_lo, l_hi;
+    replay_axis_bracket(bigs, n_bigs, big, &b_lo, &b_hi);
+    replay_axis_bracket(littles, n_littles, little, &l_lo, &l_hi);
+
+    const ReplayPoint *c00 = replay_group_point(sim, g, b_lo, l_lo);
+    const ReplayPoint *c01 = replay_group_point(sim, g, b_lo, l_hi);
+    const ReplayPoint *c10 = replay_group_point(sim, g, b_hi, l_lo);
+    const ReplayPoint *c11 = replay_group_point(sim, g, b_hi, l_hi);
+
+    if (c00 && c01 && c10 && c11) {
+        double tb = (b_hi > b_lo) ? (double)(big - b_lo) / (b_hi - b_lo) : 0.0;
+        double tl = (l_hi > l_lo) ? (double)(little - l_lo) / (l_hi - l_lo) : 0.0;
+        if (tb < 0.0) tb = 0.0;
+        if (tb > 1.0) tb = 1.0;
+        if (tl < 0.0) tl = 0.0;
+        if (tl > 1.0) tl = 1.0;
+
+        *fps = (1 - tb) * ((1 - tl) * c00->fps + tl * c01->fps) + tb * ((1 - tl) * c10->fps + tl * c11->fps);
+        *latency = (1 - tb) * ((1 - tl) * c00->latency + tl * c01->latency) +
+                   tb * ((1 - tl) * c10->latency + tl * c11->latency);
+        return;
+    }
+
+    double w_sum = 0.0, fps_sum = 0.0, lat_sum = 0.0;
+    for (int i = g->first_point; i < g->first_point + g->n_points; i++) {
+        const ReplayPoint *p = &sim->points[i];
+        double db = (double)(p->big_frequency - big) / BIG_FREQUENCY_TABLE[NUM_BIG_FREQUENCIES - 1];
+        double dl = (double)(p->little_frequency - little) / LITTLE_FREQUENCY_TABLE[NUM_LITTLE_FREQUENCIES - 1];
+        double d2 = db * db + dl * dl;
+        if (d2 < 1e-12) {
+            *fps = p->fps;
+            *latency = p->latency;
+            return;
+        }
+        fps_sum += p->fps / d2;
+        lat_sum += p->latency / d2;
+        w_sum += 1.0 / d2;
+    }
+    *fps = fps_sum / w_sum;
+    *latency = lat_sum / w_sum;
+}
+
+static bool replay_is_sweep(const ReplayGroup *g) {
+    return g->n_points >= 4;
+}
+
+// Closest group that was swept over frequency, preferring the same order.
+static const ReplayGroup *replay_nearest_sweep(const ReplaySimulator *sim, int pp1, int pp2, const char *order) {
+    const ReplayGroup *best = NULL;
+    int best_dist = 1 << 30;
+
+    for (int i = 0; i < sim->n_groups; i++) {
+        const ReplayGroup *g = &sim->groups[i];
+        if (!replay_is_sweep(g)) continue;
+        int dist = abs(g->partition_point1 - pp1) + abs(g->partition_point2 - pp2);
+        if (strcmp(g->order, order) != 0) dist += 100;
+        if (dist < best_dist) {
+            best_dist = dist;
+            best = g;
+        }
+    }
+    return best;
+}
+
+// big_used/little_used: the queried layout gives the cluster layers. The
+// frequency of a cluster without any only moves the result through noise in
+// the corpus, so the response of another layout is never applied along it.
+static void replay_group_eval(const ReplaySimulator *sim, const ReplayGroup *g, int big, int little,
+                              bool big_used, bool little_used, double *fps, double *latency) {
+    if (replay_is_sweep(g)) {
+        replay_group_sweep(sim, g, big, little, fps, latency);
+        return;
+    }
+
+    // Measured at a few frequencies only: take the nearest measurement and move
+    // it along the frequency response of the closest full sweep.
+    const ReplayPoint *anchor = NULL;
+    double best_d2 = 1e30;
+    for (int i = g->first_point; i < g->first_point + g->n_points; i++) {
+        const ReplayPoint *p = &sim->points[i];
+        double db = big_used ? (double)(p->big_frequency - big) : 0.0;
+        double dl = little_used ? (double)(p->little_frequency - little) : 0.0;
+        if (db * db + dl * dl < best_d2) {
+            best_d2 = db * db + dl * dl;
+            anchor = p;
+        }
+    }
+
+    *fps = anchor->fps;
+    *latency = anchor->latency;
+
+    const ReplayGroup *sweep = replay_nearest_sweep(sim, g->partition_point1, g->partition_point2, g->order);
+    if (!sweep || best_d2 == 0.0) return;
+
+    if (!big_used) big = anchor->big_frequency;
+    if (!little_used) little = anchor->little_frequency;
+
+    double s_fps_q, s_lat_q, s_fps_a, s_lat_a;
+    replay_group_sweep(sim, sweep, big, little, &s_fps_q, &s_lat_q);
+    replay_group_sweep(sim, sweep, anchor->big_frequency, anchor->little_frequency, &s_fps_a, &s_lat_a);
+
+    if (s_fps_a > 0.0) *fps *= s_fps_q / s_fps_a;
+    if (s_lat_a > 0.0) *latency *= s_lat_q / s_lat_a;
+}
+
+// Same order: exact group, or inverse-distance weighting over its partitions.
+static int replay_eval_order(const ReplaySimulator *sim, int pp1, int pp2, const char *order, int big, int little,
+                             bool big_used, bool little_used, double *fps, double *latency) {
+    const ReplayGroup *exact = replay_find_group(sim, pp1, pp2, order);
+    if (exact) {
+        replay_group_eval(sim, exact, big, little, big_used, little_used, fps, latency);
+        return 0;
+    }
+
+    double w_sum = 0.0, fps_sum = 0.0, lat_sum = 0.0;
+    for (int i = 0; i < sim->n_groups; i++) {
+        const ReplayGroup *g = &sim->groups[i];
+        if (strcmp(g->order, order) != 0) continue;
+
+        double d = abs(g->partition_point1 - pp1) + abs(g->partition_point2 - pp2);
+        double w = 1.0 / (d * d);
+        double g_fps, g_lat;
+        replay_group_eval(sim, g, big, little, big_used, little_used, &g_fps, &g_lat);
+        fps_sum += w * g_fps;
+        lat_sum += w * g_lat;
+        w_sum += w;
+    }
+
+    if (w_sum <= 0.0) return -1;
+    *fps = fps_sum / w_sum;
+    *latency = lat_sum / w_sum;
+    return 0;
+}
+
+static bool replay_owns_layers(const PipelineConfig *config, char processor_code) {
+    const int bounds[4] = {0, config->partition_point1, config->partition_point2, TOTAL_LAYERS};
+
+    for (int s = 0; s < 3; s++) {
+        if (config->order[2 * s] == processor_code && bounds[s + 1] > bounds[s]) return true;
+    }
+    return false;
+}
+
+// With an empty middle stage a layout runs as the two-stage one that leaves
+// its last stage empty instead, e.g. G-L-B 3/3 as G-B-L 3/8, the way
+// get_order_overhead folds it. Layouts measured as they are stay as they are.
+static void replay_canonical_layout(const ReplaySimulator *sim, const PipelineConfig *config, PipelineConfig *canonical) {
+    *canonical = *config;
+    if (config->partition_point1 >= TOTAL_LAYERS || config->partition_point2 > config->partition_point1) return;
+    if (replay_find_group(sim, config->partition_point1, config->partition_point2, config->order)) return;
+
+    canonical->order[2] = config->order[4];
+    canonical->order[4] = config->order[2];
+    canonical->partition_point2 = TOTAL_LAYERS;
+}
+
+static int replay_eval(const ReplaySimulator *sim, const PipelineConfig *layout, double *fps, double *latency) {
+    PipelineConfig canonical;
+    replay_canonical_layout(sim, layout, &canonical);
+    const PipelineConfig *config = &canonical;
+    const int pp1 = config->partition_point1;
+    const int pp2 = config->partition_point2;
+    const bool big_used = replay_owns_layers(config, 'B');
+    const bool little_used = replay_owns_layers(config, 'L');
+    // A cluster without layers is read where the corpus ran it, at its top OPP.
+    const int big = big_used ? config->big_frequency : BIG_FREQUENCY_TABLE[NUM_BIG_FREQUENCIES - 1];
+    const int little = little_used ? config->little_frequency : LITTLE_FREQUENCY_TABLE[NUM_LITTLE_FREQUENCIES - 1];
+
+    if (replay_eval_order(sim, pp1, pp2, config->order, big, little, big_used, little_used, fps, latency) == 0) {
+        return 0;
+    }
+
+    // Order never measured: G-B-L at this partition, scaled by the order/G-B-L
+    // ratio at the closest partition where both were measured (exp5).
+    const ReplayGroup *best = NULL;
+    int best_dist = 1 << 30;
+    for (int i = 0; i < sim->n_groups; i++) {
+        const ReplayGroup *g = &sim->groups[i];
+        if (strcmp(g->order, "G-B-L") != 0) continue;
+        if (!replay_find_group(sim, g->partition_point1, g->partition_point2, config->order)) continue;
+        int dist = abs(g->partition_point1 - pp1) + abs(g->partition_point2 - pp2);
+        if (dist < best_dist) {
+            best_dist = dist;
+            best = g;
+        }
+    }
+
+    double base_fps, base_lat;
+    if (replay_eval_order(sim, pp1, pp2, "G-B-L", big, little, big_used, little_used, &base_fps, &base_lat) != 0) {
+        return -1;
+    }
+    *fps = base_fps;
+    *latency = base_lat;
+
+    if (best) {
+        double o_fps, o_lat, r_fps, r_lat;
+        replay_eval_order(sim, best->partition_point1, best->partition_point2, config->order, big, little, big_used, little_used, &o_fps, &o_lat);
+        replay_eval_order(sim, best->partition_point1, best->partition_point2, "G-B-L", big, little, big_used, little_used, &r_fps, &r_lat);
+        if (r_fps > 0.0) *fps *= o_fps / r_fps;
+        if (r_lat > 0.0) *latency *= o_lat / r_lat;
+    }
+    return 0;
+}
+
+// The CSVs only hold fps and latency; split the bottleneck period 1000/fps over
+// the stages in proportion to their modelled cost so the PID sees plausible stage times.
+static void replay_fill_stage_times(const PipelineConfig *config, stats_t *stats) {
+    double cost[3];
+    double max_cost = 0.0;
+
+    estimate_fitted_stage_times(config, cost);
+    for (int s = 0; s < 3; s++) {
+        if (cost[s] > max_cost) max_cost = cost[s];
+    }
+
+    double period = (stats->fps > 0.0) ? 1000.0 / stats->fps : 0.0;
+    double scale = (max_cost > 0.0) ? period / max_cost : 0.0;
+
+    stats->stage1_inference_time = cost[0] * scale;
+    stats->stage2_inference_time = cost[1] * scale;
+    stats->stage3_inference_time = cost[2] * scale;
+}
+
+
+int replay_simulator_predict(const ReplaySimulator *sim, const PipelineConfig *config, stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    double fps, latency;
+    if (replay_eval(sim, config, &fps, &latency) != 0) {
+        return -1;
+    }
+
+    // Every CSV ran at the top GPU OPP on all cores; other GPU frequencies and
+    // thread counts follow the fitted models.
+    PipelineConfig top = *config;
+    top.gpu_frequency = GPU_MAX_FREQUENCY;
+    top.big_threads = MAX_BIG_THREADS;
+    top.little_threads = MAX_LITTLE_THREADS;
+    if (estimate_stage_scale(config, 'G') != 1.0 || estimate_stage_scale(config, 'B') != 1.0 ||
+        estimate_stage_scale(config, 'L') != 1.0) {
+        double stage_ms[3], top_ms[3], period, top_period, lat, top_lat;
+
+        estimate_fitted_stage_times(config, stage_ms);
+        estimate_fitted_stage_times(&top, top_ms);
+        estimate_pipeline_timing(config, stage_ms, &period, &lat);
+        estimate_pipeline_timing(&top, top_ms, &top_period, &top_lat);
+        if (period > 0.0) fps *= top_period / period;
+        if (top_lat > 0.0) latency *= lat / top_lat;
+    }
+
+    stats->fps = fps;
+    stats->latency = latency;
+    replay_fill_stage_times(config, stats);
+    return 0;
+}
+
+
+static double replay_uniform(ReplaySimulator *sim) {
+    // xorshift64*
+    sim->rng_state ^= sim->rng_state >> 12;
+    sim->rng_state ^= sim->rng_state << 25;
+    sim->rng_state ^= sim->rng_state >> 27;
+    unsigned long long r = sim->rng_state * 0x2545F4914F6CDD1DULL;
+    return ((r >> 11) + 0.5) / 9007199254740992.0;
+}
+
+static double replay_gaussian(ReplaySimulator *sim) {
+    double u1 = replay_uniform(sim);
+    double u2 = replay_uniform(sim);
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+
+int replay_simulator_sample(ReplaySimulator *sim, const PipelineConfig *config, int n_frames, stats_t *stats) {
+    if (replay_simulator_predict(sim, config, stats) != 0) {
+        return -1;
+    }
+
+    // The replicate spread was measured on REPLAY_CALIBRATION_FRAMES-frame runs;
+    // the mean of a shorter or longer run scatters with 1/sqrt(n).
+    double frames = n_frames > 0 ? n_frames : 1;
+    double scale = sim->noise_scale * sqrt((double)REPLAY_CALIBRATION_FRAMES / frames);
+
+    double fps_factor = 1.0 + sim->fps_cv * scale * replay_gaussian(sim);
+    double lat_factor = 1.0 + sim->latency_cv * scale * replay_gaussian(sim);
+    if (fps_factor < 0.05) fps_factor = 0.05;
+    if (lat_factor < 0.05) lat_factor = 0.05;
+
+    stats->fps *= fps_factor;
+    stats->latency *= lat_factor;
+    stats->stage1_inference_time /= fps_factor;
+    stats->stage2_inference_time /= fps_factor;
+    stats->stage3_inference_time /= fps_factor;
+    return 0;
+}
+
+
+void replay_simulator_free(ReplaySimulator *sim) {
+    free(sim->points);
+    free(sim->groups);
+    sim->points = NULL;
+    sim->groups = NULL;
+    sim->n_points = 0;
+    sim->n_groups = 0;
+}
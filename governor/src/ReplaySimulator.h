@@ -0,0 +1,65 @@
+#ifndef REPLAYSIMULATOR_H
+#define REPLAYSIMULATOR_H
+
+#include <stdbool.h>
+
+#include "PipelineConfig.h"
+#include "Governor.h"
+
+#define REPLAY_DEFAULT_DATA_DIR "../experiments/data"
+#define REPLAY_CALIBRATION_FRAMES 100
+
+// Mean of all replicates of one measured (freqs, partition, order) point.
+typedef struct {
+    int big_frequency;
+    int little_frequency;
+    int partition_point1;
+    int partition_point2;
+    char order[6];
+    double fps;
+    double latency;
+    double watts;
+    double fps_m2;
+    double latency_m2;
+    int n;
+    int n_watts;
+} ReplayPoint;
+
+// All points sharing a partition and order, i.e. one frequency sweep.
+typedef struct {
+    int partition_point1;
+    int partition_point2;
+    char order[6];
+    int first_point;
+    int n_points;
+} ReplayGroup;
+
+// Serves stats_t for any PipelineConfig from the characterization CSVs in
+// experiments/data: bilinear over a group's frequency sweep, frequency scaling
+// borrowed from the closest full sweep for groups measured at one frequency,
+// inverse-distance weighting across partitions and exp5 ratios across orders.
+// Noise is multiplicative with the relative spread seen between replicates.
+typedef struct {
+    ReplayPoint *points;
+    int n_points;
+    ReplayGroup *groups;
+    int n_groups;
+    double fps_cv;
+    double latency_cv;
+    double noise_scale;
+    unsigned long long rng_state;
+} ReplaySimulator;
+
+int replay_simulator_load(ReplaySimulator *sim, const char *data_dir);
+
+void replay_simulator_seed(ReplaySimulator *sim, unsigned long long seed, double noise_scale);
+
+// Noise-free interpolated operating point.
+int replay_simulator_predict(const ReplaySimulator *sim, const PipelineConfig *config, stats_t *stats);
+
+// One simulated run of n_frames: the prediction plus calibrated noise.
+int replay_simulator_sample(ReplaySimulator *sim, const PipelineConfig *config, int n_frames, stats_t *stats);
+
+void replay_simulator_free(ReplaySimulator *sim);
+
+#endif
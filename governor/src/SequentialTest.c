@@ -0,0 +1,108 @@
+#include "SequentialTest.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+// Two-sided 97.5% quantiles of Student's t for 1..10 degrees of freedom.
+static const double T_QUANTILE_975[10] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228
+};
+
+
+static double seq_t_quantile(int dof) {
+    if (dof < 1) return INFINITY;
+    if (dof <= 10) return T_QUANTILE_975[dof - 1];
+    return 1.96 + 2.4 / dof;
+}
+
+static double seq_half_width(double mean, double m2, int n) {
+    double sd = (n > 1) ? sqrt(m2 / (n - 1)) : 0.0;
+    if (sd < SEQ_MIN_CV * fabs(mean)) sd = SEQ_MIN_CV * fabs(mean);
+    return seq_t_quantile(n - 1) * sd / sqrt((double)n);
+}
+
+
+void sequential_test_init(SequentialTest *test, double target_fps, double target_latency) {
+    memset(test, 0, sizeof(*test));
+    test->target_fps = target_fps;
+    test->target_latency = target_latency;
+    test->fps_half_width = INFINITY;
+    test->latency_half_width = INFINITY;
+    latency_sketch_reset();
+}
+
+// The tail can be judged once a frame is expected beyond the quantile.
+static bool seq_tail_judged(const SequentialTest *test) {
+    return test->latency_tail > 0.0 && latency_sketch_frames() >= 1.0 / (1.0 - get_latency_quantile());
+}
+
+SeqDecision sequential_test_add(SequentialTest *test, const stats_t *window, int frames) {
+    test->windows++;
+    test->frames += frames;
+
+    double delta = window->fps - test->fps_mean;
+    test->fps_mean += delta / test->windows;
+    test->fps_m2 += delta * (window->fps - test->fps_mean);
+
+    delta = window->latency - test->latency_mean;
+    test->latency_mean += delta / test->windows;
+    test->latency_m2 += delta * (window->latency - test->latency_mean);
+
+    if (window->fps > 0.0) test->frame_time += frames / window->fps;
+    test->weighted.latency += frames * window->latency;
+    test->weighted.stage1_inference_time += frames * window->stage1_inference_time;
+    test->weighted.stage2_inference_time += frames * window->stage2_inference_time;
+    test->weighted.stage3_inference_time += frames * window->stage3_inference_time;
+    test->weighted.stage1_input_time += frames * window->stage1_input_time;
+    test->weighted.stage2_input_time += frames * window->stage2_input_time;
+    test->weighted.stage3_input_time += frames * window->stage3_input_time;
+    if (window->energy_per_frame > 0.0) {
+        test->weighted.energy_per_frame += frames * window->energy_per_frame;
+        test->energy_frames += frames;
+    }
+    if (window->latency_tail > 0.0) test->latency_tail = window->latency_tail;
+
+    if (test->windows < SEQ_MIN_WINDOWS) return SEQ_EXTEND;
+
+    test->fps_half_width = seq_half_width(test->fps_mean, test->fps_m2, test->windows);
+    test->latency_half_width = seq_half_width(test->latency_mean, test->latency_m2, test->windows);
+
+    const bool fps_meets = test->fps_mean - test->fps_half_width >= test->target_fps;
+    const bool fps_misses = test->fps_mean + test->fps_half_width < test->target_fps;
+    bool latency_meets = test->latency_mean + test->latency_half_width <= test->target_latency;
+    bool latency_misses = test->latency_mean - test->latency_half_width > test->target_latency;
+    if (test->latency_tail > 0.0) {
+        // A mean over the target still misses: the tail is above the mean.
+        latency_meets = seq_tail_judged(test) && test->latency_tail <= test->target_latency;
+        latency_misses = latency_misses || (seq_tail_judged(test) && test->latency_tail > test->target_latency);
+    }
+
+    if (fps_misses || latency_misses) return SEQ_MISSES;
+    if (fps_meets && latency_meets) return SEQ_MEETS;
+    return SEQ_EXTEND;
+}
+
+void sequential_test_result(const SequentialTest *test, stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (test->frames == 0) return;
+
+    const double n = test->frames;
+    stats->fps = (test->frame_time > 0.0) ? n / test->frame_time : 0.0;
+    stats->latency = test->weighted.latency / n;
+    stats->stage1_inference_time = test->weighted.stage1_inference_time / n;
+    stats->stage2_inference_time = test->weighted.stage2_inference_time / n;
+    stats->stage3_inference_time = test->weighted.stage3_inference_time / n;
+    stats->stage1_input_time = test->weighted.stage1_input_time / n;
+    stats->stage2_input_time = test->weighted.stage2_input_time / n;
+    stats->stage3_input_time = test->weighted.stage3_input_time / n;
+    if (test->energy_frames > 0) stats->energy_per_frame = test->weighted.energy_per_frame / test->energy_frames;
+    stats->latency_tail = test->latency_tail;
+}
+
+const char *sequential_test_decision_name(SeqDecision decision) {
+    switch (decision) {
+        case SEQ_MEETS: return "meets";
+        case SEQ_MISSES: return "misses";
+        default: return "borderline";
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef SEQUENTIALTEST_H
+#define SEQUENTIALTEST_H
+
+#include <stdbool.h>
+
+#include "Governor.h"
+
+#define SEQ_WINDOW_DEFAULT 10     // frames per block of a live graph
+#define SEQ_MIN_WINDOWS 2         // a spread needs at least two windows
+#define SEQ_MIN_CV 0.01           // floor on the window-to-window spread
+
+typedef enum {
+    SEQ_EXTEND,
+    SEQ_MEETS,
+    SEQ_MISSES
+} SeqDecision;
+
+// Sequential test over measurement windows of one configuration: after every
+// window, the 95% t-interval of the window means for fps and latency is
+// compared with the targets. The run stops as soon as both intervals are on
+// the right side (meets) or either is entirely on the wrong side (misses).
+// Under a latency quantile the latency side is the tail of all frames so far
+// instead, judged once there are enough frames for the quantile to exist.
+typedef struct {
+    double target_fps;
+    double target_latency;
+    int windows;
+    int frames;
+    double fps_mean, fps_m2;
+    double latency_mean, latency_m2;
+    double fps_half_width;
+    double latency_half_width;
+    double frame_time;            // sum of frames / fps, for the aggregate throughput
+    stats_t weighted;             // frame-weighted sums of the other fields
+    int energy_frames;            // frames of the windows the power sensor measured
+    double latency_tail;          // the latest window's, which covers the whole test
+} SequentialTest;
+
+void sequential_test_init(SequentialTest *test, double target_fps, double target_latency);
+
+SeqDecision sequential_test_add(SequentialTest *test, const stats_t *window, int frames);
+
+// All windows merged as if they had been one run.
+void sequential_test_result(const SequentialTest *test, stats_t *stats);
+
+const char *sequential_test_decision_name(SeqDecision decision);
+
+#endif
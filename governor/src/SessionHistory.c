@@ -0,0 +1,130 @@
+#include "SessionHistory.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+
+static double session_relative_distance(double fps, double latency, double target_fps, double target_latency) {
+    double dfps = (fps - target_fps) / target_fps;
+    double dlat = (latency - target_latency) / target_latency;
+    return sqrt(dfps * dfps + dlat * dlat);
+}
+
+static double session_distance(const SessionRecord *record, double target_fps, double target_latency) {
+    return session_relative_distance(record->fps, record->latency, target_fps, target_latency);
+}
+
+static bool session_meets(const SessionRecord *record, double target_fps, double target_latency) {
+    return record->fps >= target_fps && record->latency <= target_latency;
+}
+
+
+// Reads the header of a history file; 1 if it is a version SESSION_HISTORY_VERSION
+// history, with the device it belongs to in stored_id (256 bytes).
+static int session_header(FILE *fp, char *stored_id) {
+    int version = 0;
+    return fscanf(fp, "device %255s version %d", stored_id, &version) == 2 && version == SESSION_HISTORY_VERSION;
+}
+
+int session_history_append(const char *path, const char *device_id, const SessionRecord *record) {
+    const char *mode = "a";
+    FILE *fp = fopen(path, "r");
+    if (fp) {
+        char stored_id[256] = "";
+        if (fgetc(fp) != EOF) {
+            rewind(fp);
+            if (!session_header(fp, stored_id)) {
+                printf("session_history: %s is not a version %d history; starting it over\n", path, SESSION_HISTORY_VERSION);
+                mode = "w";
+            }
+        }
+        fclose(fp);
+    }
+
+    fp = fopen(path, mode);
+    if (!fp) return -1;
+
+    if (ftell(fp) == 0) fprintf(fp, "device %s version %d\n", device_id, SESSION_HISTORY_VERSION);
+    fprintf(fp, "%s %.3f %.3f %d %d %d %d %d %d %d %d %s %.9g %.9g %.9g %.9g %ld\n", record->graph,
+            record->target_fps, record->target_latency, record->converged ? 1 : 0,
+            record->config.partition_point1, record->config.partition_point2,
+            record->config.big_frequency, record->config.little_frequency, record->config.gpu_frequency,
+            get_processor_threads(&record->config, 'B'), get_processor_threads(&record->config, 'L'),
+            record->config.order, record->fps, record->latency, record->estimated_power, record->measured_power,
+            (long)record->finished);
+
+    return fclose(fp) == 0 ? 0 : -1;
+}
+
+int session_history_nearest(const char *path, const char *device_id, const char *graph,
+                            double target_fps, double target_latency, SessionRecord *out) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return -1;
+
+    char stored_id[256] = "";
+    if (!session_header(fp, stored_id)) {
+        printf("session_history: %s is not a version %d history; ignoring it\n", path, SESSION_HISTORY_VERSION);
+        fclose(fp);
+        return -1;
+    }
+    if (strcmp(stored_id, device_id) != 0) {
+        printf("session_history: %s belongs to device '%s', not '%s'; ignoring it\n", path, stored_id, device_id);
+        fclose(fp);
+        return -1;
+    }
+
+    SessionRecord record;
+    char line[512];
+    int converged;
+    long finished;
+    bool found = false, found_meets = false;
+    double found_distance = 0.0;
+    double nearest = -1.0;
+    int sessions = 0;
+
+    memset(&record, 0, sizeof(record));
+    fgets(line, sizeof(line), fp);   // rest of the device line
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "%63s %lf %lf %d %d %d %d %d %d %d %d %5s %lf %lf %lf %lf %ld", record.graph,
+                   &record.target_fps, &record.target_latency, &converged,
+                   &record.config.partition_point1, &record.config.partition_point2,
+                   &record.config.big_frequency, &record.config.little_frequency, &record.config.gpu_frequency,
+                   &record.config.big_threads, &record.config.little_threads, record.config.order,
+                   &record.fps, &record.latency, &record.estimated_power, &record.measured_power,
+                   &finished) != 17) {
+            continue;
+        }
+        sessions++;
+        record.converged = converged != 0;
+        record.finished = (time_t)finished;
+        if (!record.converged || strcmp(record.graph, graph) != 0) continue;
+
+        // A session that converged for targets far from these settled where they
+        // needed, not where these do.
+        const double retarget = session_relative_distance(record.target_fps, record.target_latency,
+                                                          target_fps, target_latency);
+        if (nearest < 0.0 || retarget < nearest) nearest = retarget;
+        if (retarget > SESSION_MAX_DISTANCE) continue;
+
+        const bool meets = session_meets(&record, target_fps, target_latency);
+        const double distance = session_distance(&record, target_fps, target_latency);
+        if (!found || (meets && !found_meets) || (meets == found_meets && distance <= found_distance)) {
+            *out = record;
+            found = true;
+            found_meets = meets;
+            found_distance = distance;
+        }
+    }
+    fclose(fp);
+
+    if (!found) {
+        if (nearest >= 0.0) {
+            printf("session_history: the nearest converged session of %s had targets %.0f%% off these, more than %.0f%%\n",
+                   graph, 100.0 * nearest, 100.0 * SESSION_MAX_DISTANCE);
+        } else {
+            printf("session_history: no converged session of %s among %d in %s\n", graph, sessions, path);
+        }
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,41 @@
+#ifndef SESSIONHISTORY_H
+#define SESSIONHISTORY_H
+
+#include <stdbool.h>
+#include <time.h>
+
+#include "PipelineConfig.h"
+
+#define SESSION_GRAPH_LEN 64
+#define SESSION_HISTORY_PREFIX "session_history_"
+#define SESSION_HISTORY_VERSION 1     // line format; a file of another version is started over
+#define SESSION_MAX_DISTANCE 0.2      // sessions tuned for targets farther off start the search worse than the models do
+
+// Outcome of one governor session: the targets it was given, the
+// configuration it ended on and that configuration's measured operating point.
+typedef struct {
+    char graph[SESSION_GRAPH_LEN];
+    double target_fps;
+    double target_latency;
+    bool converged;               // converged and met its targets
+    PipelineConfig config;
+    double fps;
+    double latency;
+    double estimated_power;
+    double measured_power;        // W from the power sensor, 0 = not measured
+    time_t finished;
+} SessionRecord;
+
+// Appends one record to the device's history, creating the file if needed
+// and starting it over if it has another line format.
+int session_history_append(const char *path, const char *device_id, const SessionRecord *record);
+
+// Past converged session of the graph whose operating point is nearest to the
+// targets in relative (fps, latency) distance, among those whose own targets
+// were at most SESSION_MAX_DISTANCE from these: one that converged for much
+// stricter targets spends power these do not need. Operating points that meet the targets are preferred; among equals the
+// most recent wins. Returns -1 if the history has no such session of this graph.
+int session_history_nearest(const char *path, const char *device_id, const char *graph,
+                            double target_fps, double target_latency, SessionRecord *out);
+
+#endif
@@ -0,0 +1,140 @@
+#include "ThermalModel.h"
+#include "ModelEstimator.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define THERMAL_RESISTANCE_PRIOR 14.0     // degC/W with the fan off
+
+static const double FAN_RESISTANCE_RATIO[FAN_LEVELS] = {1.00, 0.65, 0.50, 0.43};
+static const double FAN_POWER[FAN_LEVELS] = {0.00, 0.25, 0.45, 0.70};   // W
+
+static RLSEstimator thermal_rls;
+static double throttle = THERMAL_THROTTLE_DEFAULT;
+static bool active = false;
+static double temperature = NAN;
+
+// Start of the current update interval and the energy drawn since.
+static double anchor_time, anchor_temperature, last_time;
+static double energy;
+static int anchor_fan = -1;
+
+
+static double thermal_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double thermal_regressor(double power, int fan_level) {
+    if (fan_level < 0) fan_level = 0;
+    if (fan_level >= FAN_LEVELS) fan_level = FAN_LEVELS - 1;
+    return power * FAN_RESISTANCE_RATIO[fan_level];
+}
+
+static void thermal_anchor(double now, double celsius, int fan_level) {
+    anchor_time = now;
+    last_time = now;
+    anchor_temperature = celsius;
+    anchor_fan = fan_level;
+    energy = 0.0;
+}
+
+
+void thermal_model_reset(void) {
+    const double theta0[1] = {THERMAL_RESISTANCE_PRIOR};
+    const double std = RLS_PRIOR_REL_STD * THERMAL_RESISTANCE_PRIOR;
+    const double p0[1] = {std * std};
+
+    rls_init(&thermal_rls, 1, theta0, p0, THERMAL_FORGETTING_FACTOR);
+    active = false;
+    temperature = NAN;
+    anchor_fan = -1;
+}
+
+void thermal_model_set_throttle(double celsius) {
+    throttle = celsius;
+}
+
+double thermal_model_throttle(void) {
+    return throttle;
+}
+
+bool thermal_model_active(void) {
+    return active;
+}
+
+void thermal_model_observe(double celsius, double power, int fan_level) {
+    const double now = thermal_now();
+
+    if (!active) {
+        if (thermal_rls.n == 0) thermal_model_reset();
+        active = true;
+        temperature = celsius;
+        thermal_anchor(now, celsius, fan_level);
+        return;
+    }
+    temperature = celsius;
+
+    // A different fan level is a different model; start a fresh interval.
+    if (fan_level != anchor_fan) {
+        thermal_anchor(now, celsius, fan_level);
+        return;
+    }
+
+    energy += power * (now - last_time);
+    last_time = now;
+
+    const double dt = now - anchor_time;
+    if (dt < THERMAL_UPDATE_INTERVAL) return;
+
+    // T = T_ss + (T_anchor - T_ss) * exp(-dt / tau), solved for T_ss.
+    const double decay = exp(-dt / THERMAL_TIME_CONSTANT);
+    const double steady = (celsius - anchor_temperature * decay) / (1.0 - decay);
+    const double mean_power = energy / dt;
+
+    const double x = thermal_regressor(mean_power, fan_level);
+    const double predicted = THERMAL_AMBIENT + rls_predict(&thermal_rls, &x);
+    if (x > 0.0 && steady > THERMAL_AMBIENT && fabs(steady - predicted) < throttle / 2.0) {
+        rls_update(&thermal_rls, &x, steady - THERMAL_AMBIENT);
+    } else {
+        printf("[thermal] ignoring settling temperature %.1fC at %.2fW (model %.1fC)\n", steady, mean_power, predicted);
+    }
+    thermal_anchor(now, celsius, fan_level);
+}
+
+double thermal_model_temperature(void) {
+    return temperature;
+}
+
+bool thermal_model_throttling(void) {
+    return active && temperature >= throttle;
+}
+
+double thermal_model_steady(double power, int fan_level) {
+    if (thermal_rls.n == 0) thermal_model_reset();
+
+    const double x = thermal_regressor(power, fan_level);
+    return THERMAL_AMBIENT + rls_predict(&thermal_rls, &x);
+}
+
+int thermal_model_fan_level(double power) {
+    if (!active) return 0;
+
+    for (int level = 0; level < FAN_LEVELS; level++) {
+        if (thermal_model_steady(power, level) <= throttle - THERMAL_MARGIN) return level;
+    }
+    return -1;
+}
+
+double thermal_fan_power(int fan_level) {
+    if (fan_level < 0 || fan_level >= FAN_LEVELS) return FAN_POWER[FAN_LEVELS - 1];
+    return FAN_POWER[fan_level];
+}
+
+void thermal_model_report(void) {
+    if (!active) return;
+    printf("[thermal] %.1fC (throttle %.1fC) | %.2fC/W with the fan off over %.0fC ambient (%d updates)\n",
+           temperature, throttle, thermal_rls.theta[0], THERMAL_AMBIENT, thermal_rls.updates);
+}
@@ -0,0 +1,61 @@
+#ifndef THERMALMODEL_H
+#define THERMALMODEL_H
+
+#include <stdbool.h>
+
+#define THERMAL_ZONE "/sys/class/thermal/thermal_zone0"   // SoC zone of the A311D
+#define THERMAL_THROTTLE_DEFAULT 85.0     // degC, first passive trip of the A311D
+#define THERMAL_MARGIN 5.0                // degC kept between the steady state and the throttle point
+#define THERMAL_TIME_CONSTANT 60.0        // s, SoC plus heatsink, first order
+#define THERMAL_UPDATE_INTERVAL 10.0      // s of readings per model update, shorter ones are noise
+#define THERMAL_FORGETTING_FACTOR 0.98
+#define THERMAL_AMBIENT 30.0              // degC inside the enclosure, not learned
+
+// exp3 was measured with the fan on at level 1; the power fits hold at about
+// this temperature and the leakage moves them by this much per degree.
+#define THERMAL_FIT_TEMPERATURE 55.0
+#define THERMAL_LEAKAGE_PER_DEGREE 0.004
+
+// Levels of /sys/class/fan in manual mode, 0 is off. No fan sweep yet: the
+// power draw and the thermal resistance relative to the fan off are guesses
+// for the stock VIM3 heatsink and fan.
+#define FAN_LEVELS 4
+
+// First-order thermal model of the SoC zone: under a constant power P the
+// temperature settles at ambient + R(fan) * P with THERMAL_TIME_CONSTANT,
+// where R(fan) is the resistance with the fan off times a fixed ratio per
+// level. Every THERMAL_UPDATE_INTERVAL of readings the settling temperature
+// is solved from the first and last reading and the mean power in between,
+// and R is refined by RLS. The power barely moves within a session, so the
+// ambient is fixed rather than learned alongside R. The model only becomes
+// active once a backend reports a temperature; until then everything here is
+// a no-op and estimate_power ignores it.
+void thermal_model_reset(void);
+
+void thermal_model_set_throttle(double celsius);
+
+double thermal_model_throttle(void);
+
+bool thermal_model_active(void);
+
+// A reading of the zone while the fan was at fan_level and the SoC drew power
+// (estimate_pipeline_power) since the previous reading.
+void thermal_model_observe(double celsius, double power, int fan_level);
+
+double thermal_model_temperature(void);
+
+// The last reading is at or above the throttle point, so the frequencies the
+// last run asked for were probably capped.
+bool thermal_model_throttling(void);
+
+double thermal_model_steady(double power, int fan_level);
+
+// Lowest fan level whose steady state stays THERMAL_MARGIN below the throttle
+// point under power; -1 if even the top level does not. 0 while inactive.
+int thermal_model_fan_level(double power);
+
+double thermal_fan_power(int fan_level);
+
+void thermal_model_report(void);
+
+#endif
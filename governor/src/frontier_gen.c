@@ -0,0 +1,30 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ApproximationModels.h"
+#include "FrontierTable.h"
+
+
+int main (int argc, char *argv[]) {
+    bool park_cores = argc > 1 && strcmp(argv[argc - 1], "--park-cores") == 0;
+    if (park_cores) argc--;
+
+    if (argc < 2 || argc > 3) {
+        printf("Usage: ./frontier_gen <graph> [output] [--park-cores]\n");
+        printf("Writes the power/fps/latency Pareto frontier used by the governor at startup (default: %s)\n",
+               FRONTIER_DEFAULT_PATH);
+        printf("--park-cores estimates the powers as for a governor started with --park-cores\n");
+        return -1;
+    }
+
+    const char *path = (argc == 3) ? argv[2] : FRONTIER_DEFAULT_PATH;
+    set_core_parking(park_cores);
+
+    if (load_measurement_grid("../experiment_scripts/data/exp6_freq_sweep_fixed_order_partition_20260123_145108.csv") != 0) {
+        fprintf(stderr, "Failed to load measurement grid\n");
+        return -1;
+    }
+
+    return frontier_table_build(argv[1], path) == 0 ? 0 : 1;
+}
@@ -1,25 +1,39 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/stat.h>
+#include <string.h>
+#include <signal.h>
 #include <time.h>
 
 #include "Governor.h"
 #include "PipelineConfig.h"
 #include "ApproximationModels.h"
 #include "PIDController.h"
+#include "DeviceSession.h"
+#include "ExecutionBackend.h"
+#include "ReplaySimulator.h"
+#include "Optimizer.h"
+#include "FrontierTable.h"
+#include "ModelEstimator.h"
+#include "LayerModel.h"
+#include "SequentialTest.h"
+#include "DaemonMode.h"
+#include "ControlChannel.h"
+#include "MeasurementCache.h"
+#include "SessionHistory.h"
+#include "ThermalModel.h"
+#include "PowerSensor.h"
 
 
 int total_parts=0;
 int target_fps=0;
 int target_latency=0;
 
-static time_t get_file_mtime(const char *path) {
-    struct stat st;
-    if (stat(path, &st) != 0) {
-        return 0;
-    }
-    return st.st_mtime;
+static volatile sig_atomic_t interrupted = 0;
+
+static void on_sigint(int sig) {
+    (void)sig;
+    interrupted = 1;
 }
 
 static void print_best_so_far(PIDGovernor *pid_gov) {
@@ -28,43 +42,178 @@ static void print_best_so_far(PIDGovernor *pid_gov) {
     bool best_meets;
 
     if (pid_governor_get_best(pid_gov, &best_config, &best_power, &best_meets)) {
-        printf("  Best-so-far config: big_freq=%d, little_freq=%d, pp1=%d, pp2=%d, order=%s, meets_targets=%s\n",
-               best_config.big_frequency, best_config.little_frequency,
+        printf("  Best-so-far config: big_freq=%d, little_freq=%d, gpu_freq=%d, threads=%d/%d, pp1=%d, pp2=%d, order=%s, meets_targets=%s\n",
+               best_config.big_frequency, best_config.little_frequency, best_config.gpu_frequency, best_config.big_threads, best_config.little_threads,
                best_config.partition_point1, best_config.partition_point2, best_config.order,
                best_meets ? "YES" : "NO");
         printf("  Best-so-far estimated power: %.3f W\n", best_power);
+        if (pid_gov->best_measured_power > 0.0) {
+            printf("  Best-so-far measured power: %.3f W\n", pid_gov->best_measured_power);
+        }
+        if (pid_gov->power_cap > 0.0) {
+            printf("  Best-so-far fps: %.2f under a %.2f W cap\n", pid_gov->best_fps, pid_gov->power_cap);
+        }
     } else {
         printf("  No best-so-far config cached.\n");
     }
 }
 
+// Logs the configuration a session ended on with its measured operating point.
+static void log_session(const char *path, const char *device_id, const char *graph,
+                        PIDGovernor *pid_gov, PipelineConfig *config, bool converged) {
+    SessionRecord record;
+    stats_t stats;
 
-void set_system_config(){
-	/* Export OpenCL library path */
-    system("export LD_LIBRARY_PATH=/data/local/Working_dir");
-    system("adb -d root");
-	setenv("LD_LIBRARY_PATH","/data/local/Working_dir",1);
-
-	/* Setup Performance Governor (CPU) */
-	system("adb -d shell \"echo performance > /sys/devices/system/cpu/cpufreq/policy0/scaling_governor\"");
-	system("adb -d shell \"echo performance > /sys/devices/system/cpu/cpufreq/policy2/scaling_governor\"");
+    // A capped session ends on the fastest configuration, not the cheapest one
+    // for its targets, so it would mislead the warm start of later sessions.
+    if (pid_gov->power_cap > 0.0) return;
+    // Records hold the mean latency, which says nothing about a percentile target.
+    if (get_latency_quantile() > 0.0) return;
+    if (!pid_governor_find_measurement(pid_gov, config, &stats)) return;
 
-    system("./set_fan.sh 1 0 1");
+    memset(&record, 0, sizeof(record));
+    snprintf(record.graph, sizeof(record.graph), "%s", graph);
+    record.target_fps = pid_gov->target_fps;
+    record.target_latency = pid_gov->target_latency;
+    record.converged = converged && stats.fps >= pid_gov->target_fps && slo_latency(&stats) <= pid_gov->target_latency;
+    record.config = *config;
+    record.fps = stats.fps;
+    record.latency = stats.latency;
+    record.estimated_power = estimate_power(config);
+    record.measured_power = measured_power(&stats);
+    record.finished = time(NULL);
+    if (session_history_append(path, device_id, &record) != 0) {
+        fprintf(stderr, "Failed to append the session to %s\n", path);
+    }
 }
 
 
 int main (int argc, char *argv[]) {
 	if ( argc < 5 ){
 		printf("Wrong number of input arguments.\n");
-        printf("Usage: ./governor <graph> <total_parts> <target_fps> <target_latency>\n");
+        printf("Usage: ./governor <graph> <total_parts> <target_fps> <target_latency> [options]\n");
+        printf("Options:\n");
+        printf("  --device-cmd=<cmd>     shell used as the device session (default: \"%s\")\n", DEVICE_SHELL_CMD);
+        printf("  --device-dir=<dir>     graph directory on the device (default: %s)\n", DEVICE_WORKING_DIR);
+        printf("  --sysfs-root=<dir>     prefix for the cpufreq sysfs nodes (default: none)\n");
+        printf("  --backend=<name>       session (default), native (on the board itself), scripts or sim\n");
+        printf("  --sim-data=<dir>       measurement corpus for the sim backend (default: %s)\n", REPLAY_DEFAULT_DATA_DIR);
+        printf("  --sim-seed=<n>         noise seed for the sim backend\n");
+        printf("  --sim-noise=<scale>    noise scale for the sim backend, 0 disables (default: 1.0)\n");
+        printf("  --no-optimizer         start from the frequency grid only, without the model search\n");
+        printf("  --frontier=<file>      precomputed frontier from frontier_gen (default: %s)\n", FRONTIER_DEFAULT_PATH);
+        printf("  --window=<frames>      measurement window of the sequential stop test (default: 0, off: one 100-frame run).\n");
+        printf("                         The ARMCL graph reports only at exit, so each window is a launch with its own graph setup;\n");
+        printf("                         turn it on only where setup is short next to a window\n");
+        printf("  --device-id=<id>       name under which the recalibrated models are kept (default: the backend name)\n");
+        printf("  --daemon               keep one graph running and retune it until Ctrl-C (session, native and sim)\n");
+        printf("  --live-graph           the graph prints its statistics every window, not only at exit; without it --daemon relaunches per window\n");
+        printf("  --no-cache             measure every configuration, without the persistent measurement cache\n");
+        printf("  --no-history           do not start from the nearest converged configuration of past sessions\n");
+        printf("  --control=<fifo>       named pipe for new targets at runtime, e.g. echo \"targets 12 250\" > <fifo>\n");
+        printf("  --park-cores           take the cores the thread counts leave unused offline\n");
+        printf("  --throttle-temp=<C>    thermal zone temperature the SoC throttles at (default: %.0f)\n", THERMAL_THROTTLE_DEFAULT);
+        printf("  --power-sensor=<src>   measured board power: hwmon:<dir>, log:<file> or fifo:<path> of \"<unix time> <watts>\" lines\n");
+        printf("  --objective=<name>     watts (default) or energy: joules per frame, counting the idle time a faster configuration earns\n");
+        printf("  --pace                 with --daemon, idle the graph at the lowest OPPs whenever it runs ahead of the target fps\n");
+        printf("  --power-cap=<W>        maximise fps under this board power instead; target_fps becomes a floor\n");
+        printf("  --target-latency-p<N>=<ms>  hold the N-th percentile of the per-frame latencies to ms instead of the mean, e.g. --target-latency-p99=300\n");
 		return -1;
 	}
 
+    const char *device_cmd = DEVICE_SHELL_CMD;
+    const char *device_dir = DEVICE_WORKING_DIR;
+    const char *sysfs_root = "";
+    const char *backend_name = BACKEND_DEFAULT;
+    const char *sim_data_dir = REPLAY_DEFAULT_DATA_DIR;
+    unsigned long long sim_seed = 1;
+    double sim_noise = 1.0;
+    bool use_optimizer = true;
+    const char *frontier_path = FRONTIER_DEFAULT_PATH;
+    const char *device_id = NULL;
+    int window_frames = 0;
+    bool daemon_mode = false;
+    bool live_graph = false;
+    const char *control_path = NULL;
+    bool use_cache = true;
+    bool use_history = true;
+    bool park_cores = false;
+    const char *power_sensor_spec = NULL;
+    Objective objective = OBJECTIVE_WATTS;
+    double power_cap = 0.0;
+    bool pace = false;
+    double latency_percentile = 0.0;
+    int tail_latency = 0;
+
+    for (int i = 5; i < argc; i++) {
+        if (strncmp(argv[i], "--device-cmd=", 13) == 0) {
+            device_cmd = argv[i] + 13;
+        } else if (strncmp(argv[i], "--device-dir=", 13) == 0) {
+            device_dir = argv[i] + 13;
+        } else if (strncmp(argv[i], "--sysfs-root=", 13) == 0) {
+            sysfs_root = argv[i] + 13;
+        } else if (strncmp(argv[i], "--backend=", 10) == 0) {
+            backend_name = argv[i] + 10;
+        } else if (strncmp(argv[i], "--sim-data=", 11) == 0) {
+            sim_data_dir = argv[i] + 11;
+        } else if (strncmp(argv[i], "--sim-seed=", 11) == 0) {
+            sim_seed = strtoull(argv[i] + 11, NULL, 10);
+        } else if (strncmp(argv[i], "--sim-noise=", 12) == 0) {
+            sim_noise = atof(argv[i] + 12);
+        } else if (strncmp(argv[i], "--frontier=", 11) == 0) {
+            frontier_path = argv[i] + 11;
+        } else if (strncmp(argv[i], "--window=", 9) == 0) {
+            window_frames = atoi(argv[i] + 9);
+        } else if (strncmp(argv[i], "--device-id=", 12) == 0) {
+            device_id = argv[i] + 12;
+        } else if (strcmp(argv[i], "--no-optimizer") == 0) {
+            use_optimizer = false;
+        } else if (strcmp(argv[i], "--daemon") == 0) {
+            daemon_mode = true;
+        } else if (strcmp(argv[i], "--live-graph") == 0) {
+            live_graph = true;
+        } else if (strcmp(argv[i], "--no-cache") == 0) {
+            use_cache = false;
+        } else if (strcmp(argv[i], "--no-history") == 0) {
+            use_history = false;
+        } else if (strncmp(argv[i], "--control=", 10) == 0) {
+            control_path = argv[i] + 10;
+        } else if (strcmp(argv[i], "--park-cores") == 0) {
+            park_cores = true;
+        } else if (strncmp(argv[i], "--throttle-temp=", 16) == 0) {
+            thermal_model_set_throttle(atof(argv[i] + 16));
+        } else if (strncmp(argv[i], "--power-sensor=", 15) == 0) {
+            power_sensor_spec = argv[i] + 15;
+        } else if (strcmp(argv[i], "--objective=watts") == 0) {
+            objective = OBJECTIVE_WATTS;
+        } else if (strcmp(argv[i], "--objective=energy") == 0) {
+            objective = OBJECTIVE_ENERGY;
+        } else if (strcmp(argv[i], "--pace") == 0) {
+            pace = true;
+        } else if (strncmp(argv[i], "--power-cap=", 12) == 0) {
+            power_cap = atof(argv[i] + 12);
+            if (power_cap <= 0.0) {
+                printf("--power-cap needs a positive number of watts\n");
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--target-latency-p", 18) == 0) {
+            if (sscanf(argv[i] + 18, "%lf=%d", &latency_percentile, &tail_latency) != 2 ||
+                latency_percentile <= 0.0 || latency_percentile >= 100.0 || tail_latency <= 0) {
+                printf("--target-latency-p<N>=<ms> needs a percentile between 0 and 100 and a positive latency\n");
+                return -1;
+            }
+        } else {
+            printf("Unknown option: %s\n", argv[i]);
+            return -1;
+        }
+    }
+
     char graph[100];
 	sscanf(argv[1], "%s", graph);
 	total_parts=atoi(argv[2]);
 	target_fps=atoi(argv[3]);
 	target_latency=atoi(argv[4]);
+	if (tail_latency > 0) target_latency = tail_latency;
 
 	short latency_condition=0;
 	short fps_condition=0;
@@ -81,71 +230,267 @@ int main (int argc, char *argv[]) {
         exit (EXIT_FAILURE);
     }
 
+    if (device_id == NULL) device_id = backend_name;
+    char model_state_path[300];
+    snprintf(model_state_path, sizeof(model_state_path), "%s%s.txt", MODEL_STATE_PREFIX, device_id);
+    model_estimator_load(model_state_path, device_id);
+    char layer_model_path[300];
+    snprintf(layer_model_path, sizeof(layer_model_path), "%s%s.txt", LAYER_MODEL_PREFIX, device_id);
+    layer_model_load(layer_model_path, device_id);
+    char cache_path[300];
+    snprintf(cache_path, sizeof(cache_path), "%s%s.txt", MEASUREMENT_CACHE_PREFIX, device_id);
+    // Cached runs carry the mean latency only.
+    if (latency_percentile > 0.0 && use_cache) {
+        printf("[latency] the measurement cache holds no per-frame latencies, measuring every configuration\n");
+        use_cache = false;
+    }
+    if (latency_percentile > 0.0 && use_history) {
+        printf("[latency] the session history holds mean latencies only, starting without it\n");
+        use_history = false;
+    }
+    measurement_cache_set_enabled(use_cache);
+    if (use_cache) measurement_cache_load(cache_path, device_id);
+    char history_path[300];
+    snprintf(history_path, sizeof(history_path), "%s%s.txt", SESSION_HISTORY_PREFIX, device_id);
+
+    set_core_parking(park_cores);
+    set_objective(objective);
+    set_frame_pacing(pace);
+    if (latency_percentile > 0.0) {
+        set_latency_quantile(latency_percentile / 100.0);
+        printf("[latency] target %d ms on p%g of the per-frame latencies, the mean where the graph prints none\n",
+               target_latency, latency_percentile);
+    }
+    if (objective != OBJECTIVE_WATTS || pace) {
+        printf("[objective] %s%s\n", objective_name(objective),
+               !pace ? ", cores kept at their OPP between frames" :
+               daemon_mode ? ", frames paced with idle periods at the lowest OPPs" :
+               ", paced as if idling at the lowest OPPs (pacing itself needs --daemon)");
+    }
+
     if (load_measurement_grid("../experiment_scripts/data/exp6_freq_sweep_fixed_order_partition_20260123_145108.csv") != 0) {
         fprintf(stderr, "Failed to load measurement grid\n");
         return -1;
     }
 
     approximate_target_space((double)target_fps, (double)target_latency, &config);
+    const PipelineConfig grid_start = config;
+
+    SessionRecord warm_start;
+    bool warm_started = use_history && power_cap <= 0.0 &&
+        session_history_nearest(history_path, device_id, graph, (double)target_fps, (double)target_latency,
+                                &warm_start) == 0;
+    if (warm_started) {
+        config = warm_start.config;
+        printf("[history] big_freq=%d, little_freq=%d, gpu_freq=%d, threads=%d/%d, pp1=%d, pp2=%d, order=%s measured fps=%.2f latency=%.2fms "
+               "(converged for fps=%.1f, latency=%.1f)\n",
+               config.big_frequency, config.little_frequency, config.gpu_frequency, config.big_threads, config.little_threads,
+               config.partition_point1, config.partition_point2, config.order,
+               warm_start.fps, warm_start.latency, warm_start.target_fps, warm_start.target_latency);
+    } else if (use_optimizer && power_cap > 0.0) {
+        OptimizerReport optimizer_report;
+        if (optimize_capped_configuration(power_cap, (double)target_latency, &config, &optimizer_report) != 0) {
+            printf("[optimizer] keeping the grid starting point\n");
+        }
+    } else if (use_optimizer) {
+        FrontierTable frontier = {0};
+        double frontier_power;
+
+        // frontier_gen evaluates the fitted models only; once this device has
+        // recalibrated them, the table no longer holds their optimum.
+        const bool calibrated = model_estimator_ready('G') || model_estimator_ready('B') ||
+                                model_estimator_ready('L') || model_estimator_ready('P') || layer_model_calibrated();
+        if (calibrated) printf("[frontier] models recalibrated for '%s', searching with them instead\n", device_id);
+
+        if (!calibrated && frontier_table_open(&frontier, frontier_path) == 0 &&
+            frontier_table_lookup(&frontier, graph, (double)target_fps, (double)target_latency,
+                                  &config, &frontier_power) == 0) {
+            printf("[frontier] %s: big_freq=%d, little_freq=%d, gpu_freq=%d, threads=%d/%d, pp1=%d, pp2=%d, order=%s -> %.3f W\n",
+                   frontier_path, config.big_frequency, config.little_frequency, config.gpu_frequency, config.big_threads, config.little_threads,
+                   config.partition_point1, config.partition_point2, config.order, frontier_power);
+        } else {
+            OptimizerReport optimizer_report;
+            if (optimize_configuration((double)target_fps, (double)target_latency, &config, &optimizer_report) != 0) {
+                printf("[optimizer] keeping the grid starting point\n");
+            }
+        }
+        frontier_table_close(&frontier);
+    }
 
     double p = estimate_power(&config);
     printf("[smoke-test] estimated power: %f\n", p);
 
-    set_system_config();
+    BackendOptions backend_options = {device_cmd, device_dir, sysfs_root, sim_data_dir, sim_seed, sim_noise};
+    ExecutionBackend backend;
+    if (execution_backend_open(&backend, backend_name, &backend_options) != 0) {
+        fprintf(stderr, "Failed to open execution backend '%s'\n", backend_name);
+        return -1;
+    }
+    backend.window_frames = window_frames;
+    backend.park_cores = park_cores;
+    if (live_graph) backend.live_graph = true;
+    backend.pace = pace && daemon_mode;
+
+    PowerSensor power_sensor;
+    memset(&power_sensor, 0, sizeof(power_sensor));
+    if (power_sensor_spec) {
+        if (power_sensor_open(&power_sensor, power_sensor_spec) != 0) {
+            execution_backend_close(&backend);
+            return -1;
+        }
+        backend.power_sensor = &power_sensor;
+    }
+    execution_backend_set_fan(&backend, 1, 0, 1);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_sigint;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
 
+    stats_t stats;
     PIDGovernor pid_gov;
     pid_governor_init(&pid_gov, (double)target_fps, (double)target_latency, 20);
+    pid_gov.power_cap = power_cap;
+    if (warm_started) {
+        memset(&stats, 0, sizeof(stats));
+        stats.fps = warm_start.fps;
+        stats.latency = warm_start.latency;
+        if (warm_start.fps > 0.0) stats.energy_per_frame = warm_start.measured_power / warm_start.fps;
+        pid_governor_seed(&pid_gov, &config, &stats, warm_start.estimated_power);
+    }
+
+    ControlChannel control;
+    memset(&control, 0, sizeof(control));
+    if (control_path && control_channel_open(&control, control_path) != 0) {
+        execution_backend_close(&backend);
+        power_sensor_close(&power_sensor);
+        return -1;
+    }
 
-    stats_t stats;
     double estimated_power = 0.0;
     PIDResult result;
+    int exit_code = 0;
+
+    // The grid start is an exp6 measurement; a start the optimizer or the
+    // frontier table only predicted has to beat it when measured. If it misses
+    // the targets, the grid start is measured next and the search goes on from
+    // whichever of the two did better.
+    const PipelineConfig predicted_start = config;
+    PipelineConfig after_predicted_start = config;
+    bool check_predicted_start = !warm_started && memcmp(&config, &grid_start, sizeof(config)) != 0;
+    bool measuring_grid_start = false;
 
     printf("\n[PID Governor] Starting optimization for target_fps=%d, target_latency=%d\n", 
            target_fps, target_latency);
-    printf("[PID Governor] Initial config: big_freq=%d, little_freq=%d, pp1=%d, pp2=%d\n",
-           config.big_frequency, config.little_frequency,
-           config.partition_point1, config.partition_point2);
+    if (power_cap > 0.0) printf("[PID Governor] Maximising fps under a %.2f W power cap\n", power_cap);
+    printf("[PID Governor] Initial config: big_freq=%d, little_freq=%d, gpu_freq=%d, threads=%d/%d, pp1=%d, pp2=%d, order=%s\n",
+           config.big_frequency, config.little_frequency, config.gpu_frequency, config.big_threads, config.little_threads,
+           config.partition_point1, config.partition_point2, config.order);
 
-    while (1) {
-        time_t mtime_before = get_file_mtime("last_run_output.txt");
-        run_inference(&config, graph, 100);
-        time_t mtime_after = get_file_mtime("last_run_output.txt");
+    if (daemon_mode) {
+        DaemonReport daemon_report;
+        int rc = daemon_mode_run(&pid_gov, &backend, graph, &config,
+                                 control_path ? &control : NULL, &interrupted, &daemon_report);
 
-        if (mtime_after == mtime_before) {
-            printf("\n[PID Governor] Inference interrupted (Ctrl-C detected). Exiting.\n");
-            print_best_so_far(&pid_gov);
-            system("./set_fan.sh 1 0 0");
-            return 1;
+        printf("\n[PID Governor] Daemon %s.\n", rc == 0 ? "stopped" : "failed");
+        printf("  Last config: big_freq=%d, little_freq=%d, gpu_freq=%d, threads=%d/%d, pp1=%d, pp2=%d, order=%s\n",
+               config.big_frequency, config.little_frequency, config.gpu_frequency, config.big_threads, config.little_threads,
+               config.partition_point1, config.partition_point2, config.order);
+        daemon_mode_report(&daemon_report);
+        log_session(history_path, device_id, graph, &pid_gov, &config, pid_gov.converged);
+        exit_code = rc == 0 ? 0 : 1;
+        goto out;
+    }
+
+    while (1) {
+        double new_fps = pid_gov.target_fps;
+        double new_latency = pid_gov.target_latency;
+        if (control_channel_poll(&control, &new_fps, &new_latency)) {
+            pid_governor_retarget(&pid_gov, new_fps, new_latency, &config);
         }
 
-        parse_results(&stats);
+        result = pid_governor_run_step(&pid_gov, &backend, graph, 100, &config, &stats, &estimated_power);
 
-        result = pid_governor_step(&pid_gov, &config, &stats, &estimated_power);
-        
-        if (result == PID_CONVERGED) {
+        if (result == PID_CONTINUE && check_predicted_start) {
+            bool predicted_meets = false;
+            check_predicted_start = false;
+            pid_governor_get_best(&pid_gov, NULL, NULL, &predicted_meets);
+            if (!predicted_meets) {
+                printf("[optimizer] predicted start missed the targets when measured, measuring the grid start\n");
+                after_predicted_start = config;
+                config = grid_start;
+                measuring_grid_start = true;
+            }
+        } else if (result == PID_CONTINUE && measuring_grid_start) {
+            PipelineConfig best;
+            measuring_grid_start = false;
+            if (pid_governor_get_best(&pid_gov, &best, NULL, NULL) &&
+                memcmp(&best, &predicted_start, sizeof(best)) == 0) {
+                printf("[optimizer] predicted start did better than the grid start, going on from it\n");
+                config = after_predicted_start;
+            }
+        }
+
+        if (result == PID_BACKEND_ERROR) {
+            if (interrupted) {
+                printf("\n[PID Governor] Inference interrupted (Ctrl-C detected). Exiting.\n");
+            } else {
+                printf("\n[PID Governor] Backend '%s' failed. Exiting.\n", backend.name);
+            }
+            print_best_so_far(&pid_gov);
+            exit_code = 1;
+            break;
+        } else if (result == PID_CONVERGED) {
             printf("\n[PID Governor] Optimization complete!\n");
-            printf("  Final config: big_freq=%d, little_freq=%d, pp1=%d, pp2=%d, order=%s\n",
-                   config.big_frequency, config.little_frequency,
+            printf("  Final config: big_freq=%d, little_freq=%d, gpu_freq=%d, threads=%d/%d, pp1=%d, pp2=%d, order=%s\n",
+                   config.big_frequency, config.little_frequency, config.gpu_frequency, config.big_threads, config.little_threads,
                    config.partition_point1, config.partition_point2, config.order);
             printf("  Estimated power: %.3f W\n", estimated_power);
-            printf("  Achieved: fps=%.2f, latency=%.2f ms\n", stats.fps, stats.latency);
+            printf("  Achieved: fps=%.2f, latency=%.2f ms", stats.fps, stats.latency);
+            if (stats.latency_tail > 0.0) printf(" (p%g %.2f ms)", 100.0 * get_latency_quantile(), stats.latency_tail);
+            printf("\n");
             print_best_so_far(&pid_gov);
             print_pipe_line_config(&config);
+            log_session(history_path, device_id, graph, &pid_gov, &config, true);
             break;
         } else if (result == PID_MAX_ITERATIONS) {
             printf("\n[PID Governor] Max iterations reached without full convergence.\n");
             print_best_so_far(&pid_gov);
 
-            printf("  Returned config: big_freq=%d, little_freq=%d, pp1=%d, pp2=%d\n",
-                   config.big_frequency, config.little_frequency,
-                   config.partition_point1, config.partition_point2);
+            printf("  Returned config: big_freq=%d, little_freq=%d, gpu_freq=%d, threads=%d/%d, pp1=%d, pp2=%d, order=%s\n",
+                   config.big_frequency, config.little_frequency, config.gpu_frequency, config.big_threads, config.little_threads,
+                   config.partition_point1, config.partition_point2, config.order);
             printf("  Returned estimated power: %.3f W\n", estimated_power);
             printf("  Last stats: fps=%.2f, latency=%.2f ms\n", stats.fps, stats.latency);
+            log_session(history_path, device_id, graph, &pid_gov, &config, false);
             break;
         }
 
         printf("\n\n");
     }
+
+    // Every way out of the session reports and saves the same state.
+out:
+    execution_backend_set_fan(&backend, 1, 0, 0);
+    model_estimator_report();
+    layer_model_report();
+    thermal_model_report();
+    power_sensor_report(&power_sensor);
+    if (model_estimator_save(model_state_path, device_id) != 0) {
+        fprintf(stderr, "Failed to save the recalibrated models to %s\n", model_state_path);
+    }
+    if (layer_model_save(layer_model_path, device_id) != 0) {
+        fprintf(stderr, "Failed to save the layer model to %s\n", layer_model_path);
+    }
+    measurement_cache_report();
+    if (use_cache && measurement_cache_save(cache_path, device_id) != 0) {
+        fprintf(stderr, "Failed to save the measurement cache to %s\n", cache_path);
+    }
+    execution_backend_report(&backend);
+    execution_backend_close(&backend);
+    power_sensor_close(&power_sensor);
+    control_channel_close(&control);
   
-  	return 0;
+  	return exit_code;
 }
\ No newline at end of file